@@ -51,7 +51,6 @@ err:
 
 static bool json_request(const char *func, const uint8_t *param, unsigned param_len) {
     _cleanup_free_ char *param_hex = NULL;
-    _cleanup_cjson_ cJSON *jpayload = NULL;
 
     if (param && param_len) {
         param_hex = malloc((2 * param_len) + 1);
@@ -65,18 +64,15 @@ static bool json_request(const char *func, const uint8_t *param, unsigned param_
         param_hex = NULL;
     }
 
-    jpayload = cJSON_CreateObject();
-    if (jpayload == NULL) {
-        return false;
-    }
-    if (cJSON_AddStringOrNullToObject(jpayload, "func", func) == NULL) {
-        return false;
-    }
-    if (cJSON_AddStringOrNullToObject(jpayload, "param", param_hex) == NULL) {
-        return false;
-    }
+    json_print_stream_begin("apdu");
+    json_writer_object_begin();
+    json_writer_key("func");
+    json_writer_string(func);
+    json_writer_key("param");
+    json_writer_string(param_hex);
+    json_writer_object_end();
 
-    return json_print("apdu", jpayload);
+    return json_print_stream_end();
 }
 
 static int json_response(int *ecode, uint8_t **data, uint32_t *data_len) {
@@ -31,10 +31,14 @@
 #ifdef LPAC_WITH_HTTP_CURL
 #    include "driver/http/curl.h"
 #endif
+#ifdef LPAC_WITH_HTTP_RELAY
+#    include "driver/http/relay.h"
+#endif
 #ifdef LPAC_WITH_APDU_AT_WIN32
 #    include "driver/apdu/at_win32.h"
 #endif
 #include "driver/apdu/stdio.h"
+#include "driver/http/replay.h"
 #include "driver/http/stdio.h"
 
 static const struct euicc_driver *drivers[] = {
@@ -62,7 +66,10 @@ static const struct euicc_driver *drivers[] = {
 #ifdef LPAC_WITH_HTTP_CURL
     &driver_http_curl,
 #endif
-    &driver_apdu_stdio,        &driver_http_stdio, NULL,
+#ifdef LPAC_WITH_HTTP_RELAY
+    &driver_http_relay,
+#endif
+    &driver_apdu_stdio,        &driver_http_stdio, &driver_http_replay, NULL,
 };
 
 static const struct euicc_driver *_driver_apdu = NULL;
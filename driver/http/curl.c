@@ -1,16 +1,26 @@
 #include "curl.h"
+#include "trace.h"
 
+#include <euicc/hexutil.h>
 #include <euicc/interface.h>
+#include <lpac/utils.h>
 
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
 
 #ifndef _WIN32
 #    include <curl/curl.h>
 #else
 #    include <dlfcn-win32/dlfcn.h>
+#    include <winsock2.h>
 #    define CURL_GLOBAL_DEFAULT ((1 << 0) | (1 << 1))
 #    define CURLE_OK 0
 #    define CURLOPT_URL 10002
@@ -21,21 +31,77 @@
 #    define CURLOPT_HTTPHEADER 10023
 #    define CURLOPT_POSTFIELDS 10015
 #    define CURLOPT_POSTFIELDSIZE 60
+#    define CURLOPT_TCP_KEEPALIVE 213
+#    define CURLOPT_RESOLVE 10203
+#    define CURLOPT_CONNECTTIMEOUT 78
+#    define CURLOPT_ACCEPT_ENCODING 10102
+#    define CURLOPT_NOBODY 44
+#    define CURLOPT_SHARE 10100
+#    define CURLOPT_PRIVATE 10103
+#    define CURLOPT_COPYPOSTFIELDS 10165
 #    define CURLINFO_RESPONSE_CODE 2097154
+#    define CURLINFO_PRIVATE 1048597
+#    define CURLINFO_PRIMARY_IP 1048608
+#    define CURLINFO_PRIMARY_PORT 2097192
+#    define CURLINFO_SIZE_DOWNLOAD_T 6291464
+#    define CURLINFO_TOTAL_TIME_T 6291506
+#    define CURLINFO_NAMELOOKUP_TIME_T 6291507
+#    define CURLINFO_CONNECT_TIME_T 6291508
+#    define CURLINFO_STARTTRANSFER_TIME_T 6291510
+#    define CURLINFO_APPCONNECT_TIME_T 6291512
+#    define CURLSHOPT_SHARE 1
+#    define CURL_LOCK_DATA_DNS 3
+#    define CURL_LOCK_DATA_SSL_SESSION 4
+#    define CURLE_COULDNT_CONNECT 7
+#    define CURLE_OPERATION_TIMEDOUT 28
+#    define CURLE_SSL_CONNECT_ERROR 35
+#    define CURLM_OK 0
+#    define CURLMSG_DONE 1
+#    define CURLMOPT_SOCKETFUNCTION 20001
+#    define CURL_POLL_IN 1
+#    define CURL_POLL_OUT 2
+#    define CURL_POLL_INOUT 3
+#    define CURL_POLL_REMOVE 4
+#    define CURL_CSELECT_IN 1
+#    define CURL_CSELECT_OUT 2
+#    define CURL_CSELECT_ERR 4
+#    define CURL_SOCKET_BAD INVALID_SOCKET
+#    define CURL_SOCKET_TIMEOUT CURL_SOCKET_BAD
 
 typedef void CURL;
+typedef void CURLSH;
 typedef int CURLcode;
+typedef int CURLSHcode;
 typedef int CURLoption;
+typedef int CURLSHoption;
 typedef int CURLINFO;
+typedef long long curl_off_t;
+typedef void CURLM;
+typedef int CURLMcode;
+typedef int CURLMSG;
+typedef int CURLMoption;
+typedef SOCKET curl_socket_t;
 
-static void *libcurl_interface_dlhandle = NULL;
-#endif
+struct CURLMsg {
+    CURLMSG msg;
+    CURL *easy_handle;
+    union {
+        void *whatever;
+        CURLcode result;
+    } data;
+};
+typedef struct CURLMsg CURLMsg;
 
-struct http_trans_response_data {
-    uint8_t *data;
-    size_t size;
+struct curl_waitfd;
+
+struct curl_slist {
+    char *data;
+    struct curl_slist *next;
 };
 
+static void *libcurl_interface_dlhandle = NULL;
+#endif
+
 static struct libcurl_interface {
     CURLcode (*_curl_global_init)(long flags);
     CURL *(*_curl_easy_init)(void);
@@ -44,11 +110,145 @@ static struct libcurl_interface {
     CURLcode (*_curl_easy_getinfo)(CURL *curl, CURLINFO info, ...);
     const char *(*_curl_easy_strerror)(CURLcode);
     void (*_curl_easy_cleanup)(CURL *curl);
+    void (*_curl_easy_reset)(CURL *curl);
 
     struct curl_slist *(*_curl_slist_append)(struct curl_slist *list, const char *data);
     void (*_curl_slist_free_all)(struct curl_slist *list);
+
+    CURLSH *(*_curl_share_init)(void);
+    CURLSHcode (*_curl_share_setopt)(CURLSH *share, CURLSHoption option, ...);
+    CURLSHcode (*_curl_share_cleanup)(CURLSH *share);
+
+    CURLM *(*_curl_multi_init)(void);
+    CURLMcode (*_curl_multi_add_handle)(CURLM *multi, CURL *curl);
+    CURLMcode (*_curl_multi_remove_handle)(CURLM *multi, CURL *curl);
+    CURLMcode (*_curl_multi_setopt)(CURLM *multi, CURLMoption option, ...);
+    CURLMcode (*_curl_multi_assign)(CURLM *multi, curl_socket_t sockfd, void *sockp);
+    CURLMcode (*_curl_multi_socket_action)(CURLM *multi, curl_socket_t s, int ev_bitmask, int *running_handles);
+    CURLMsg *(*_curl_multi_info_read)(CURLM *multi, int *msgs_in_queue);
+    CURLMcode (*_curl_multi_wait)(CURLM *multi, struct curl_waitfd *extra_fds, unsigned int extra_nfds,
+                                  int timeout_ms, int *numfds);
+    CURLMcode (*_curl_multi_timeout)(CURLM *multi, long *timeout);
+    const char *(*_curl_multi_strerror)(CURLMcode);
+    CURLMcode (*_curl_multi_cleanup)(CURLM *multi);
 } libcurl;
 
+// Every request runs on one multi handle; the blocking transmit just waits for its own request.
+// Finished easy handles are kept for reuse and the connection cache of the multi handle keeps the
+// TCP/TLS connections to every SM-DP+ contacted so far open between ES9+ calls.
+#define HTTP_IDLE_HANDLES 8
+
+struct http_request;
+
+// A socket curl asked to watch, kept up to date by http_socket_callback and attached to the socket
+// with curl_multi_assign, so async_fds reports exactly the sockets curl cares about
+struct http_socket {
+    curl_socket_t fd;
+    int what;
+    struct http_socket *next;
+};
+
+static struct {
+    CURLM *multi;
+    CURL *idle[HTTP_IDLE_HANDLES];
+    int idle_count;
+    struct http_request *active;
+    struct http_socket *sockets;
+    uint32_t sockets_count;
+    CURLSH *share;
+    struct curl_slist *headers;
+    struct euicc_http_transfer_info last;
+    // trace of every exchange for the replay backend, opened from LPAC_HTTP_CURL_RECORD
+    FILE *record;
+    uint32_t record_index;
+} http_session;
+
+#define ENV_CACHE HTTP_ENV_NAME(CURL, CACHE)
+#define ENV_RECORD HTTP_ENV_NAME(CURL, RECORD)
+#define ENV_CACHE_TTL HTTP_ENV_NAME(CURL, CACHE_TTL)
+#define HTTP_CACHE_TTL_DEFAULT 3600
+#define HTTP_CACHE_MAX_HOSTS 32
+#define HTTP_CACHE_CONNECT_TIMEOUT 5L
+
+// TLS session export/import was added in libcurl 8.12.0
+#if defined(LIBCURL_VERSION_NUM) && LIBCURL_VERSION_NUM >= 0x080C00
+#    define HTTP_CACHE_TLS_SESSIONS
+#endif
+
+struct http_trans_response_data {
+    uint8_t *data;
+    size_t size;
+};
+
+struct http_cache_dns {
+    char host[256];
+    long port;
+    char ip[64];
+    time_t expires;
+};
+
+struct http_cache_tls {
+    char *session_key;
+    uint8_t *shmac;
+    size_t shmac_len;
+    uint8_t *sdata;
+    size_t sdata_len;
+    time_t expires;
+    struct http_cache_tls *next;
+};
+
+// Opt-in on-disk cache of resolved addresses and TLS session tickets, so a new lpac
+// process does not start every connection with a DNS lookup and a full handshake.
+static struct {
+    const char *path;
+    long ttl;
+    struct http_cache_dns dns[HTTP_CACHE_MAX_HOSTS];
+    int dns_count;
+    struct http_cache_tls *tls;
+    int tls_imported;
+} http_cache;
+
+struct http_request {
+    struct euicc_ctx *ctx;
+    CURL *curl;
+    struct curl_slist *headers; // only set when the request could not use the cached list
+    struct curl_slist *headers_used;
+    struct curl_slist *resolve;
+    struct http_cache_dns *cached;
+    char host[256];
+    long port;
+    bool cacheable;
+    // a HEAD started by http_interface_prewarm to the server root at prewarm_url
+    bool prewarm;
+    char *prewarm_url;
+    size_t (*write_callback)(void *contents, size_t size, size_t nmemb, void *userp);
+    void *write_data;
+    struct http_trans_response_data response;
+    struct euicc_http_transfer_info info;
+    void (*callback)(struct euicc_ctx *ctx, struct euicc_http_response *response, void *userdata);
+    void *userdata;
+    // only kept while recording, a streamed body is copied to record_rx as it passes through
+    char *record_url;
+    struct http_trans_response_data record_tx;
+    struct http_trans_response_data record_rx;
+    struct http_request *next;
+};
+
+static size_t http_trans_write_callback(void *contents, size_t size, size_t nmemb, void *userp);
+
+// Sits between libcurl and the request's write callback to count the decoded body bytes
+static size_t http_write_proxy_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    struct http_request *req = userp;
+    const size_t written = req->write_callback(contents, size, nmemb, req->write_data);
+
+    req->info.bytes_received += written;
+    if (http_session.record && req->write_data != &req->response && written > 0) {
+        http_trans_write_callback(contents, 1, written, &req->record_rx);
+    }
+
+    return written;
+}
+
 static size_t http_trans_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t realsize = size * nmemb;
     struct http_trans_response_data *mem = (struct http_trans_response_data *)userp;
@@ -67,64 +267,928 @@ static size_t http_trans_write_callback(void *contents, size_t size, size_t nmem
     return realsize;
 }
 
-static int http_interface_transmit(struct euicc_ctx *ctx, const char *url, uint32_t *rcode, uint8_t **rx,
-                                   uint32_t *rx_len, const uint8_t *tx, uint32_t tx_len, const char **h) {
-    int fret = 0;
-    CURL *curl;
-    CURLcode res;
-    struct http_trans_response_data responseData = {0};
-    struct curl_slist *headers = NULL, *nheaders = NULL;
-    long response_code;
+struct http_trans_stream_data {
+    int (*callback)(const uint8_t *data, uint32_t data_len, void *userdata);
+    void *userdata;
+};
 
-    (*rx) = NULL;
-    (*rcode) = 0;
+static size_t http_trans_stream_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    struct http_trans_stream_data *stream = (struct http_trans_stream_data *)userp;
 
-    curl = libcurl._curl_easy_init();
-    if (!curl) {
-        goto err;
+    if (stream->callback(contents, realsize, stream->userdata) < 0) {
+        return 0;
     }
 
-    libcurl._curl_easy_setopt(curl, CURLOPT_URL, url);
-    libcurl._curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_trans_write_callback);
-    libcurl._curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&responseData);
-    libcurl._curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    libcurl._curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    return realsize;
+}
+
+static uint8_t *http_cache_unhex(const char *hex, size_t *len) {
+    uint8_t *bin = malloc(strlen(hex) / 2 + 1);
+    int n;
+
+    if (bin == NULL) {
+        return NULL;
+    }
+    if ((n = euicc_hexutil_hex2bin(bin, strlen(hex) / 2 + 1, hex)) < 0) {
+        free(bin);
+        return NULL;
+    }
+    *len = n;
+    return bin;
+}
+
+static void http_cache_tls_free_all(void) {
+    while (http_cache.tls) {
+        struct http_cache_tls *next = http_cache.tls->next;
+        free(http_cache.tls->session_key);
+        free(http_cache.tls->shmac);
+        free(http_cache.tls->sdata);
+        free(http_cache.tls);
+        http_cache.tls = next;
+    }
+}
+
+// Host and port of an absolute URL, false for IP literals which need no resolving
+static bool http_url_host_port(const char *url, char *host, size_t host_size, long *port) {
+    const char *p = strstr(url, "://");
+    size_t len;
+
+    *port = strncmp(url, "http://", 7) == 0 ? 80 : 443;
+    p = p ? p + 3 : url;
+    if (*p == '[') {
+        return false;
+    }
+
+    len = strcspn(p, ":/?#");
+    if (len == 0 || len >= host_size) {
+        return false;
+    }
+    memcpy(host, p, len);
+    host[len] = '\0';
+
+    if (p[len] == ':') {
+        *port = strtol(p + len + 1, NULL, 10);
+    }
+
+    return strspn(host, "0123456789.") != len;
+}
+
+static struct http_cache_dns *http_cache_dns_find(const char *host, long port) {
+    const time_t now = time(NULL);
+
+    for (int i = 0; i < http_cache.dns_count; i++) {
+        struct http_cache_dns *entry = &http_cache.dns[i];
+        if (entry->port == port && strcmp(entry->host, host) == 0) {
+            return entry->expires > now ? entry : NULL;
+        }
+    }
+    return NULL;
+}
+
+static void http_cache_dns_store(const char *host, long port, const char *ip) {
+    struct http_cache_dns *entry = NULL;
+
+    for (int i = 0; i < http_cache.dns_count; i++) {
+        if (http_cache.dns[i].port == port && strcmp(http_cache.dns[i].host, host) == 0) {
+            entry = &http_cache.dns[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        if (http_cache.dns_count == HTTP_CACHE_MAX_HOSTS) {
+            // evict the entry closest to expiry
+            entry = &http_cache.dns[0];
+            for (int i = 1; i < http_cache.dns_count; i++) {
+                if (http_cache.dns[i].expires < entry->expires) {
+                    entry = &http_cache.dns[i];
+                }
+            }
+        } else {
+            entry = &http_cache.dns[http_cache.dns_count++];
+        }
+    }
+
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    snprintf(entry->ip, sizeof(entry->ip), "%s", ip);
+    entry->port = port;
+    entry->expires = time(NULL) + http_cache.ttl;
+}
+
+static void http_cache_load(void) {
+    FILE *fp;
+    static char line[65536];
+    const time_t now = time(NULL);
+
+    http_cache.path = getenv(ENV_CACHE);
+    if (http_cache.path == NULL || http_cache.path[0] == '\0') {
+        http_cache.path = NULL;
+        return;
+    }
+    http_cache.ttl = getenv_or_default(ENV_CACHE_TTL, (long)HTTP_CACHE_TTL_DEFAULT);
+    if (http_cache.ttl <= 0) {
+        http_cache.ttl = HTTP_CACHE_TTL_DEFAULT;
+    }
+
+    if ((fp = fopen(http_cache.path, "r")) == NULL) {
+        return;
+    }
+
+    // dns <expires> <host> <port> <ip>
+    // tls <expires> <session key hex> <shmac hex> <session data hex>
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        long long expires;
+        char host[256], ip[64];
+        long port;
+        int n;
+
+        if (sscanf(line, "dns %lld %255s %ld %63s", &expires, host, &port, ip) == 4) {
+            if (expires > now && http_cache.dns_count < HTTP_CACHE_MAX_HOSTS) {
+                struct http_cache_dns *entry = &http_cache.dns[http_cache.dns_count++];
+                snprintf(entry->host, sizeof(entry->host), "%s", host);
+                snprintf(entry->ip, sizeof(entry->ip), "%s", ip);
+                entry->port = port;
+                entry->expires = expires;
+            }
+        } else if (sscanf(line, "tls %lld %n", &expires, &n) == 1 && expires > now) {
+            struct http_cache_tls *entry;
+            char *key_hex = strtok(line + n, " \n"), *shmac_hex = strtok(NULL, " \n"), *sdata_hex = strtok(NULL, " \n");
+            size_t key_len;
+
+            if (key_hex == NULL || shmac_hex == NULL || sdata_hex == NULL) {
+                continue;
+            }
+            if ((entry = calloc(1, sizeof(*entry))) == NULL) {
+                break;
+            }
+            entry->session_key = (char *)http_cache_unhex(key_hex, &key_len);
+            entry->shmac = http_cache_unhex(shmac_hex, &entry->shmac_len);
+            entry->sdata = http_cache_unhex(sdata_hex, &entry->sdata_len);
+            entry->expires = expires;
+            entry->next = http_cache.tls;
+            http_cache.tls = entry;
+            if (entry->session_key == NULL || entry->shmac == NULL || entry->sdata == NULL) {
+                http_cache_tls_free_all();
+                break;
+            }
+            entry->session_key[key_len] = '\0';
+        }
+    }
+
+    fclose(fp);
+}
+
+#ifdef HTTP_CACHE_TLS_SESSIONS
+static char *http_cache_hex(const uint8_t *bin, size_t len) {
+    char *hex = malloc(len * 2 + 1);
+
+    if (hex == NULL) {
+        return NULL;
+    }
+    if (euicc_hexutil_bin2hex(hex, len * 2 + 1, bin, len) < 0) {
+        free(hex);
+        return NULL;
+    }
+    return hex;
+}
+
+static CURLcode http_cache_tls_export(__attribute__((unused)) CURL *curl, void *userptr, const char *session_key,
+                                      const unsigned char *shmac, size_t shmac_len, const unsigned char *sdata,
+                                      size_t sdata_len, curl_off_t valid_until,
+                                      __attribute__((unused)) int ietf_tls_id,
+                                      __attribute__((unused)) const char *alpn,
+                                      __attribute__((unused)) size_t earlydata_max) {
+    FILE *fp = userptr;
+    _cleanup_free_ char *key_hex = http_cache_hex((const uint8_t *)session_key, strlen(session_key));
+    _cleanup_free_ char *shmac_hex = http_cache_hex(shmac, shmac_len);
+    _cleanup_free_ char *sdata_hex = http_cache_hex(sdata, sdata_len);
+    long long expires = time(NULL) + http_cache.ttl;
+
+    if (valid_until > 0 && valid_until < expires) {
+        expires = valid_until;
+    }
+    if (key_hex && shmac_hex && sdata_hex) {
+        fprintf(fp, "tls %lld %s %s %s\n", expires, key_hex, shmac_hex, sdata_hex);
+    }
+
+    return CURLE_OK;
+}
+#endif
+
+static void http_cache_save(void) {
+    _cleanup_free_ char *tmp_path = NULL;
+    FILE *fp;
+    const time_t now = time(NULL);
+
+    if (http_cache.path == NULL) {
+        return;
+    }
+
+    if ((tmp_path = malloc(strlen(http_cache.path) + 5)) == NULL) {
+        return;
+    }
+    sprintf(tmp_path, "%s.tmp", http_cache.path);
+
+#ifndef _WIN32
+    // session tickets allow resuming the TLS session, keep them private to the user
+    {
+        const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        fp = fd < 0 ? NULL : fdopen(fd, "w");
+        if (fp == NULL && fd >= 0) {
+            close(fd);
+        }
+    }
+#else
+    fp = fopen(tmp_path, "w");
+#endif
+    if (fp == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < http_cache.dns_count; i++) {
+        const struct http_cache_dns *entry = &http_cache.dns[i];
+        if (entry->expires > now) {
+            fprintf(fp, "dns %lld %s %ld %s\n", (long long)entry->expires, entry->host, entry->port, entry->ip);
+        }
+    }
+
+#ifdef HTTP_CACHE_TLS_SESSIONS
+    if (http_session.share) {
+        // the sessions live in the share, any handle attached to it can export them
+        CURL *curl = libcurl._curl_easy_init();
+        if (curl) {
+            libcurl._curl_easy_setopt(curl, CURLOPT_SHARE, http_session.share);
+            curl_easy_ssls_export(curl, http_cache_tls_export, fp);
+            libcurl._curl_easy_cleanup(curl);
+        }
+    }
+#endif
+
+    if (fclose(fp) != 0 || rename_replace(tmp_path, http_cache.path) != 0) {
+        remove(tmp_path);
+    }
+}
+
+// Hands the sessions read from the cache file to the shared session cache, once
+static void http_cache_tls_import(CURL *curl) {
+#ifdef HTTP_CACHE_TLS_SESSIONS
+    if (http_cache.tls_imported) {
+        return;
+    }
+    http_cache.tls_imported = 1;
+
+    for (struct http_cache_tls *entry = http_cache.tls; entry != NULL; entry = entry->next) {
+        curl_easy_ssls_import(curl, entry->session_key, entry->shmac, entry->shmac_len, entry->sdata,
+                              entry->sdata_len);
+    }
+#else
+    (void)curl;
+#endif
+    http_cache_tls_free_all();
+}
+
+static struct curl_slist *http_headers_build(const char **h) {
+    struct curl_slist *headers = NULL, *nheaders;
+
     for (int i = 0; h[i] != NULL; i++) {
         nheaders = libcurl._curl_slist_append(headers, h[i]);
         if (nheaders == NULL) {
-            goto err;
+            libcurl._curl_slist_free_all(headers);
+            return NULL;
         }
         headers = nheaders;
     }
+
+    return headers;
+}
+
+// The header list is the same lpa_header for every ES9+ call, only rebuild it when it changes.
+// While requests still in flight use the cached list a different one goes to *owned instead.
+static struct curl_slist *http_session_headers(const char **h, struct curl_slist **owned) {
+    struct curl_slist *cached = http_session.headers;
+    int i;
+
+    *owned = NULL;
+
+    for (i = 0; h[i] != NULL && cached != NULL; i++, cached = cached->next) {
+        if (strcmp(h[i], cached->data) != 0) {
+            break;
+        }
+    }
+    if (h[i] == NULL && cached == NULL) {
+        return http_session.headers;
+    }
+
+    if (http_session.active != NULL) {
+        return *owned = http_headers_build(h);
+    }
+
+    libcurl._curl_slist_free_all(http_session.headers);
+    http_session.headers = http_headers_build(h);
+
+    return http_session.headers;
+}
+
+// Length of the scheme://host:port part of a URL, requests to the same origin share a connection
+static size_t http_url_origin_len(const char *url) {
+    const char *authority = strstr(url, "://");
+
+    authority = authority ? authority + 3 : url;
+    return authority - url + strcspn(authority, "/?#");
+}
+
+static void http_prewarm_wait(const char *url);
+
+static uint64_t http_getinfo_off_t(CURL *curl, CURLINFO info) {
+    curl_off_t value = 0;
+
+    if (libcurl._curl_easy_getinfo(curl, info, &value) != CURLE_OK || value < 0) {
+        return 0;
+    }
+    return value;
+}
+
+static void http_transfer_info_collect(CURL *curl, struct euicc_http_transfer_info *info) {
+    info->bytes_received_wire = http_getinfo_off_t(curl, CURLINFO_SIZE_DOWNLOAD_T);
+    if (info->bytes_received_wire == 0) {
+        info->bytes_received_wire = info->bytes_received;
+    }
+    // libcurl reports every phase in microseconds since the start of the transfer
+    info->time_namelookup_us = http_getinfo_off_t(curl, CURLINFO_NAMELOOKUP_TIME_T);
+    info->time_connect_us = http_getinfo_off_t(curl, CURLINFO_CONNECT_TIME_T);
+    info->time_tls_us = http_getinfo_off_t(curl, CURLINFO_APPCONNECT_TIME_T);
+    info->time_first_byte_us = http_getinfo_off_t(curl, CURLINFO_STARTTRANSFER_TIME_T);
+    info->time_total_us = http_getinfo_off_t(curl, CURLINFO_TOTAL_TIME_T);
+}
+
+static void http_request_resolve(struct http_request *req, const char *entry, long connect_timeout) {
+    if (req->resolve) {
+        libcurl._curl_slist_free_all(req->resolve);
+    }
+    req->resolve = libcurl._curl_slist_append(NULL, entry);
+    libcurl._curl_easy_setopt(req->curl, CURLOPT_RESOLVE, req->resolve);
+    libcurl._curl_easy_setopt(req->curl, CURLOPT_CONNECTTIMEOUT, connect_timeout);
+}
+
+static void http_request_free(struct http_request *req) {
+    if (req->curl) {
+        if (req->resolve) {
+            libcurl._curl_easy_setopt(req->curl, CURLOPT_RESOLVE, NULL);
+        }
+        if (http_session.idle_count < HTTP_IDLE_HANDLES) {
+            http_session.idle[http_session.idle_count++] = req->curl;
+        } else {
+            libcurl._curl_easy_cleanup(req->curl);
+        }
+    }
+    if (req->resolve) {
+        libcurl._curl_slist_free_all(req->resolve);
+    }
+    if (req->headers) {
+        libcurl._curl_slist_free_all(req->headers);
+    }
+    free(req->response.data);
+    free(req->prewarm_url);
+    free(req->record_url);
+    free(req->record_tx.data);
+    free(req->record_rx.data);
+    free(req);
+}
+
+static int http_socket_callback(__attribute__((unused)) CURL *curl, curl_socket_t fd, int what,
+                                __attribute__((unused)) void *userp, void *socketp) {
+    struct http_socket *sock = socketp;
+    struct http_socket **psock;
+
+    if (what == CURL_POLL_REMOVE) {
+        for (psock = &http_session.sockets; *psock != NULL; psock = &(*psock)->next) {
+            if (*psock == sock) {
+                *psock = sock->next;
+                http_session.sockets_count--;
+                free(sock);
+                break;
+            }
+        }
+        return 0;
+    }
+
+    if (sock == NULL) {
+        if ((sock = calloc(1, sizeof(*sock))) == NULL) {
+            return -1;
+        }
+        sock->fd = fd;
+        sock->next = http_session.sockets;
+        http_session.sockets = sock;
+        http_session.sockets_count++;
+        libcurl._curl_multi_assign(http_session.multi, fd, sock);
+    }
+    sock->what = what;
+
+    return 0;
+}
+
+static struct http_request *http_request_start(struct euicc_ctx *ctx, const char *url, const uint8_t *tx,
+                                               uint32_t tx_len, const char **h,
+                                               size_t (*write_callback)(void *, size_t, size_t, void *),
+                                               void *write_data,
+                                               void (*callback)(struct euicc_ctx *ctx,
+                                                                struct euicc_http_response *response,
+                                                                void *userdata),
+                                               void *userdata, bool prewarm) {
+    struct http_request *req = NULL;
+    struct curl_slist *headers;
+    CURL *curl;
+    char resolve_entry[sizeof(req->host) + 96];
+
+    // a half-done prewarm would otherwise race this request with a second connection
+    http_prewarm_wait(url);
+
+    if (http_session.multi == NULL) {
+        http_session.multi = libcurl._curl_multi_init();
+        if (http_session.multi == NULL) {
+            goto err;
+        }
+        libcurl._curl_multi_setopt(http_session.multi, CURLMOPT_SOCKETFUNCTION, http_socket_callback);
+    }
+
+    req = calloc(1, sizeof(*req));
+    if (req == NULL) {
+        goto err;
+    }
+    req->ctx = ctx;
+    req->write_callback = write_callback ? write_callback : http_trans_write_callback;
+    req->write_data = write_callback ? write_data : &req->response;
+    req->callback = callback;
+    req->userdata = userdata;
+    req->info.bytes_sent = tx ? tx_len : 0;
+    req->prewarm = prewarm;
+    if (prewarm && (req->prewarm_url = strdup(url)) == NULL) {
+        goto err;
+    }
+
+    if (http_session.idle_count > 0) {
+        // drops the options of the previous request, the connections stay in the share
+        req->curl = http_session.idle[--http_session.idle_count];
+        libcurl._curl_easy_reset(req->curl);
+    } else {
+        req->curl = libcurl._curl_easy_init();
+        if (req->curl == NULL) {
+            goto err;
+        }
+    }
+    curl = req->curl;
+
+    if (prewarm) {
+        headers = NULL;
+    } else if ((headers = http_session_headers(h, &req->headers)) == NULL && h[0] != NULL) {
+        goto err;
+    }
+
+    libcurl._curl_easy_setopt(curl, CURLOPT_URL, url);
+    libcurl._curl_easy_setopt(curl, CURLOPT_PRIVATE, req);
+    libcurl._curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_write_proxy_callback);
+    libcurl._curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+    // offer every content encoding this libcurl can decode, the body is decoded before the callback
+    libcurl._curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    libcurl._curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    libcurl._curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    libcurl._curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
     libcurl._curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    req->headers_used = headers;
+    if (http_session.share) {
+        libcurl._curl_easy_setopt(curl, CURLOPT_SHARE, http_session.share);
+    }
+    if (prewarm) {
+        // unlike CONNECT_ONLY, a connection that carried a normal request goes back to the
+        // connection cache of the multi handle and is picked up by the next request
+        libcurl._curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    }
 
     if (tx != NULL) {
-        libcurl._curl_easy_setopt(curl, CURLOPT_POSTFIELDS, tx);
-        libcurl._curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, tx_len);
+        // copied, the caller of async_submit may release tx right away
+        libcurl._curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)tx_len);
+        libcurl._curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, tx);
+    }
+
+    if (http_session.record && !prewarm) {
+        req->record_url = strdup(url);
+        if (req->record_url == NULL) {
+            goto err;
+        }
+        if (tx != NULL && tx_len > 0) {
+            req->record_tx.data = malloc(tx_len);
+            if (req->record_tx.data == NULL) {
+                goto err;
+            }
+            memcpy(req->record_tx.data, tx, tx_len);
+            req->record_tx.size = tx_len;
+        }
     }
 
-    res = libcurl._curl_easy_perform(curl);
+    if (http_cache.path) {
+        http_cache_tls_import(curl);
+        req->cacheable = http_url_host_port(url, req->host, sizeof(req->host), &req->port);
+        if (req->cacheable && (req->cached = http_cache_dns_find(req->host, req->port)) != NULL) {
+            snprintf(resolve_entry, sizeof(resolve_entry),
+                     strchr(req->cached->ip, ':') ? "%s:%ld:[%s]" : "%s:%ld:%s", req->host, req->port,
+                     req->cached->ip);
+            // fail fast on a stale address, a fresh lookup follows
+            http_request_resolve(req, resolve_entry, HTTP_CACHE_CONNECT_TIMEOUT);
+        }
+    }
 
-    if (res != CURLE_OK) {
-        fprintf(stderr, "curl_easy_perform() failed: %s\n", libcurl._curl_easy_strerror(res));
+    if (libcurl._curl_multi_add_handle(http_session.multi, curl) != CURLM_OK) {
         goto err;
     }
 
-    libcurl._curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    *rcode = response_code;
-    *rx = responseData.data;
-    *rx_len = responseData.size;
+    req->next = http_session.active;
+    http_session.active = req;
 
-    fret = 0;
-    goto exit;
+    return req;
 
 err:
-    fret = -1;
-    free(responseData.data);
-exit:
-    libcurl._curl_easy_cleanup(curl);
-    libcurl._curl_slist_free_all(headers);
-    return fret;
+    if (req) {
+        http_request_free(req);
+    }
+    return NULL;
+}
+
+static void http_request_unlink(struct http_request *req) {
+    for (struct http_request **p = &http_session.active; *p != NULL; p = &(*p)->next) {
+        if (*p == req) {
+            *p = req->next;
+            break;
+        }
+    }
+}
+
+// Appends a finished exchange to the trace, the headers are the list curl actually sent
+static void http_record(struct http_request *req, uint32_t rcode) {
+    const struct http_trans_response_data *rx = req->write_data == &req->response ? &req->response : &req->record_rx;
+    _cleanup_free_ const char **h = NULL;
+    int n = 0;
+
+    for (struct curl_slist *l = req->headers_used; l != NULL; l = l->next) {
+        n++;
+    }
+    h = calloc(n + 1, sizeof(char *));
+    if (h == NULL) {
+        return;
+    }
+    n = 0;
+    for (struct curl_slist *l = req->headers_used; l != NULL; l = l->next) {
+        h[n++] = l->data;
+    }
+
+    if (http_trace_write(http_session.record, http_session.record_index, req->record_url, h, req->record_tx.data,
+                         req->record_tx.size, rcode, rx->data, rx->size, req->info.time_total_us)
+        < 0) {
+        fprintf(stderr, "failed to record request to %s\n", req->record_url);
+        return;
+    }
+    http_session.record_index++;
+}
+
+static void http_request_done(struct http_request *req, CURLcode res) {
+    struct euicc_http_response response = {0};
+    char resolve_entry[sizeof(req->host) + 2 + 32];
+    long response_code = 0;
+
+    libcurl._curl_multi_remove_handle(http_session.multi, req->curl);
+
+    if (req->cached != NULL
+        && (res == CURLE_COULDNT_CONNECT || res == CURLE_OPERATION_TIMEDOUT || res == CURLE_SSL_CONNECT_ERROR)) {
+        // the cached address went stale, forget it and let curl resolve the name again
+        req->cached->expires = 0;
+        req->cached = NULL;
+        snprintf(resolve_entry, sizeof(resolve_entry), "-%s:%ld", req->host, req->port);
+        http_request_resolve(req, resolve_entry, 0L);
+        req->info.bytes_received = 0;
+        free(req->record_rx.data);
+        req->record_rx.data = NULL;
+        req->record_rx.size = 0;
+        if (libcurl._curl_multi_add_handle(http_session.multi, req->curl) == CURLM_OK) {
+            return;
+        }
+    }
+
+    http_request_unlink(req);
+
+    if (req->prewarm) {
+        // failures are not reported, the real request simply connects by itself
+        http_request_free(req);
+        return;
+    }
+
+    if (res != CURLE_OK) {
+        fprintf(stderr, "curl request failed: %s\n", libcurl._curl_easy_strerror(res));
+        response.result = -1;
+    } else {
+        libcurl._curl_easy_getinfo(req->curl, CURLINFO_RESPONSE_CODE, &response_code);
+        response.rcode = response_code;
+        http_transfer_info_collect(req->curl, &req->info);
+
+        if (req->cacheable && req->cached == NULL) {
+            // only freshly resolved addresses are stored, so the TTL bounds the age of every entry
+            char *ip = NULL;
+            if (libcurl._curl_easy_getinfo(req->curl, CURLINFO_PRIMARY_IP, &ip) == CURLE_OK && ip != NULL && ip[0]) {
+                http_cache_dns_store(req->host, req->port, ip);
+            }
+        }
+
+        if (http_session.record) {
+            http_record(req, response.rcode);
+        }
+    }
+
+    response.info = req->info;
+    http_session.last = req->info;
+
+    if (res == CURLE_OK && req->write_data == &req->response) {
+        response.rx = req->response.data;
+        response.rx_len = req->response.size;
+        req->response.data = NULL;
+    }
+
+    if (req->callback) {
+        req->callback(req->ctx, &response, req->userdata);
+    } else {
+        free(response.rx);
+    }
+
+    http_request_free(req);
+}
+
+static int http_socket_action(curl_socket_t fd, int ev_bitmask) {
+    CURLMcode mres;
+    int running;
+
+    mres = libcurl._curl_multi_socket_action(http_session.multi, fd, ev_bitmask, &running);
+    if (mres != CURLM_OK) {
+        fprintf(stderr, "curl_multi_socket_action() failed: %s\n", libcurl._curl_multi_strerror(mres));
+        return -1;
+    }
+    return 0;
+}
+
+// Hands the finished transfers to their callbacks, returns the number of requests still in flight
+static int http_collect(void) {
+    CURLMsg *msg;
+    int queued, active = 0;
+
+    while ((msg = libcurl._curl_multi_info_read(http_session.multi, &queued)) != NULL) {
+        struct http_request *req = NULL;
+
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        libcurl._curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+        if (req != NULL) {
+            http_request_done(req, msg->data.result);
+        }
+    }
+
+    // prewarms are not the caller's requests, they do not keep it waiting
+    for (struct http_request *req = http_session.active; req != NULL; req = req->next) {
+        if (!req->prewarm) {
+            active++;
+        }
+    }
+
+    return active;
+}
+
+// Not told which sockets are ready, every socket curl watches gets a turn (curl checks it itself),
+// then the expired timers, which also start the requests submitted since the last call
+static int http_dispatch(void) {
+    _cleanup_free_ curl_socket_t *fds = NULL;
+    uint32_t n = 0;
+
+    if (http_session.multi == NULL) {
+        return 0;
+    }
+
+    // copied first, the socket callback edits the list while curl runs
+    if (http_session.sockets_count > 0) {
+        if ((fds = malloc(http_session.sockets_count * sizeof(*fds))) == NULL) {
+            return -1;
+        }
+        for (struct http_socket *sock = http_session.sockets; sock != NULL; sock = sock->next) {
+            fds[n++] = sock->fd;
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (http_socket_action(fds[i], 0) < 0) {
+            return -1;
+        }
+    }
+    if (http_socket_action(CURL_SOCKET_TIMEOUT, 0) < 0) {
+        return -1;
+    }
+
+    return http_collect();
+}
+
+static int http_wait(int timeout_ms) {
+    CURLMcode mres;
+
+    if (http_session.active == NULL) {
+        return 0;
+    }
+
+    // returns early when curl has a timer of its own to serve, e.g. right after a submit
+    mres = libcurl._curl_multi_wait(http_session.multi, NULL, 0, timeout_ms, NULL);
+    if (mres != CURLM_OK) {
+        fprintf(stderr, "curl_multi_wait() failed: %s\n", libcurl._curl_multi_strerror(mres));
+        return -1;
+    }
+
+    return http_dispatch();
+}
+
+static bool http_prewarm_pending(const char *url) {
+    const size_t origin_len = http_url_origin_len(url);
+
+    for (struct http_request *req = http_session.active; req != NULL; req = req->next) {
+        if (req->prewarm && http_url_origin_len(req->prewarm_url) == origin_len
+            && strncasecmp(req->prewarm_url, url, origin_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drives the multi handle until the prewarm of url's origin is done, requests to other servers
+// (their prewarms included) progress meanwhile but are not waited for
+static void http_prewarm_wait(const char *url) {
+    while (http_prewarm_pending(url)) {
+        if (http_wait(1000) < 0) {
+            break;
+        }
+    }
+}
+
+// The HEAD runs on the multi handle like any other request: the name lookup and the TCP connect go
+// on in the background, the TLS handshake advances whenever the multi handle is driven again
+static int http_interface_prewarm(struct euicc_ctx *ctx, const char *url) {
+    // a second prewarm of the same server would only open a second connection
+    http_prewarm_wait(url);
+
+    if (http_request_start(ctx, url, NULL, 0, NULL, NULL, NULL, NULL, NULL, true) == NULL) {
+        return -1;
+    }
+
+    // gets the lookup (or the connect, with a cached address) going before the caller turns to the eUICC
+    return http_dispatch() < 0 ? -1 : 0;
+}
+
+struct http_blocking_result {
+    bool done;
+    struct euicc_http_response response;
+};
+
+static void http_blocking_callback(__attribute__((unused)) struct euicc_ctx *ctx,
+                                   struct euicc_http_response *response, void *userdata) {
+    struct http_blocking_result *result = userdata;
+
+    result->response = *response;
+    result->done = true;
+}
+
+// The blocking calls submit a single request and drive the multi handle until it completes
+static int http_transmit(struct euicc_ctx *ctx, uint32_t *rcode, uint8_t **rx, uint32_t *rx_len,
+                         size_t (*write_callback)(void *, size_t, size_t, void *), void *write_data, const char *url,
+                         const uint8_t *tx, uint32_t tx_len, const char **h) {
+    struct http_blocking_result result = {0};
+    struct http_request *req;
+
+    (*rcode) = 0;
+
+    req = http_request_start(ctx, url, tx, tx_len, h, write_callback, write_data, http_blocking_callback, &result,
+                             false);
+    if (req == NULL) {
+        return -1;
+    }
+
+    while (!result.done) {
+        if (http_wait(1000) < 0) {
+            // the callback and the write data live on this stack frame, the request must not outlive it
+            if (!result.done) {
+                libcurl._curl_multi_remove_handle(http_session.multi, req->curl);
+                http_request_unlink(req);
+                http_request_free(req);
+            }
+            break;
+        }
+    }
+    if (!result.done) {
+        return -1;
+    }
+
+    if (result.response.result < 0) {
+        return -1;
+    }
+
+    *rcode = result.response.rcode;
+    if (rx) {
+        *rx = result.response.rx;
+        *rx_len = result.response.rx_len;
+    }
+
+    return 0;
+}
+
+static int http_interface_transmit(struct euicc_ctx *ctx, const char *url, uint32_t *rcode, uint8_t **rx,
+                                   uint32_t *rx_len, const uint8_t *tx, uint32_t tx_len, const char **h) {
+    (*rx) = NULL;
+
+    return http_transmit(ctx, rcode, rx, rx_len, NULL, NULL, url, tx, tx_len, h);
+}
+
+static int http_interface_transmit_stream(struct euicc_ctx *ctx, const char *url, uint32_t *rcode,
+                                          int (*rx_callback)(const uint8_t *data, uint32_t data_len, void *userdata),
+                                          void *rx_userdata, const uint8_t *tx, uint32_t tx_len, const char **h) {
+    struct http_trans_stream_data stream = {
+        .callback = rx_callback,
+        .userdata = rx_userdata,
+    };
+
+    return http_transmit(ctx, rcode, NULL, NULL, http_trans_stream_write_callback, &stream, url, tx, tx_len, h);
+}
+
+static int http_interface_transfer_info(__attribute__((unused)) struct euicc_ctx *ctx,
+                                        struct euicc_http_transfer_info *info) {
+    *info = http_session.last;
+    return 0;
+}
+
+static int http_interface_async_submit(struct euicc_ctx *ctx, const char *url, const uint8_t *tx, uint32_t tx_len,
+                                       const char **h,
+                                       void (*callback)(struct euicc_ctx *ctx, struct euicc_http_response *response,
+                                                        void *userdata),
+                                       void *userdata) {
+    return http_request_start(ctx, url, tx, tx_len, h, NULL, NULL, callback, userdata, false) ? 0 : -1;
+}
+
+static int http_interface_async_fds(__attribute__((unused)) struct euicc_ctx *ctx, struct euicc_http_pollfd *fds,
+                                    uint32_t *fds_count, long *timeout_ms) {
+    uint32_t n = 0;
+
+    *timeout_ms = -1;
+
+    if (http_session.multi == NULL) {
+        *fds_count = 0;
+        return 0;
+    }
+
+    if (http_session.sockets_count > *fds_count) {
+        *fds_count = http_session.sockets_count;
+        return 1;
+    }
+
+    // also covers what has no socket yet, e.g. a name lookup curl polls on a timer
+    if (libcurl._curl_multi_timeout(http_session.multi, timeout_ms) != CURLM_OK) {
+        return -1;
+    }
+
+    for (struct http_socket *sock = http_session.sockets; sock != NULL; sock = sock->next) {
+        fds[n].fd = (int)sock->fd;
+        fds[n].events = ((sock->what & CURL_POLL_IN) ? EUICC_HTTP_POLL_IN : 0)
+                        | ((sock->what & CURL_POLL_OUT) ? EUICC_HTTP_POLL_OUT : 0);
+        n++;
+    }
+
+    *fds_count = n;
+    return 0;
+}
+
+static int http_interface_async_dispatch(__attribute__((unused)) struct euicc_ctx *ctx) {
+    return http_dispatch();
+}
+
+static int http_interface_async_dispatch_fds(__attribute__((unused)) struct euicc_ctx *ctx,
+                                             const struct euicc_http_pollfd *fds, uint32_t fds_count) {
+    if (http_session.multi == NULL) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < fds_count; i++) {
+        int ev_bitmask = ((fds[i].events & EUICC_HTTP_POLL_IN) ? CURL_CSELECT_IN : 0)
+                         | ((fds[i].events & EUICC_HTTP_POLL_OUT) ? CURL_CSELECT_OUT : 0)
+                         | ((fds[i].events & EUICC_HTTP_POLL_ERR) ? CURL_CSELECT_ERR : 0);
+        if (http_socket_action((curl_socket_t)fds[i].fd, ev_bitmask) < 0) {
+            return -1;
+        }
+    }
+    if (http_socket_action(CURL_SOCKET_TIMEOUT, 0) < 0) {
+        return -1;
+    }
+
+    return http_collect();
+}
+
+static int http_interface_async_wait(__attribute__((unused)) struct euicc_ctx *ctx, int timeout_ms) {
+    return http_wait(timeout_ms);
 }
 
 static int _init_libcurl(void) {
@@ -141,8 +1205,23 @@ static int _init_libcurl(void) {
     libcurl._curl_easy_getinfo = dlsym(libcurl_interface_dlhandle, "curl_easy_getinfo");
     libcurl._curl_easy_strerror = dlsym(libcurl_interface_dlhandle, "curl_easy_strerror");
     libcurl._curl_easy_cleanup = dlsym(libcurl_interface_dlhandle, "curl_easy_cleanup");
+    libcurl._curl_easy_reset = dlsym(libcurl_interface_dlhandle, "curl_easy_reset");
     libcurl._curl_slist_append = dlsym(libcurl_interface_dlhandle, "curl_slist_append");
     libcurl._curl_slist_free_all = dlsym(libcurl_interface_dlhandle, "curl_slist_free_all");
+    libcurl._curl_share_init = dlsym(libcurl_interface_dlhandle, "curl_share_init");
+    libcurl._curl_share_setopt = dlsym(libcurl_interface_dlhandle, "curl_share_setopt");
+    libcurl._curl_share_cleanup = dlsym(libcurl_interface_dlhandle, "curl_share_cleanup");
+    libcurl._curl_multi_init = dlsym(libcurl_interface_dlhandle, "curl_multi_init");
+    libcurl._curl_multi_add_handle = dlsym(libcurl_interface_dlhandle, "curl_multi_add_handle");
+    libcurl._curl_multi_remove_handle = dlsym(libcurl_interface_dlhandle, "curl_multi_remove_handle");
+    libcurl._curl_multi_setopt = dlsym(libcurl_interface_dlhandle, "curl_multi_setopt");
+    libcurl._curl_multi_assign = dlsym(libcurl_interface_dlhandle, "curl_multi_assign");
+    libcurl._curl_multi_socket_action = dlsym(libcurl_interface_dlhandle, "curl_multi_socket_action");
+    libcurl._curl_multi_info_read = dlsym(libcurl_interface_dlhandle, "curl_multi_info_read");
+    libcurl._curl_multi_wait = dlsym(libcurl_interface_dlhandle, "curl_multi_wait");
+    libcurl._curl_multi_timeout = dlsym(libcurl_interface_dlhandle, "curl_multi_timeout");
+    libcurl._curl_multi_strerror = dlsym(libcurl_interface_dlhandle, "curl_multi_strerror");
+    libcurl._curl_multi_cleanup = dlsym(libcurl_interface_dlhandle, "curl_multi_cleanup");
 #else
     libcurl._curl_global_init = curl_global_init;
     libcurl._curl_easy_init = curl_easy_init;
@@ -151,8 +1230,23 @@ static int _init_libcurl(void) {
     libcurl._curl_easy_getinfo = curl_easy_getinfo;
     libcurl._curl_easy_strerror = curl_easy_strerror;
     libcurl._curl_easy_cleanup = curl_easy_cleanup;
+    libcurl._curl_easy_reset = curl_easy_reset;
     libcurl._curl_slist_append = curl_slist_append;
     libcurl._curl_slist_free_all = curl_slist_free_all;
+    libcurl._curl_share_init = curl_share_init;
+    libcurl._curl_share_setopt = curl_share_setopt;
+    libcurl._curl_share_cleanup = curl_share_cleanup;
+    libcurl._curl_multi_init = curl_multi_init;
+    libcurl._curl_multi_add_handle = curl_multi_add_handle;
+    libcurl._curl_multi_remove_handle = curl_multi_remove_handle;
+    libcurl._curl_multi_setopt = curl_multi_setopt;
+    libcurl._curl_multi_assign = curl_multi_assign;
+    libcurl._curl_multi_socket_action = curl_multi_socket_action;
+    libcurl._curl_multi_info_read = curl_multi_info_read;
+    libcurl._curl_multi_wait = curl_multi_wait;
+    libcurl._curl_multi_timeout = curl_multi_timeout;
+    libcurl._curl_multi_strerror = curl_multi_strerror;
+    libcurl._curl_multi_cleanup = curl_multi_cleanup;
 #endif
 
     return 0;
@@ -169,12 +1263,85 @@ static int libhttpinterface_init(struct euicc_http_interface *ifstruct) {
         return -1;
     }
 
+    // resolved names and TLS sessions live in a share, so every handle of the driver can use them
+    http_session.share = libcurl._curl_share_init();
+    if (http_session.share) {
+        libcurl._curl_share_setopt(http_session.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        libcurl._curl_share_setopt(http_session.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    http_cache_load();
+
+    if (getenv(ENV_RECORD) != NULL) {
+        // appended to, so several lpac runs (download, then notification process) make one trace
+#ifndef _WIN32
+        // the requests carry the EID and the eUICC's signatures, keep the trace private to the user
+        const int fd = open(getenv(ENV_RECORD), O_RDWR | O_APPEND | O_CREAT, 0600);
+        http_session.record = fd < 0 ? NULL : fdopen(fd, "a+");
+        if (http_session.record == NULL && fd >= 0) {
+            close(fd);
+        }
+#else
+        http_session.record = fopen(getenv(ENV_RECORD), "a+");
+#endif
+        if (http_session.record == NULL) {
+            fprintf(stderr, "failed to open %s\n", getenv(ENV_RECORD));
+            return -1;
+        }
+        http_session.record_index = http_trace_count(http_session.record);
+        fseek(http_session.record, 0, SEEK_END);
+    }
+
     ifstruct->transmit = http_interface_transmit;
+    ifstruct->transmit_stream = http_interface_transmit_stream;
+    ifstruct->transfer_info = http_interface_transfer_info;
+    ifstruct->prewarm = http_interface_prewarm;
+    ifstruct->async_submit = http_interface_async_submit;
+    ifstruct->async_fds = http_interface_async_fds;
+    ifstruct->async_dispatch = http_interface_async_dispatch;
+    ifstruct->async_wait = http_interface_async_wait;
+    ifstruct->async_dispatch_fds = http_interface_async_dispatch_fds;
 
     return 0;
 }
 
-static void libhttpinterface_fini(struct euicc_http_interface *ifstruct) {}
+static void libhttpinterface_fini(struct euicc_http_interface *ifstruct) {
+    http_cache_save();
+    http_cache_tls_free_all();
+
+    while (http_session.active) {
+        // abandoned async requests and unfinished prewarms, their callbacks never run
+        struct http_request *req = http_session.active;
+        http_session.active = req->next;
+        libcurl._curl_multi_remove_handle(http_session.multi, req->curl);
+        http_request_free(req);
+    }
+    while (http_session.idle_count > 0) {
+        libcurl._curl_easy_cleanup(http_session.idle[--http_session.idle_count]);
+    }
+    if (http_session.multi) {
+        libcurl._curl_multi_cleanup(http_session.multi);
+        http_session.multi = NULL;
+    }
+    while (http_session.sockets) {
+        struct http_socket *sock = http_session.sockets;
+        http_session.sockets = sock->next;
+        free(sock);
+    }
+    http_session.sockets_count = 0;
+    if (http_session.headers) {
+        libcurl._curl_slist_free_all(http_session.headers);
+        http_session.headers = NULL;
+    }
+    if (http_session.record) {
+        fclose(http_session.record);
+        http_session.record = NULL;
+    }
+    if (http_session.share) {
+        libcurl._curl_share_cleanup(http_session.share);
+        http_session.share = NULL;
+    }
+}
 
 const struct euicc_driver driver_http_curl = {
     .type = DRIVER_HTTP,
@@ -0,0 +1,325 @@
+#include "relay.h"
+
+#include <cjson/cJSON_ex.h>
+#include <euicc/hexutil.h>
+#include <euicc/interface.h>
+#include <lpac/utils.h>
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define ENV_RELAY_ADDRESS HTTP_ENV_NAME(RELAY, ADDRESS)
+
+#define RELAY_READ_CHUNK 16384
+
+#ifndef MSG_NOSIGNAL
+// macOS has no MSG_NOSIGNAL, SO_NOSIGPIPE is set on the socket instead
+#    define MSG_NOSIGNAL 0
+#endif
+
+// Hands the ES9+/ES11 requests to an lpac-relay process over a stream socket, one JSON line each way
+// in the format of the stdio backend. The relay holds the TLS connections to the servers, and keeps
+// them warm across devices, so there is no prewarm here.
+static struct {
+    char *address;
+    int fd;
+    char *buffer;
+    size_t buffer_len;
+    size_t buffer_size;
+    size_t line_len; // of the line handed out last, newline included
+} relay = {.fd = -1};
+
+static int relay_connect_unix(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int relay_connect_tcp(const char *address) {
+    _cleanup_free_ char *host = NULL;
+    const char *port;
+    struct addrinfo hints, *result = NULL, *ai;
+    int fd = -1;
+
+    // host:port or [v6 address]:port
+    port = strrchr(address, ':');
+    if (port == NULL || port == address) {
+        return -1;
+    }
+    if (address[0] == '[' && port[-1] == ']') {
+        host = malloc(port - address - 1);
+        if (host == NULL) {
+            return -1;
+        }
+        memcpy(host, address + 1, port - address - 2);
+        host[port - address - 2] = '\0';
+    } else {
+        host = malloc(port - address + 1);
+        if (host == NULL) {
+            return -1;
+        }
+        memcpy(host, address, port - address);
+        host[port - address] = '\0';
+    }
+    port++;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &result) != 0) {
+        return -1;
+    }
+
+    for (ai = result; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    return fd;
+}
+
+static int relay_connect(void) {
+    if (relay.fd >= 0) {
+        return 0;
+    }
+
+    if (strncmp(relay.address, "unix:", 5) == 0) {
+        relay.fd = relay_connect_unix(relay.address + 5);
+    } else {
+        relay.fd = relay_connect_tcp(relay.address);
+    }
+    if (relay.fd < 0) {
+        fprintf(stderr, "relay: failed to connect to %s\n", relay.address);
+        return -1;
+    }
+
+#ifdef SO_NOSIGPIPE
+    setsockopt(relay.fd, SOL_SOCKET, SO_NOSIGPIPE, &(int){1}, sizeof(int));
+#endif
+
+    relay.buffer_len = 0;
+    relay.line_len = 0;
+
+    return 0;
+}
+
+static void relay_disconnect(void) {
+    if (relay.fd >= 0) {
+        close(relay.fd);
+        relay.fd = -1;
+    }
+    relay.buffer_len = 0;
+    relay.line_len = 0;
+}
+
+static int relay_send(const char *type, cJSON *jpayload) {
+    _cleanup_cjson_ cJSON *jroot = NULL;
+    _cleanup_free_ char *line = NULL;
+    size_t len, sent = 0;
+
+    if ((jroot = cJSON_CreateObject()) == NULL) {
+        cJSON_Delete(jpayload);
+        return -1;
+    }
+    cJSON_AddStringToObject(jroot, "type", type);
+    cJSON_AddItemToObject(jroot, "payload", jpayload);
+
+    if ((line = cJSON_PrintUnformatted(jroot)) == NULL) {
+        return -1;
+    }
+    len = strlen(line);
+    line[len++] = '\n'; // replaces the terminator, the line is sent by length
+
+    while (sent < len) {
+        const ssize_t n = send(relay.fd, line + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+
+    return 0;
+}
+
+// The next line from the relay without its newline, valid until the following call
+static char *relay_receive_line(void) {
+    char *newline;
+
+    // drop the line returned by the previous call
+    if (relay.line_len > 0) {
+        memmove(relay.buffer, relay.buffer + relay.line_len, relay.buffer_len - relay.line_len);
+        relay.buffer_len -= relay.line_len;
+        relay.line_len = 0;
+    }
+
+    while ((newline = relay.buffer_len ? memchr(relay.buffer, '\n', relay.buffer_len) : NULL) == NULL) {
+        ssize_t n;
+
+        if (relay.buffer_size - relay.buffer_len < RELAY_READ_CHUNK) {
+            char *nbuffer = realloc(relay.buffer, relay.buffer_size + RELAY_READ_CHUNK);
+            if (nbuffer == NULL) {
+                return NULL;
+            }
+            relay.buffer = nbuffer;
+            relay.buffer_size += RELAY_READ_CHUNK;
+        }
+
+        n = recv(relay.fd, relay.buffer + relay.buffer_len, relay.buffer_size - relay.buffer_len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return NULL;
+        }
+        relay.buffer_len += n;
+    }
+
+    *newline = '\0';
+    relay.line_len = newline - relay.buffer + 1;
+    return relay.buffer;
+}
+
+// {"type":"http","payload":{"rcode":404,"rx":"333435"}}, without rcode when the relay could not reach the server
+static int http_interface_transmit(__attribute__((unused)) struct euicc_ctx *ctx, const char *url, uint32_t *rcode,
+                                   uint8_t **rx, uint32_t *rx_len, const uint8_t *tx, uint32_t tx_len,
+                                   const char **headers) {
+    _cleanup_cjson_ cJSON *jresponse = NULL;
+    _cleanup_free_ char *tx_hex = NULL;
+    cJSON *jpayload, *jheaders, *jtmp;
+    const char *line;
+
+    *rx = NULL;
+    *rx_len = 0;
+
+    if (relay_connect() < 0) {
+        return -1;
+    }
+
+    tx_hex = malloc((2 * tx_len) + 1);
+    if (tx_hex == NULL || euicc_hexutil_bin2hex(tx_hex, (2 * tx_len) + 1, tx, tx_len) < 0) {
+        return -1;
+    }
+
+    jpayload = cJSON_CreateObject();
+    if (jpayload == NULL) {
+        return -1;
+    }
+    cJSON_AddStringToObject(jpayload, "url", url);
+    cJSON_AddStringToObject(jpayload, "tx", tx_hex);
+    jheaders = cJSON_AddArrayToObject(jpayload, "headers");
+    for (int i = 0; headers[i] != NULL; i++) {
+        cJSON_AddItemToArray(jheaders, cJSON_CreateString(headers[i]));
+    }
+
+    if (relay_send("http", jpayload) < 0 || (line = relay_receive_line()) == NULL) {
+        fprintf(stderr, "relay: connection to %s lost\n", relay.address);
+        relay_disconnect();
+        return -1;
+    }
+
+    jresponse = cJSON_Parse(line);
+    jtmp = cJSON_GetObjectItem(jresponse, "type");
+    if (!cJSON_IsString(jtmp) || strcmp(jtmp->valuestring, "http") != 0) {
+        goto err;
+    }
+    jpayload = cJSON_GetObjectItem(jresponse, "payload");
+
+    jtmp = cJSON_GetObjectItem(jpayload, "rcode");
+    if (!cJSON_IsNumber(jtmp)) {
+        goto err;
+    }
+    *rcode = jtmp->valueint;
+
+    jtmp = cJSON_GetObjectItem(jpayload, "rx");
+    if (!cJSON_IsString(jtmp)) {
+        goto err;
+    }
+    *rx_len = strlen(jtmp->valuestring) / 2;
+    *rx = malloc(*rx_len ? *rx_len : 1);
+    if (*rx == NULL) {
+        goto err;
+    }
+    if (euicc_hexutil_hex2bin_r(*rx, *rx_len, jtmp->valuestring, strlen(jtmp->valuestring)) < 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    free(*rx);
+    *rx = NULL;
+    *rx_len = 0;
+    return -1;
+}
+
+static int libhttpinterface_init(struct euicc_http_interface *ifstruct) {
+    const char *address;
+
+    memset(ifstruct, 0, sizeof(struct euicc_http_interface));
+
+    address = getenv(ENV_RELAY_ADDRESS);
+    if (address == NULL) {
+        fprintf(stderr, "relay: %s is not set\n", ENV_RELAY_ADDRESS);
+        return -1;
+    }
+    relay.address = strdup(address);
+    if (relay.address == NULL) {
+        return -1;
+    }
+
+    // connected on the first request, so commands without HTTP work while the relay is down
+    ifstruct->transmit = http_interface_transmit;
+
+    return 0;
+}
+
+static void libhttpinterface_fini(__attribute__((unused)) struct euicc_http_interface *ifstruct) {
+    relay_disconnect();
+    free(relay.address);
+    relay.address = NULL;
+    free(relay.buffer);
+    relay.buffer = NULL;
+    relay.buffer_size = 0;
+}
+
+const struct euicc_driver driver_http_relay = {
+    .type = DRIVER_HTTP,
+    .name = "relay",
+    .init = (int (*)(void *))libhttpinterface_init,
+    .main = NULL,
+    .fini = (void (*)(void *))libhttpinterface_fini,
+};
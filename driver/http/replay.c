@@ -0,0 +1,354 @@
+#include "replay.h"
+#include "trace.h"
+
+#include <euicc/interface.h>
+#include <lpac/utils.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define ENV_REPLAY_FILE HTTP_ENV_NAME(REPLAY, FILE)
+#define ENV_REPLAY_MATCH HTTP_ENV_NAME(REPLAY, MATCH)
+#define ENV_REPLAY_LATENCY HTTP_ENV_NAME(REPLAY, LATENCY)
+
+// streamed responses are handed out in pieces, like a network transfer would
+#define REPLAY_STREAM_CHUNK 16384
+
+struct replay_pending {
+    struct euicc_ctx *ctx;
+    const struct http_trace_record *record;
+    uint32_t tx_len;
+    uint64_t delay_us;
+    uint64_t due_us;
+    void (*callback)(struct euicc_ctx *ctx, struct euicc_http_response *response, void *userdata);
+    void *userdata;
+    struct replay_pending *next;
+};
+
+// Serves the responses of a trace recorded by the curl backend, without any network access
+static struct {
+    struct http_trace_record *records;
+    uint32_t count;
+    bool *used;
+    uint32_t next;
+    bool match_url;
+    bool latency_recorded;
+    uint64_t latency_us;
+    struct euicc_http_transfer_info last;
+    struct replay_pending *pending; // ordered by due time
+} replay;
+
+static uint64_t replay_now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void replay_sleep_us(uint64_t us) {
+    struct timespec ts = {
+        .tv_sec = us / 1000000,
+        .tv_nsec = (us % 1000000) * 1000,
+    };
+
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+static const struct http_trace_record *replay_next(const char *url) {
+    const struct http_trace_record *record = NULL;
+
+    if (replay.match_url) {
+        // the first unused response for the URL, then its last one again
+        for (uint32_t i = 0; i < replay.count; i++) {
+            if (strcmp(replay.records[i].url, url) != 0) {
+                continue;
+            }
+            record = &replay.records[i];
+            if (!replay.used[i]) {
+                replay.used[i] = true;
+                break;
+            }
+        }
+        if (record == NULL) {
+            fprintf(stderr, "replay: no recorded response for %s\n", url);
+        }
+        return record;
+    }
+
+    if (replay.next >= replay.count) {
+        fprintf(stderr, "replay: trace exhausted after %" PRIu32 " requests\n", replay.count);
+        return NULL;
+    }
+    record = &replay.records[replay.next++];
+    if (strcmp(record->url, url) != 0) {
+        fprintf(stderr, "replay: record %" PRIu32 " was recorded for %s, replaying it for %s\n", record->index,
+                record->url, url);
+    }
+
+    return record;
+}
+
+static uint64_t replay_delay_us(const struct http_trace_record *record) {
+    return replay.latency_recorded ? record->elapsed_us : replay.latency_us;
+}
+
+static void replay_transfer_info(const struct http_trace_record *record, uint32_t tx_len, uint64_t delay_us,
+                                 struct euicc_http_transfer_info *info) {
+    memset(info, 0, sizeof(*info));
+    info->bytes_sent = tx_len;
+    info->bytes_received_wire = record->rx_len;
+    info->bytes_received = record->rx_len;
+    info->time_first_byte_us = delay_us;
+    info->time_total_us = delay_us;
+}
+
+static int http_interface_transmit(__attribute__((unused)) struct euicc_ctx *ctx, const char *url, uint32_t *rcode,
+                                   uint8_t **rx, uint32_t *rx_len, __attribute__((unused)) const uint8_t *tx,
+                                   uint32_t tx_len, __attribute__((unused)) const char **headers) {
+    const struct http_trace_record *record;
+    uint64_t delay_us;
+
+    *rx = NULL;
+    *rx_len = 0;
+    *rcode = 0;
+
+    record = replay_next(url);
+    if (record == NULL) {
+        return -1;
+    }
+
+    delay_us = replay_delay_us(record);
+    replay_sleep_us(delay_us);
+
+    *rx = malloc(record->rx_len + 1);
+    if (*rx == NULL) {
+        return -1;
+    }
+    memcpy(*rx, record->rx, record->rx_len);
+    *rx_len = record->rx_len;
+    *rcode = record->rcode;
+
+    replay_transfer_info(record, tx_len, delay_us, &replay.last);
+
+    return 0;
+}
+
+static int http_interface_transmit_stream(__attribute__((unused)) struct euicc_ctx *ctx, const char *url,
+                                          uint32_t *rcode,
+                                          int (*rx_callback)(const uint8_t *data, uint32_t data_len, void *userdata),
+                                          void *rx_userdata, __attribute__((unused)) const uint8_t *tx, uint32_t tx_len,
+                                          __attribute__((unused)) const char **headers) {
+    const struct http_trace_record *record;
+    uint64_t delay_us;
+
+    *rcode = 0;
+
+    record = replay_next(url);
+    if (record == NULL) {
+        return -1;
+    }
+
+    delay_us = replay_delay_us(record);
+    replay_sleep_us(delay_us);
+
+    for (uint32_t offset = 0; offset < record->rx_len; offset += REPLAY_STREAM_CHUNK) {
+        uint32_t chunk = record->rx_len - offset;
+        if (chunk > REPLAY_STREAM_CHUNK) {
+            chunk = REPLAY_STREAM_CHUNK;
+        }
+        if (rx_callback(record->rx + offset, chunk, rx_userdata) < 0) {
+            return -1;
+        }
+    }
+    *rcode = record->rcode;
+
+    replay_transfer_info(record, tx_len, delay_us, &replay.last);
+
+    return 0;
+}
+
+static int http_interface_transfer_info(__attribute__((unused)) struct euicc_ctx *ctx,
+                                        struct euicc_http_transfer_info *info) {
+    *info = replay.last;
+    return 0;
+}
+
+// The response is picked at submit time, so order matching follows the order of submission
+static int http_interface_async_submit(struct euicc_ctx *ctx, const char *url,
+                                       __attribute__((unused)) const uint8_t *tx, uint32_t tx_len,
+                                       __attribute__((unused)) const char **headers,
+                                       void (*callback)(struct euicc_ctx *ctx, struct euicc_http_response *response,
+                                                        void *userdata),
+                                       void *userdata) {
+    struct replay_pending *pending, **p;
+
+    pending = calloc(1, sizeof(*pending));
+    if (pending == NULL) {
+        return -1;
+    }
+
+    pending->record = replay_next(url);
+    if (pending->record == NULL) {
+        free(pending);
+        return -1;
+    }
+    pending->ctx = ctx;
+    pending->tx_len = tx_len;
+    pending->delay_us = replay_delay_us(pending->record);
+    pending->due_us = replay_now_us() + pending->delay_us;
+    pending->callback = callback;
+    pending->userdata = userdata;
+
+    for (p = &replay.pending; *p != NULL && (*p)->due_us <= pending->due_us; p = &(*p)->next) {
+    }
+    pending->next = *p;
+    *p = pending;
+
+    return 0;
+}
+
+static int http_interface_async_dispatch(__attribute__((unused)) struct euicc_ctx *ctx) {
+    const uint64_t now = replay_now_us();
+    int active = 0;
+
+    while (replay.pending != NULL && replay.pending->due_us <= now) {
+        struct replay_pending *pending = replay.pending;
+        struct euicc_http_response response = {0};
+
+        replay.pending = pending->next;
+
+        response.rcode = pending->record->rcode;
+        response.rx = malloc(pending->record->rx_len + 1);
+        if (response.rx == NULL) {
+            response.result = -1;
+        } else {
+            memcpy(response.rx, pending->record->rx, pending->record->rx_len);
+            response.rx_len = pending->record->rx_len;
+        }
+        replay_transfer_info(pending->record, pending->tx_len, pending->delay_us, &response.info);
+        replay.last = response.info;
+
+        if (pending->callback) {
+            pending->callback(pending->ctx, &response, pending->userdata);
+        } else {
+            free(response.rx);
+        }
+        free(pending);
+    }
+
+    for (struct replay_pending *pending = replay.pending; pending != NULL; pending = pending->next) {
+        active++;
+    }
+
+    return active;
+}
+
+// There are no sockets, the loop only has to come back when the next response is due
+static int http_interface_async_fds(__attribute__((unused)) struct euicc_ctx *ctx,
+                                    __attribute__((unused)) struct euicc_http_pollfd *fds, uint32_t *fds_count,
+                                    long *timeout_ms) {
+    uint64_t now;
+
+    *fds_count = 0;
+
+    if (replay.pending == NULL) {
+        *timeout_ms = -1;
+        return 0;
+    }
+
+    now = replay_now_us();
+    *timeout_ms = replay.pending->due_us > now ? (long)((replay.pending->due_us - now + 999) / 1000) : 0;
+
+    return 0;
+}
+
+static int http_interface_async_wait(struct euicc_ctx *ctx, int timeout_ms) {
+    uint64_t now, sleep_us;
+
+    if (replay.pending == NULL) {
+        return 0;
+    }
+
+    now = replay_now_us();
+    sleep_us = replay.pending->due_us > now ? replay.pending->due_us - now : 0;
+    if (timeout_ms >= 0 && sleep_us > (uint64_t)timeout_ms * 1000) {
+        sleep_us = (uint64_t)timeout_ms * 1000;
+    }
+    replay_sleep_us(sleep_us);
+
+    return http_interface_async_dispatch(ctx);
+}
+
+static int libhttpinterface_init(struct euicc_http_interface *ifstruct) {
+    const char *path;
+    const char *match;
+    const char *latency;
+
+    memset(ifstruct, 0, sizeof(struct euicc_http_interface));
+
+    path = getenv(ENV_REPLAY_FILE);
+    if (path == NULL) {
+        fprintf(stderr, "replay: %s is not set\n", ENV_REPLAY_FILE);
+        return -1;
+    }
+    if (http_trace_load(path, &replay.records, &replay.count) < 0) {
+        fprintf(stderr, "replay: failed to load %s\n", path);
+        return -1;
+    }
+    replay.used = calloc(replay.count + 1, sizeof(bool));
+    if (replay.used == NULL) {
+        return -1;
+    }
+
+    match = getenv_or_default(ENV_REPLAY_MATCH, (char *)"order");
+    if (strcasecmp(match, "url") == 0) {
+        replay.match_url = true;
+    } else if (strcasecmp(match, "order") != 0) {
+        fprintf(stderr, "replay: unknown %s value: %s\n", ENV_REPLAY_MATCH, match);
+        return -1;
+    }
+
+    latency = getenv_or_default(ENV_REPLAY_LATENCY, (char *)"0");
+    if (strcasecmp(latency, "recorded") == 0) {
+        replay.latency_recorded = true;
+    } else {
+        replay.latency_us = (uint64_t)strtoul(latency, NULL, 10) * 1000;
+    }
+
+    ifstruct->transmit = http_interface_transmit;
+    ifstruct->transmit_stream = http_interface_transmit_stream;
+    ifstruct->transfer_info = http_interface_transfer_info;
+    ifstruct->async_submit = http_interface_async_submit;
+    ifstruct->async_fds = http_interface_async_fds;
+    ifstruct->async_dispatch = http_interface_async_dispatch;
+    ifstruct->async_wait = http_interface_async_wait;
+
+    return 0;
+}
+
+static void libhttpinterface_fini(__attribute__((unused)) struct euicc_http_interface *ifstruct) {
+    while (replay.pending) {
+        struct replay_pending *pending = replay.pending;
+        replay.pending = pending->next;
+        free(pending);
+    }
+    http_trace_free(replay.records, replay.count);
+    replay.records = NULL;
+    replay.count = 0;
+    free(replay.used);
+    replay.used = NULL;
+    replay.next = 0;
+}
+
+const struct euicc_driver driver_http_replay = {
+    .type = DRIVER_HTTP,
+    .name = "replay",
+    .init = (int (*)(void *))libhttpinterface_init,
+    .main = NULL,
+    .fini = (void (*)(void *))libhttpinterface_fini,
+};
@@ -51,8 +51,6 @@ err:
 
 static bool json_request(const char *url, const uint8_t *tx, uint32_t tx_len, const char **headers) {
     _cleanup_free_ char *tx_hex = NULL;
-    _cleanup_cjson_ cJSON *jpayload = NULL;
-    cJSON *jheaders = NULL;
 
     tx_hex = malloc((2 * tx_len) + 1);
     if (tx_hex == NULL) {
@@ -62,31 +60,21 @@ static bool json_request(const char *url, const uint8_t *tx, uint32_t tx_len, co
         return false;
     }
 
-    jpayload = cJSON_CreateObject();
-    if (jpayload == NULL) {
-        return false;
-    }
-    if (cJSON_AddStringOrNullToObject(jpayload, "url", url) == NULL) {
-        return false;
-    }
-    if (cJSON_AddStringOrNullToObject(jpayload, "tx", tx_hex) == NULL) {
-        return false;
-    }
-
-    jheaders = cJSON_AddArrayToObject(jpayload, "headers");
-    if (jheaders == NULL) {
-        return false;
-    }
-
+    json_print_stream_begin("http");
+    json_writer_object_begin();
+    json_writer_key("url");
+    json_writer_string(url);
+    json_writer_key("tx");
+    json_writer_string(tx_hex);
+    json_writer_key("headers");
+    json_writer_array_begin();
     for (int i = 0; headers[i] != NULL; i++) {
-        cJSON *jh = cJSON_CreateString(headers[i]);
-        if (jh == NULL) {
-            return false;
-        }
-        cJSON_AddItemToArray(jheaders, jh);
+        json_writer_string(headers[i]);
     }
+    json_writer_array_end();
+    json_writer_object_end();
 
-    return json_print("http", jpayload);
+    return json_print_stream_end();
 }
 
 // {"type":"http","payload":{"rcode":404,"rx":"333435"}}
@@ -0,0 +1,275 @@
+#include "trace.h"
+
+#include <cjson/cJSON.h>
+#include <euicc/hexutil.h>
+#include <lpac/utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static char *http_trace_hex(const uint8_t *bin, uint32_t len) {
+    char *hex;
+
+    if (bin == NULL || len == 0) {
+        return strdup("");
+    }
+
+    hex = malloc((2 * len) + 1);
+    if (hex == NULL) {
+        return NULL;
+    }
+    if (euicc_hexutil_bin2hex(hex, (2 * len) + 1, bin, len) < 0) {
+        free(hex);
+        return NULL;
+    }
+
+    return hex;
+}
+
+static int http_trace_unhex(const cJSON *jhex, uint8_t **bin, uint32_t *len) {
+    uint32_t hex_len;
+
+    if (!cJSON_IsString(jhex)) {
+        return -1;
+    }
+    hex_len = strlen(jhex->valuestring);
+
+    *len = hex_len / 2;
+    *bin = malloc(*len + 1);
+    if (*bin == NULL) {
+        return -1;
+    }
+    if (euicc_hexutil_hex2bin_r(*bin, *len, jhex->valuestring, hex_len) < 0) {
+        free(*bin);
+        *bin = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int http_trace_write(FILE *fp, const uint32_t index, const char *url, const char **headers, const uint8_t *tx,
+                     const uint32_t tx_len, const uint32_t rcode, const uint8_t *rx, const uint32_t rx_len,
+                     const uint64_t elapsed_us) {
+    int fret;
+    _cleanup_cjson_ cJSON *jroot = NULL;
+    _cleanup_free_ char *tx_hex = NULL;
+    _cleanup_free_ char *rx_hex = NULL;
+    _cleanup_free_ char *line = NULL;
+    cJSON *jheaders;
+
+    tx_hex = http_trace_hex(tx, tx_len);
+    rx_hex = http_trace_hex(rx, rx_len);
+    jroot = cJSON_CreateObject();
+    if (tx_hex == NULL || rx_hex == NULL || jroot == NULL) {
+        goto err;
+    }
+
+    cJSON_AddNumberToObject(jroot, "index", index);
+    cJSON_AddStringToObject(jroot, "url", url);
+    jheaders = cJSON_AddArrayToObject(jroot, "headers");
+    if (jheaders == NULL) {
+        goto err;
+    }
+    for (int i = 0; headers != NULL && headers[i] != NULL; i++) {
+        cJSON_AddItemToArray(jheaders, cJSON_CreateString(headers[i]));
+    }
+    cJSON_AddStringToObject(jroot, "tx", tx_hex);
+    cJSON_AddNumberToObject(jroot, "rcode", rcode);
+    cJSON_AddStringToObject(jroot, "rx", rx_hex);
+    cJSON_AddNumberToObject(jroot, "elapsed_us", (double)elapsed_us);
+
+    line = cJSON_PrintUnformatted(jroot);
+    if (line == NULL) {
+        goto err;
+    }
+    if (fputs(line, fp) < 0 || fputc('\n', fp) == EOF || fflush(fp) != 0) {
+        goto err;
+    }
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    return fret;
+}
+
+uint32_t http_trace_count(FILE *fp) {
+    uint32_t count = 0;
+    int c, last = '\n';
+
+    rewind(fp);
+    while ((c = fgetc(fp)) != EOF) {
+        if (c == '\n' && last != '\n') {
+            count++;
+        }
+        last = c;
+    }
+    if (last != '\n') {
+        count++;
+    }
+
+    return count;
+}
+
+static void http_trace_record_clear(struct http_trace_record *record) {
+    free(record->url);
+    for (int i = 0; record->headers != NULL && record->headers[i] != NULL; i++) {
+        free(record->headers[i]);
+    }
+    free(record->headers);
+    free(record->tx);
+    free(record->rx);
+    memset(record, 0, sizeof(*record));
+}
+
+static int http_trace_parse(const char *line, struct http_trace_record *record) {
+    int fret;
+    _cleanup_cjson_ cJSON *jroot = NULL;
+    cJSON *jtmp;
+    int headers_count;
+
+    memset(record, 0, sizeof(*record));
+
+    jroot = cJSON_Parse(line);
+    if (jroot == NULL) {
+        return -1;
+    }
+
+    jtmp = cJSON_GetObjectItem(jroot, "index");
+    if (cJSON_IsNumber(jtmp)) {
+        record->index = jtmp->valueint;
+    }
+
+    jtmp = cJSON_GetObjectItem(jroot, "url");
+    if (!cJSON_IsString(jtmp)) {
+        goto err;
+    }
+    record->url = strdup(jtmp->valuestring);
+    if (record->url == NULL) {
+        goto err;
+    }
+
+    jtmp = cJSON_GetObjectItem(jroot, "headers");
+    headers_count = cJSON_IsArray(jtmp) ? cJSON_GetArraySize(jtmp) : 0;
+    record->headers = calloc(headers_count + 1, sizeof(char *));
+    if (record->headers == NULL) {
+        goto err;
+    }
+    for (int i = 0; i < headers_count; i++) {
+        cJSON *jheader = cJSON_GetArrayItem(jtmp, i);
+        if (!cJSON_IsString(jheader)) {
+            goto err;
+        }
+        record->headers[i] = strdup(jheader->valuestring);
+        if (record->headers[i] == NULL) {
+            goto err;
+        }
+    }
+
+    if (http_trace_unhex(cJSON_GetObjectItem(jroot, "tx"), &record->tx, &record->tx_len) < 0) {
+        goto err;
+    }
+
+    jtmp = cJSON_GetObjectItem(jroot, "rcode");
+    if (!cJSON_IsNumber(jtmp)) {
+        goto err;
+    }
+    record->rcode = jtmp->valueint;
+
+    if (http_trace_unhex(cJSON_GetObjectItem(jroot, "rx"), &record->rx, &record->rx_len) < 0) {
+        goto err;
+    }
+
+    jtmp = cJSON_GetObjectItem(jroot, "elapsed_us");
+    if (cJSON_IsNumber(jtmp) && jtmp->valuedouble > 0) {
+        record->elapsed_us = (uint64_t)jtmp->valuedouble;
+    }
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+    http_trace_record_clear(record);
+exit:
+    return fret;
+}
+
+int http_trace_load(const char *path, struct http_trace_record **records, uint32_t *count) {
+    int fret;
+    FILE *fp;
+    _cleanup_free_ char *buf = NULL;
+    long size;
+    char *line, *next;
+    uint32_t capacity = 0;
+    struct http_trace_record *records_new;
+
+    *records = NULL;
+    *count = 0;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        goto err;
+    }
+    buf = malloc(size + 1);
+    if (buf == NULL) {
+        goto err;
+    }
+    if (fread(buf, 1, size, fp) != (size_t)size) {
+        goto err;
+    }
+    buf[size] = '\0';
+
+    for (line = buf; line != NULL && *line != '\0'; line = next) {
+        next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        if (line[strspn(line, " \t\r")] == '\0') {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            records_new = realloc(*records, capacity * sizeof(**records));
+            if (records_new == NULL) {
+                goto err;
+            }
+            *records = records_new;
+        }
+        if (http_trace_parse(line, &(*records)[*count]) < 0) {
+            fprintf(stderr, "%s: malformed record on position %u\n", path, *count);
+            goto err;
+        }
+        (*count)++;
+    }
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+    http_trace_free(*records, *count);
+    *records = NULL;
+    *count = 0;
+exit:
+    fclose(fp);
+    return fret;
+}
+
+void http_trace_free(struct http_trace_record *records, const uint32_t count) {
+    if (records == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        http_trace_record_clear(&records[i]);
+    }
+    free(records);
+}
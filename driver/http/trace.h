@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// One ES9+ exchange of an HTTP trace. A trace file holds one JSON object per line:
+// {"index":0,"url":"...","headers":["..."],"tx":"<hex>","rcode":200,"rx":"<hex>","elapsed_us":1234}
+struct http_trace_record {
+    uint32_t index;
+    char *url;
+    char **headers; // NULL terminated
+    uint8_t *tx;
+    uint32_t tx_len;
+    uint32_t rcode;
+    uint8_t *rx;
+    uint32_t rx_len;
+    uint64_t elapsed_us;
+};
+
+// Appends a record and flushes it, so a trace survives a crashing run
+int http_trace_write(FILE *fp, uint32_t index, const char *url, const char **headers, const uint8_t *tx,
+                     uint32_t tx_len, uint32_t rcode, const uint8_t *rx, uint32_t rx_len, uint64_t elapsed_us);
+
+// Number of records already in a trace, so recording can continue the numbering of an existing file
+uint32_t http_trace_count(FILE *fp);
+
+int http_trace_load(const char *path, struct http_trace_record **records, uint32_t *count);
+
+void http_trace_free(struct http_trace_record *records, uint32_t count);
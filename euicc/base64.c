@@ -97,3 +97,63 @@ int euicc_base64_encode(char *encoded, const unsigned char *string, int len) {
     *p++ = '\0';
     return p - encoded;
 }
+
+void euicc_base64_decoder_init(struct euicc_base64_decoder *decoder) { memset(decoder, 0, sizeof(*decoder)); }
+
+// bufplain must hold at least ((len + 3) / 4) * 3 bytes; whitespace is skipped
+int euicc_base64_decoder_update(struct euicc_base64_decoder *decoder, unsigned char *bufplain, const char *bufcoded,
+                                int len) {
+    unsigned char *bufout = bufplain;
+
+    for (int i = 0; i < len; i++) {
+        const unsigned char c = (unsigned char)bufcoded[i];
+        const unsigned char v = pr2six[c];
+
+        if (v > 63) {
+            if (c == '=') {
+                decoder->padded = 1;
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                continue;
+            }
+            return -1;
+        }
+
+        if (decoder->padded) {
+            return -1;
+        }
+
+        decoder->quantum[decoder->count++] = v;
+        if (decoder->count == 4) {
+            *(bufout++) = (unsigned char)(decoder->quantum[0] << 2 | decoder->quantum[1] >> 4);
+            *(bufout++) = (unsigned char)(decoder->quantum[1] << 4 | decoder->quantum[2] >> 2);
+            *(bufout++) = (unsigned char)(decoder->quantum[2] << 6 | decoder->quantum[3]);
+            decoder->count = 0;
+        }
+    }
+
+    return bufout - bufplain;
+}
+
+// bufplain must hold at least 2 bytes
+int euicc_base64_decoder_final(struct euicc_base64_decoder *decoder, unsigned char *bufplain) {
+    unsigned char *bufout = bufplain;
+
+    switch (decoder->count) {
+    case 0:
+        break;
+    case 1:
+        return -1;
+    case 3:
+        *(bufout++) = (unsigned char)(decoder->quantum[0] << 2 | decoder->quantum[1] >> 4);
+        *(bufout++) = (unsigned char)(decoder->quantum[1] << 4 | decoder->quantum[2] >> 2);
+        break;
+    case 2:
+        *(bufout++) = (unsigned char)(decoder->quantum[0] << 2 | decoder->quantum[1] >> 4);
+        break;
+    }
+
+    decoder->count = 0;
+    return bufout - bufplain;
+}
@@ -1,6 +1,17 @@
 #pragma once
 
+struct euicc_base64_decoder {
+    unsigned char quantum[4];
+    int count;
+    int padded;
+};
+
 int euicc_base64_decode_len(const char *bufcoded);
 int euicc_base64_decode(unsigned char *bufplain, const char *bufcoded);
 int euicc_base64_encode_len(int len);
 int euicc_base64_encode(char *encoded, const unsigned char *string, int len);
+
+void euicc_base64_decoder_init(struct euicc_base64_decoder *decoder);
+int euicc_base64_decoder_update(struct euicc_base64_decoder *decoder, unsigned char *bufplain, const char *bufcoded,
+                                int len);
+int euicc_base64_decoder_final(struct euicc_base64_decoder *decoder, unsigned char *bufplain);
@@ -0,0 +1,147 @@
+#include "download.h"
+
+#include "es10b.h"
+#include "es8p.h"
+#include "es9p.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stage_names[] = {
+    [EUICC_DOWNLOAD_STAGE_GET_EUICC_CHALLENGE_AND_INFO] = "es10b_get_euicc_challenge_and_info",
+    [EUICC_DOWNLOAD_STAGE_INITIATE_AUTHENTICATION] = "es9p_initiate_authentication",
+    [EUICC_DOWNLOAD_STAGE_AUTHENTICATE_SERVER] = "es10b_authenticate_server",
+    [EUICC_DOWNLOAD_STAGE_AUTHENTICATE_CLIENT] = "es9p_authenticate_client",
+    // misspelt, but lpac has always reported it under this name
+    [EUICC_DOWNLOAD_STAGE_METADATA_PARSE] = "es8p_meatadata_parse",
+    [EUICC_DOWNLOAD_STAGE_PREPARE_DOWNLOAD] = "es10b_prepare_download",
+    [EUICC_DOWNLOAD_STAGE_GET_BOUND_PROFILE_PACKAGE] = "es9p_get_bound_profile_package",
+    [EUICC_DOWNLOAD_STAGE_LOAD_BOUND_PROFILE_PACKAGE] = "es10b_load_bound_profile_package",
+    [EUICC_DOWNLOAD_STAGE_ES10B_CANCEL_SESSION] = "es10b_cancel_session",
+    [EUICC_DOWNLOAD_STAGE_ES9P_CANCEL_SESSION] = "es9p_cancel_session",
+};
+
+const char *euicc_download_stage2str(enum euicc_download_stage stage) {
+    if ((unsigned)stage >= sizeof(stage_names) / sizeof(stage_names[0])) {
+        return "unknown";
+    }
+    return stage_names[stage];
+}
+
+static int download_stage(struct euicc_ctx *ctx, const struct euicc_download_param *param,
+                          struct euicc_download_result *result, enum euicc_download_stage stage) {
+    result->stage = stage;
+
+    if (param->progress && param->progress(ctx, stage, param->userdata)) {
+        result->cancelled = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int download_metadata(struct euicc_ctx *ctx, const struct euicc_download_param *param,
+                             struct euicc_download_result *result, const char *b64_profileMetadata) {
+    struct es8p_metadata *metadata = NULL;
+    int ret;
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_METADATA_PARSE) < 0) {
+        return -1;
+    }
+
+    if (es8p_metadata_parse(&metadata, b64_profileMetadata)) {
+        return -1;
+    }
+
+    ret = param->metadata(ctx, metadata, param->userdata);
+    es8p_metadata_free(&metadata);
+
+    if (param->preview && ret) {
+        result->cancelled = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void download_cancel(struct euicc_ctx *ctx, const struct euicc_download_param *param) {
+    char status[sizeof(ctx->http.status)];
+
+    // keep the reason of the failed stage, not the one of CancelSession
+    memcpy(status, &ctx->http.status, sizeof(status));
+
+    if (param->progress) {
+        param->progress(ctx, EUICC_DOWNLOAD_STAGE_ES10B_CANCEL_SESSION, param->userdata);
+    }
+    es10b_cancel_session(ctx, ES10B_CANCEL_SESSION_REASON_ENDUSERREJECTION);
+
+    if (param->progress) {
+        param->progress(ctx, EUICC_DOWNLOAD_STAGE_ES9P_CANCEL_SESSION, param->userdata);
+    }
+    es9p_cancel_session(ctx);
+
+    memcpy(&ctx->http.status, status, sizeof(status));
+}
+
+int euicc_download(struct euicc_ctx *ctx, const struct euicc_download_param *param,
+                   struct euicc_download_result *result) {
+    int fret = 0;
+    const char *b64_profileMetadata;
+
+    memset(result, 0, sizeof(*result));
+
+    ctx->http.server_address = param->smdp;
+
+    // connect to the SM-DP+ while the eUICC works on the challenge
+    es9p_prewarm(ctx);
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_GET_EUICC_CHALLENGE_AND_INFO) < 0
+        || es10b_get_euicc_challenge_and_info(ctx)) {
+        goto err;
+    }
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_INITIATE_AUTHENTICATION) < 0
+        || es9p_initiate_authentication(ctx)) {
+        goto err;
+    }
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_AUTHENTICATE_SERVER) < 0
+        || es10b_authenticate_server(ctx, param->matchingId, param->imei)) {
+        goto err;
+    }
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_AUTHENTICATE_CLIENT) < 0
+        || es9p_authenticate_client(ctx)) {
+        goto err;
+    }
+
+    b64_profileMetadata = ctx->http._internal.prepare_download_param->b64_profileMetadata;
+    if (b64_profileMetadata && param->metadata && download_metadata(ctx, param, result, b64_profileMetadata) < 0) {
+        goto err;
+    }
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_PREPARE_DOWNLOAD) < 0
+        || es10b_prepare_download(ctx, param->confirmationCode)) {
+        goto err;
+    }
+
+    // the package is spooled and loaded segment by segment when ctx->http.bpp_memory_limit is set
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_GET_BOUND_PROFILE_PACKAGE) < 0
+        || es9p_get_bound_profile_package(ctx)) {
+        goto err;
+    }
+
+    if (download_stage(ctx, param, result, EUICC_DOWNLOAD_STAGE_LOAD_BOUND_PROFILE_PACKAGE) < 0
+        || es10b_load_bound_profile_package(ctx, &result->bpp)) {
+        goto err;
+    }
+
+    goto exit;
+
+err:
+    fret = -1;
+    download_cancel(ctx, param);
+exit:
+    euicc_http_cleanup(ctx);
+    return fret;
+}
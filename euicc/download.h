@@ -0,0 +1,48 @@
+#pragma once
+
+#include "es10b.h"
+#include "es8p.h"
+#include "euicc.h"
+
+// The steps of a profile download, in the order they run. The cancel steps only run after a failure.
+enum euicc_download_stage {
+    EUICC_DOWNLOAD_STAGE_GET_EUICC_CHALLENGE_AND_INFO,
+    EUICC_DOWNLOAD_STAGE_INITIATE_AUTHENTICATION,
+    EUICC_DOWNLOAD_STAGE_AUTHENTICATE_SERVER,
+    EUICC_DOWNLOAD_STAGE_AUTHENTICATE_CLIENT,
+    EUICC_DOWNLOAD_STAGE_METADATA_PARSE,
+    EUICC_DOWNLOAD_STAGE_PREPARE_DOWNLOAD,
+    EUICC_DOWNLOAD_STAGE_GET_BOUND_PROFILE_PACKAGE,
+    EUICC_DOWNLOAD_STAGE_LOAD_BOUND_PROFILE_PACKAGE,
+    EUICC_DOWNLOAD_STAGE_ES10B_CANCEL_SESSION,
+    EUICC_DOWNLOAD_STAGE_ES9P_CANCEL_SESSION,
+};
+
+struct euicc_download_param {
+    const char *smdp;
+    const char *matchingId;
+    const char *imei;
+    const char *confirmationCode;
+    // Called before each stage, a non-zero return cancels the download (ignored for the cancel stages)
+    int (*progress)(struct euicc_ctx *ctx, enum euicc_download_stage stage, void *userdata);
+    // Called with the profile metadata announced by the SM-DP+, before PrepareDownload. With preview
+    // set a non-zero return rejects the profile, otherwise the return value is ignored.
+    int (*metadata)(struct euicc_ctx *ctx, const struct es8p_metadata *metadata, void *userdata);
+    int preview;
+    void *userdata;
+};
+
+struct euicc_download_result {
+    enum euicc_download_stage stage; // the failed stage
+    int cancelled;
+    struct es10b_load_bound_profile_package_result bpp;
+};
+
+// Runs the whole ES10b/ES9+ download state machine against param->smdp. On failure the session is
+// cancelled on both sides and result->stage names the stage that failed; ctx->http.status holds the
+// SM-DP+ reason for the ES9+ stages and result->bpp the eUICC's for LoadBoundProfilePackage.
+int euicc_download(struct euicc_ctx *ctx, const struct euicc_download_param *param,
+                   struct euicc_download_result *result);
+
+// The ES function name of a stage, as used in progress messages
+const char *euicc_download_stage2str(enum euicc_download_stage stage);
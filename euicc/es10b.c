@@ -399,6 +399,221 @@ exit:
     return fret;
 }
 
+struct es10b_bpp_spool_node {
+    uint16_t tag;
+    long offset;
+    uint32_t header_length;
+    uint32_t length;
+};
+
+static int es10b_bpp_spool_read_header(FILE *bpp, long offset, long limit, struct es10b_bpp_spool_node *node) {
+    uint8_t header[2 + 1 + 4];
+    uint32_t header_len = 0;
+    uint32_t length_octets;
+
+    if (offset >= limit) {
+        return -1;
+    }
+    if (fseek(bpp, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    header_len = fread(header, 1, (size_t)(limit - offset) < sizeof(header) ? (size_t)(limit - offset) : sizeof(header),
+                       bpp);
+    if (header_len < 2) {
+        return -1;
+    }
+
+    node->offset = offset;
+    node->tag = header[0];
+    node->header_length = 1;
+    if ((header[0] & 0x1F) == 0x1F) {
+        node->tag = (node->tag << 8) | header[1];
+        node->header_length++;
+    }
+
+    if (node->header_length >= header_len) {
+        return -1;
+    }
+
+    if (header[node->header_length] & 0x80) {
+        length_octets = header[node->header_length] & 0x7F;
+        if (length_octets == 0 || length_octets > 4 || node->header_length + 1 + length_octets > header_len) {
+            return -1;
+        }
+        node->length = 0;
+        for (uint32_t i = 0; i < length_octets; i++) {
+            node->length = (node->length << 8) | header[node->header_length + 1 + i];
+        }
+        node->header_length += 1 + length_octets;
+    } else {
+        node->length = header[node->header_length];
+        node->header_length++;
+    }
+
+    if ((unsigned long)node->offset + node->header_length + node->length > (unsigned long)limit) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int es10b_bpp_spool_find_tag(FILE *bpp, const struct es10b_bpp_spool_node *parent, uint16_t tag,
+                                    struct es10b_bpp_spool_node *result) {
+    long offset = parent->offset + parent->header_length;
+    const long limit = offset + parent->length;
+
+    while (offset < limit) {
+        if (es10b_bpp_spool_read_header(bpp, offset, limit, result) < 0) {
+            return -1;
+        }
+        if (result->tag == tag) {
+            return 0;
+        }
+        offset += result->header_length + result->length;
+    }
+
+    return -1;
+}
+
+struct es10b_bpp_spool_buffer {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t limit;
+    uint32_t peak;
+};
+
+static int es10b_bpp_spool_tx(struct euicc_ctx *ctx, struct es10b_load_bound_profile_package_result *result, FILE *bpp,
+                              struct es10b_bpp_spool_buffer *buffer, long offset, uint32_t length) {
+    if (length > buffer->size) {
+        uint8_t *new_data;
+
+        if (length > buffer->limit) {
+            return -1;
+        }
+        new_data = realloc(buffer->data, length);
+        if (new_data == NULL) {
+            return -1;
+        }
+        buffer->data = new_data;
+        buffer->size = length;
+        if (buffer->size > buffer->peak) {
+            buffer->peak = buffer->size;
+        }
+    }
+
+    if (fseek(bpp, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    if (fread(buffer->data, 1, length, bpp) != length) {
+        return -1;
+    }
+
+    return es10b_load_bound_profile_package_tx(ctx, result, buffer->data, length);
+}
+
+static int es10b_bpp_spool_tx_children(struct euicc_ctx *ctx, struct es10b_load_bound_profile_package_result *result,
+                                       FILE *bpp, struct es10b_bpp_spool_buffer *buffer,
+                                       const struct es10b_bpp_spool_node *parent) {
+    struct es10b_bpp_spool_node child;
+    long offset = parent->offset + parent->header_length;
+    const long limit = offset + parent->length;
+
+    while (offset < limit) {
+        if (es10b_bpp_spool_read_header(bpp, offset, limit, &child) < 0) {
+            return -1;
+        }
+        if (es10b_bpp_spool_tx(ctx, result, bpp, buffer, child.offset, child.header_length + child.length) < 0) {
+            return -1;
+        }
+        offset += child.header_length + child.length;
+    }
+
+    return 0;
+}
+
+// Same segmentation as es10b_load_bound_profile_package_r, but the decoded BPP stays on disk
+// and only one segment at a time (at most memory_limit bytes) is read into memory.
+int es10b_load_bound_profile_package_stream_r(struct euicc_ctx *ctx,
+                                              struct es10b_load_bound_profile_package_result *result, FILE *bpp,
+                                              uint32_t memory_limit, uint32_t *memory_peak) {
+    int fret = 0;
+    long bpp_len;
+    struct es10b_bpp_spool_buffer buffer = {.limit = memory_limit};
+    struct es10b_bpp_spool_node n_BoundProfilePackage, tmpnode, n_initialiseSecureChannel;
+
+    if (fseek(bpp, 0, SEEK_END) != 0 || (bpp_len = ftell(bpp)) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_read_header(bpp, 0, bpp_len, &n_BoundProfilePackage) < 0) {
+        goto err;
+    }
+    if (n_BoundProfilePackage.tag != 0xBF36) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_find_tag(bpp, &n_BoundProfilePackage, 0xBF23, &n_initialiseSecureChannel) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx(ctx, result, bpp, &buffer, n_BoundProfilePackage.offset,
+                           n_initialiseSecureChannel.offset - n_BoundProfilePackage.offset
+                               + n_initialiseSecureChannel.header_length + n_initialiseSecureChannel.length)
+        < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_find_tag(bpp, &n_BoundProfilePackage, 0xA0, &tmpnode) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx(ctx, result, bpp, &buffer, tmpnode.offset, tmpnode.header_length + tmpnode.length) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_find_tag(bpp, &n_BoundProfilePackage, 0xA1, &tmpnode) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx(ctx, result, bpp, &buffer, tmpnode.offset, tmpnode.header_length) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx_children(ctx, result, bpp, &buffer, &tmpnode) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_find_tag(bpp, &n_BoundProfilePackage, 0xA2, &tmpnode) == 0) {
+        if (es10b_bpp_spool_tx(ctx, result, bpp, &buffer, tmpnode.offset, tmpnode.header_length + tmpnode.length)
+            < 0) {
+            goto err;
+        }
+    }
+
+    if (es10b_bpp_spool_find_tag(bpp, &n_BoundProfilePackage, 0xA3, &tmpnode) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx(ctx, result, bpp, &buffer, tmpnode.offset, tmpnode.header_length) < 0) {
+        goto err;
+    }
+
+    if (es10b_bpp_spool_tx_children(ctx, result, bpp, &buffer, &tmpnode) < 0) {
+        goto err;
+    }
+
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    if (memory_peak && buffer.peak > *memory_peak) {
+        *memory_peak = buffer.peak;
+    }
+    free(buffer.data);
+    return fret;
+}
+
 int es10b_get_euicc_challenge_r(struct euicc_ctx *ctx, char **b64_euiccChallenge) {
     int fret = 0;
     struct euicc_derutil_node n_request = {
@@ -805,6 +1020,19 @@ int es10b_prepare_download(struct euicc_ctx *ctx, const char *confirmationCode)
 int es10b_load_bound_profile_package(struct euicc_ctx *ctx, struct es10b_load_bound_profile_package_result *result) {
     int fret;
 
+    if (ctx->http._internal.bpp_spool) {
+        fret = es10b_load_bound_profile_package_stream_r(ctx, result, ctx->http._internal.bpp_spool,
+                                                         ctx->http.bpp_memory_limit, &ctx->http.bpp_memory_peak);
+        if (fret < 0) {
+            return fret;
+        }
+
+        fclose(ctx->http._internal.bpp_spool);
+        ctx->http._internal.bpp_spool = NULL;
+
+        return fret;
+    }
+
     if (ctx->http._internal.b64_bound_profile_package == NULL) {
         return -1;
     }
@@ -836,8 +1064,15 @@ int es10b_get_euicc_challenge_and_info(struct euicc_ctx *ctx) {
         goto err;
     }
 
-    fret = es10b_get_euicc_info_r(ctx, &ctx->http._internal.b64_euicc_info_1);
-    if (fret < 0) {
+    if (ctx->http.b64_euicc_info_1_cache == NULL) {
+        fret = es10b_get_euicc_info_r(ctx, &ctx->http.b64_euicc_info_1_cache);
+        if (fret < 0) {
+            goto err;
+        }
+    }
+
+    ctx->http._internal.b64_euicc_info_1 = strdup(ctx->http.b64_euicc_info_1_cache);
+    if (ctx->http._internal.b64_euicc_info_1 == NULL) {
         goto err;
     }
 
@@ -1030,52 +1265,138 @@ exit:
     return fret;
 }
 
-int es10b_retrieve_notifications_list(struct euicc_ctx *ctx, struct es10b_pending_notification *PendingNotification,
-                                      unsigned long seqNumber) {
-    int fret = 0;
-    uint8_t seqNumber_buf[sizeof(seqNumber)];
-    uint32_t seqNumber_buf_len = sizeof(seqNumber_buf);
-    struct euicc_derutil_node n_request, n_searchCriteria, n_seqNumber;
-    uint32_t reqlen;
-    uint8_t *respbuf = NULL;
-    unsigned resplen;
-
-    struct euicc_derutil_node tmpnode, n_PendingNotification, n_NotificationMetadata;
+// Decodes one PendingNotification, a profileInstallationResult or an otherSignedNotification
+static int es10b_pending_notification_parse(const struct euicc_derutil_node *n_PendingNotification,
+                                            unsigned long *seqNumber,
+                                            struct es10b_pending_notification *PendingNotification) {
+    struct euicc_derutil_node tmpnode, n_NotificationMetadata;
 
     memset(PendingNotification, 0, sizeof(struct es10b_pending_notification));
 
-    if (euicc_derutil_convert_long2bin(seqNumber_buf, &seqNumber_buf_len, seqNumber) < 0) {
+    switch (n_PendingNotification->tag) {
+    case 0xBF37: // profileInstallationResult
+        if (euicc_derutil_unpack_find_tag(&tmpnode, 0xBF27, n_PendingNotification->value,
+                                          n_PendingNotification->length)
+            < 0) {
+            goto err;
+        }
+        if (euicc_derutil_unpack_find_tag(&n_NotificationMetadata, 0xBF2F, tmpnode.value, tmpnode.length) < 0) {
+            goto err;
+        }
+        break;
+    case 0x30: // otherSignedNotification
+        if (euicc_derutil_unpack_find_tag(&n_NotificationMetadata, 0xBF2F, n_PendingNotification->value,
+                                          n_PendingNotification->length)
+            < 0) {
+            goto err;
+        }
+        break;
+    default:
+        goto err;
+    }
+
+    if (seqNumber) {
+        if (euicc_derutil_unpack_find_tag(&tmpnode, 0x80, n_NotificationMetadata.value, n_NotificationMetadata.length)
+            < 0) {
+            goto err;
+        }
+        *seqNumber = euicc_derutil_convert_bin2long(tmpnode.value, tmpnode.length);
+    }
+
+    if (euicc_derutil_unpack_find_tag(&tmpnode, 0x0C, n_NotificationMetadata.value, n_NotificationMetadata.length)
+        < 0) {
+        goto err;
+    }
+
+    PendingNotification->notificationAddress = malloc(tmpnode.length + 1);
+    if (!PendingNotification->notificationAddress) {
+        goto err;
+    }
+    memcpy(PendingNotification->notificationAddress, tmpnode.value, tmpnode.length);
+    PendingNotification->notificationAddress[tmpnode.length] = '\0';
+
+    PendingNotification->b64_PendingNotification = malloc(euicc_base64_encode_len(n_PendingNotification->self.length));
+    if (!PendingNotification->b64_PendingNotification) {
+        goto err;
+    }
+    if (euicc_base64_encode(PendingNotification->b64_PendingNotification, n_PendingNotification->self.ptr,
+                            n_PendingNotification->self.length)
+        < 0) {
         goto err;
     }
 
+    return 0;
+
+err:
+    es10b_pending_notification_free(PendingNotification);
+    return -1;
+}
+
+// Sends a RetrieveNotificationsListRequest, without searchCriteria when seqNumber is NULL, and returns the response's notificationList
+static int es10b_retrieve_notifications_list_command(struct euicc_ctx *ctx, uint8_t **respbuf, unsigned *resplen,
+                                                     struct euicc_derutil_node *n_notificationList,
+                                                     const unsigned long *seqNumber) {
+    uint8_t seqNumber_buf[sizeof(*seqNumber)];
+    uint32_t seqNumber_buf_len = sizeof(seqNumber_buf);
+    struct euicc_derutil_node n_request, n_searchCriteria, n_seqNumber;
+    struct euicc_derutil_node tmpnode;
+    uint32_t reqlen;
+
+    *respbuf = NULL;
+
     memset(&n_request, 0, sizeof(n_request));
     memset(&n_searchCriteria, 0, sizeof(n_searchCriteria));
     memset(&n_seqNumber, 0, sizeof(n_seqNumber));
 
     n_request.tag = 0xBF2B; // RetrieveNotificationsListRequest
-    n_request.pack.child = &n_searchCriteria;
 
-    n_searchCriteria.tag = 0xA0; // searchCriteria
-    n_searchCriteria.pack.child = &n_seqNumber;
+    if (seqNumber != NULL) {
+        if (euicc_derutil_convert_long2bin(seqNumber_buf, &seqNumber_buf_len, *seqNumber) < 0) {
+            return -1;
+        }
+
+        n_request.pack.child = &n_searchCriteria;
 
-    n_seqNumber.tag = 0x80; // seqNumber
-    n_seqNumber.length = seqNumber_buf_len;
-    n_seqNumber.value = seqNumber_buf;
+        n_searchCriteria.tag = 0xA0; // searchCriteria
+        n_searchCriteria.pack.child = &n_seqNumber;
+
+        n_seqNumber.tag = 0x80; // seqNumber
+        n_seqNumber.length = seqNumber_buf_len;
+        n_seqNumber.value = seqNumber_buf;
+    }
 
     reqlen = sizeof(ctx->apdu._internal.request_buffer.body);
     if (euicc_derutil_pack(ctx->apdu._internal.request_buffer.body, &reqlen, &n_request)) {
-        goto err;
+        return -1;
     }
 
-    if (es10x_command(ctx, &respbuf, &resplen, ctx->apdu._internal.request_buffer.body, reqlen) < 0) {
-        goto err;
+    if (es10x_command(ctx, respbuf, resplen, ctx->apdu._internal.request_buffer.body, reqlen) < 0) {
+        return -1;
     }
 
-    if (euicc_derutil_unpack_find_tag(&tmpnode, n_request.tag, respbuf, resplen) < 0) {
-        goto err;
+    if (euicc_derutil_unpack_find_tag(&tmpnode, n_request.tag, *respbuf, *resplen) < 0) {
+        return -1;
     }
 
-    if (euicc_derutil_unpack_find_tag(&tmpnode, 0xA0, tmpnode.value, tmpnode.length) < 0) {
+    // notificationsListResultError otherwise
+    if (euicc_derutil_unpack_find_tag(n_notificationList, 0xA0, tmpnode.value, tmpnode.length) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int es10b_retrieve_notifications_list(struct euicc_ctx *ctx, struct es10b_pending_notification *PendingNotification,
+                                      unsigned long seqNumber) {
+    int fret = 0;
+    uint8_t *respbuf = NULL;
+    unsigned resplen;
+
+    struct euicc_derutil_node tmpnode, n_PendingNotification;
+
+    memset(PendingNotification, 0, sizeof(struct es10b_pending_notification));
+
+    if (es10b_retrieve_notifications_list_command(ctx, &respbuf, &resplen, &tmpnode, &seqNumber) < 0) {
         goto err;
     }
 
@@ -1085,45 +1406,61 @@ int es10b_retrieve_notifications_list(struct euicc_ctx *ctx, struct es10b_pendin
         goto err;
     }
 
-    switch (n_PendingNotification.tag) {
-    case 0xBF37: // profileInstallationResult
-        if (euicc_derutil_unpack_find_tag(&tmpnode, 0xBF27, n_PendingNotification.value, n_PendingNotification.length)
-            < 0) {
-            goto err;
-        }
-        if (euicc_derutil_unpack_find_tag(&n_NotificationMetadata, 0xBF2F, tmpnode.value, tmpnode.length) < 0) {
-            goto err;
-        }
-        break;
-    case 0x30: // otherSignedNotification
-        if (euicc_derutil_unpack_find_tag(&n_NotificationMetadata, 0xBF2F, n_PendingNotification.value,
-                                          n_PendingNotification.length)
-            < 0) {
-            goto err;
-        }
-        break;
-    }
-
-    if (euicc_derutil_unpack_find_tag(&tmpnode, 0x0C, n_NotificationMetadata.value, n_NotificationMetadata.length)
-        < 0) {
+    if (es10b_pending_notification_parse(&n_PendingNotification, NULL, PendingNotification) < 0) {
         goto err;
     }
 
-    PendingNotification->notificationAddress = malloc(tmpnode.length + 1);
-    if (!PendingNotification->notificationAddress) {
-        goto err;
-    }
-    memcpy(PendingNotification->notificationAddress, tmpnode.value, tmpnode.length);
-    PendingNotification->notificationAddress[tmpnode.length] = '\0';
+    fret = 0;
 
-    PendingNotification->b64_PendingNotification = malloc(euicc_base64_encode_len(n_PendingNotification.self.length));
-    if (!PendingNotification->b64_PendingNotification) {
+    goto exit;
+
+err:
+    fret = -1;
+    es10b_pending_notification_free(PendingNotification);
+exit:
+    free(respbuf);
+    respbuf = NULL;
+    return fret;
+}
+
+int es10b_retrieve_notifications_list_all(struct euicc_ctx *ctx,
+                                          int (*callback)(unsigned long seqNumber,
+                                                          struct es10b_pending_notification *PendingNotification,
+                                                          void *userdata),
+                                          void *userdata) {
+    int fret = 0;
+    uint8_t *respbuf = NULL;
+    unsigned resplen;
+
+    struct euicc_derutil_node n_notificationList, n_PendingNotification;
+
+    if (es10b_retrieve_notifications_list_command(ctx, &respbuf, &resplen, &n_notificationList, NULL) < 0) {
         goto err;
     }
-    if (euicc_base64_encode(PendingNotification->b64_PendingNotification, n_PendingNotification.self.ptr,
-                            n_PendingNotification.self.length)
-        < 0) {
-        goto err;
+
+    n_PendingNotification.self.ptr = n_notificationList.value;
+    n_PendingNotification.self.length = 0;
+
+    while (euicc_derutil_unpack_next(&n_PendingNotification, &n_PendingNotification, n_notificationList.value,
+                                     n_notificationList.length)
+           == 0) {
+        struct es10b_pending_notification PendingNotification;
+        unsigned long seqNumber;
+        int ret;
+
+        if (n_PendingNotification.tag != 0xBF37 && n_PendingNotification.tag != 0x30) {
+            continue;
+        }
+
+        if (es10b_pending_notification_parse(&n_PendingNotification, &seqNumber, &PendingNotification) < 0) {
+            goto err;
+        }
+
+        ret = callback(seqNumber, &PendingNotification, userdata);
+        es10b_pending_notification_free(&PendingNotification);
+        if (ret < 0) {
+            goto err;
+        }
     }
 
     fret = 0;
@@ -1132,7 +1469,6 @@ int es10b_retrieve_notifications_list(struct euicc_ctx *ctx, struct es10b_pendin
 
 err:
     fret = -1;
-    es10b_pending_notification_free(PendingNotification);
 exit:
     free(respbuf);
     respbuf = NULL;
@@ -1193,6 +1529,82 @@ exit:
     return fret;
 }
 
+// NotificationSentResponse is a few bytes, it is collected into a fixed buffer instead of the heap
+struct es10b_notification_sent_response {
+    uint8_t buf[16];
+    uint32_t len;
+};
+
+static int es10b_notification_sent_response_iter(struct apdu_response *response, void *userdata) {
+    struct es10b_notification_sent_response *resp = userdata;
+
+    if (response->length > sizeof(resp->buf) - resp->len) {
+        return -1;
+    }
+    memcpy(resp->buf + resp->len, response->data, response->length);
+    resp->len += response->length;
+
+    return 0;
+}
+
+int es10b_remove_notifications_from_list(struct euicc_ctx *ctx, const unsigned long *seqNumbers, int count,
+                                         int *results) {
+    int removed = 0;
+    uint8_t seqNumber_buf[sizeof(*seqNumbers)];
+    uint32_t seqNumber_buf_len;
+    struct euicc_derutil_node n_request, n_seqNumber;
+    uint32_t reqlen;
+
+    struct euicc_derutil_node tmpnode;
+
+    memset(&n_request, 0, sizeof(n_request));
+    memset(&n_seqNumber, 0, sizeof(n_seqNumber));
+
+    n_request.tag = 0xBF30; // NotificationSentRequest
+    n_request.pack.child = &n_seqNumber;
+
+    n_seqNumber.tag = 0x80; // seqNumber
+    n_seqNumber.value = seqNumber_buf;
+
+    // one STORE DATA after the other on the channel that is already open, a failure only affects its own entry
+    for (int i = 0; i < count; i++) {
+        struct es10b_notification_sent_response resp = {0};
+
+        results[i] = -1;
+
+        seqNumber_buf_len = sizeof(seqNumber_buf);
+        if (euicc_derutil_convert_long2bin(seqNumber_buf, &seqNumber_buf_len, seqNumbers[i]) < 0) {
+            continue;
+        }
+        n_seqNumber.length = seqNumber_buf_len;
+
+        reqlen = sizeof(ctx->apdu._internal.request_buffer.body);
+        if (euicc_derutil_pack(ctx->apdu._internal.request_buffer.body, &reqlen, &n_request)) {
+            continue;
+        }
+
+        if (es10x_command_iter(ctx, ctx->apdu._internal.request_buffer.body, reqlen,
+                               es10b_notification_sent_response_iter, &resp)
+            < 0) {
+            continue;
+        }
+
+        if (euicc_derutil_unpack_find_tag(&tmpnode, n_request.tag, resp.buf, resp.len) < 0) {
+            continue;
+        }
+        if (euicc_derutil_unpack_find_tag(&tmpnode, 0x80, tmpnode.value, tmpnode.length) < 0) {
+            continue;
+        }
+
+        results[i] = euicc_derutil_convert_bin2long(tmpnode.value, tmpnode.length);
+        if (results[i] == 0) {
+            removed++;
+        }
+    }
+
+    return removed;
+}
+
 void es10b_notification_metadata_list_free_all(struct es10b_notification_metadata_list *notificationMetadataList) {
     while (notificationMetadataList) {
         struct es10b_notification_metadata_list *next = notificationMetadataList->next;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "euicc.h"
 
@@ -127,6 +128,9 @@ int es10b_prepare_download_r(struct euicc_ctx *ctx, char **b64_PrepareDownloadRe
                              struct es10b_prepare_download_param_user *param_user);
 int es10b_load_bound_profile_package_r(struct euicc_ctx *ctx, struct es10b_load_bound_profile_package_result *result,
                                        const char *b64_BoundProfilePackage);
+int es10b_load_bound_profile_package_stream_r(struct euicc_ctx *ctx,
+                                              struct es10b_load_bound_profile_package_result *result, FILE *bpp,
+                                              uint32_t memory_limit, uint32_t *memory_peak);
 int es10b_get_euicc_challenge_r(struct euicc_ctx *ctx, char **b64_euiccChallenge);
 int es10b_get_euicc_info_r(struct euicc_ctx *ctx, char **b64_EUICCInfo1);
 int es10b_authenticate_server_r(struct euicc_ctx *ctx, uint8_t **transaction_id, uint32_t *transaction_id_len,
@@ -147,7 +151,18 @@ int es10b_cancel_session(struct euicc_ctx *ctx, enum es10b_cancel_session_reason
 int es10b_list_notification(struct euicc_ctx *ctx, struct es10b_notification_metadata_list **notificationMetadataList);
 int es10b_retrieve_notifications_list(struct euicc_ctx *ctx, struct es10b_pending_notification *PendingNotification,
                                       unsigned long seqNumber);
+// Retrieves every pending notification with a single command. The callback runs for each one in the
+// eUICC's order and may take over its strings by setting them to NULL; a negative return stops the walk.
+int es10b_retrieve_notifications_list_all(struct euicc_ctx *ctx,
+                                          int (*callback)(unsigned long seqNumber,
+                                                          struct es10b_pending_notification *PendingNotification,
+                                                          void *userdata),
+                                          void *userdata);
 int es10b_remove_notification_from_list(struct euicc_ctx *ctx, unsigned long seqNumber);
+// Removes several notifications with back-to-back commands. results[i] is the deleteNotificationStatus
+// of seqNumbers[i] (0 removed, 1 nothing to delete) or -1 when its exchange failed. Returns the number removed.
+int es10b_remove_notifications_from_list(struct euicc_ctx *ctx, const unsigned long *seqNumbers, int count,
+                                         int *results);
 
 void es10b_notification_metadata_list_free_all(struct es10b_notification_metadata_list *notificationMetadataList);
 void es10b_pending_notification_free(struct es10b_pending_notification *PendingNotification);
@@ -12,9 +12,23 @@
 #include <unistd.h>
 
 int es10c_get_profiles_info(struct euicc_ctx *ctx, struct es10c_profile_info_list **profileInfoList) {
+    return es10c_get_profiles_info_taglist(ctx, NULL, 0, profileInfoList);
+}
+
+int es10c_get_profiles_info_taglist(struct euicc_ctx *ctx, const uint8_t *tagList, uint32_t tagList_len,
+                                    struct es10c_profile_info_list **profileInfoList) {
     int fret = 0;
+    struct euicc_derutil_node n_tagList = {
+        .tag = 0x5C, // tagList
+        .value = tagList,
+        .length = tagList_len,
+    };
     struct euicc_derutil_node n_request = {
         .tag = 0xBF2D, // ProfileInfoListRequest
+        .pack =
+            {
+                .child = tagList_len ? &n_tagList : NULL,
+            },
     };
     uint32_t reqlen;
     uint8_t *respbuf = NULL;
@@ -52,6 +52,10 @@ struct es10c_profile_info_list {
 };
 
 int es10c_get_profiles_info(struct euicc_ctx *ctx, struct es10c_profile_info_list **profileInfoList);
+// Asks the eUICC for only the ProfileInfo fields whose tags are concatenated in tagList (e.g. 5A 9F70 for
+// iccid and profileState), the others are left unset in the result
+int es10c_get_profiles_info_taglist(struct euicc_ctx *ctx, const uint8_t *tagList, uint32_t tagList_len,
+                                    struct es10c_profile_info_list **profileInfoList);
 int es10c_enable_profile(struct euicc_ctx *ctx, const char *id, uint8_t refreshFlag);
 int es10c_disable_profile(struct euicc_ctx *ctx, const char *id, uint8_t refreshFlag);
 int es10c_delete_profile(struct euicc_ctx *ctx, const char *id);
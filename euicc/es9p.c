@@ -1,11 +1,12 @@
 #include "es9p.h"
 #include "es9p_errors.h"
 
+#include "base64.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include <cjson/cJSON_ex.h>
 
 static const char *lpa_header[] = {
     "User-Agent: gsma-rsp-lpad",
@@ -14,16 +15,697 @@ static const char *lpa_header[] = {
     NULL,
 };
 
-static void es9p_base64_trim(char *str) {
-    char *p = str;
+#define ES9P_JSON_MAX_KEYS 8
+
+// A raw JSON value inside the response buffer, [ptr, end)
+struct es9p_json_span {
+    char *ptr;
+    char *end;
+};
+
+static char *es9p_json_ws(char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+static char *es9p_json_string_end(char *p, const char *end) {
+    if (p >= end || *p != '"') {
+        return NULL;
+    }
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+static char *es9p_json_value_end(char *p, const char *end) {
+    uint32_t depth = 0;
+
+    if (p >= end) {
+        return NULL;
+    }
+
+    if (*p == '"') {
+        return es9p_json_string_end(p, end);
+    }
+
+    if (*p != '{' && *p != '[') {
+        // literal or number
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r'
+               && *p != '\n') {
+            p++;
+        }
+        return p;
+    }
+
+    while (p < end) {
+        switch (*p) {
+        case '"':
+            if ((p = es9p_json_string_end(p, end)) == NULL) {
+                return NULL;
+            }
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0) {
+                return p + 1;
+            }
+            break;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+// Single pass over an object, recording the value span of every key in keys[] (NULL-terminated).
+static int es9p_json_object_lookup(const struct es9p_json_span *object, const char *keys[],
+                                   struct es9p_json_span spans[]) {
+    char *p = object->ptr;
+    const char *end = object->end;
+
+    for (int i = 0; keys[i] != NULL; i++) {
+        spans[i].ptr = NULL;
+        spans[i].end = NULL;
+    }
+
+    if (p >= end || *p != '{') {
+        return -1;
+    }
 
-    while (*p) {
-        if (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t') {
-            memmove(p, p + 1, strlen(p));
+    p = es9p_json_ws(p + 1, end);
+    if (p < end && *p == '}') {
+        return 0;
+    }
+
+    while (p < end) {
+        char *key = p, *key_end, *value_end;
+
+        if ((key_end = es9p_json_string_end(key, end)) == NULL) {
+            return -1;
+        }
+        p = es9p_json_ws(key_end, end);
+        if (p >= end || *p != ':') {
+            return -1;
+        }
+        p = es9p_json_ws(p + 1, end);
+        if ((value_end = es9p_json_value_end(p, end)) == NULL) {
+            return -1;
+        }
+
+        for (int i = 0; keys[i] != NULL; i++) {
+            const size_t key_len = key_end - key - 2;
+            if (spans[i].ptr == NULL && strlen(keys[i]) == key_len && memcmp(key + 1, keys[i], key_len) == 0) {
+                spans[i].ptr = p;
+                spans[i].end = value_end;
+            }
+        }
+
+        p = es9p_json_ws(value_end, end);
+        if (p < end && *p == ',') {
+            p = es9p_json_ws(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}') {
+            return 0;
+        }
+        return -1;
+    }
+
+    return -1;
+}
+
+static int es9p_json_span_is_string(const struct es9p_json_span *span) { return span->ptr && *span->ptr == '"'; }
+
+static int es9p_json_span_is_object(const struct es9p_json_span *span) { return span->ptr && *span->ptr == '{'; }
+
+static int es9p_json_hex4(const char *p) {
+    int value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        value <<= 4;
+        if (p[i] >= '0' && p[i] <= '9') {
+            value |= p[i] - '0';
+        } else if (p[i] >= 'a' && p[i] <= 'f') {
+            value |= p[i] - 'a' + 10;
+        } else if (p[i] >= 'A' && p[i] <= 'F') {
+            value |= p[i] - 'A' + 10;
         } else {
+            return -1;
+        }
+    }
+
+    return value;
+}
+
+// Decodes a JSON string span into dest in one linear pass, optionally dropping whitespace
+// (wrapped base64). dest may alias the span as long as it does not start after it, the
+// decoded form is never longer than the raw one. Returns the decoded length.
+static int es9p_json_string_extract(const struct es9p_json_span *span, char *dest, int strip_whitespace) {
+    const char *p = span->ptr + 1;
+    const char *end = span->end - 1;
+    char *out = dest;
+
+    while (p < end) {
+        char c = *p++;
+
+        if (c == '\\') {
+            if (p >= end) {
+                return -1;
+            }
+            switch (c = *p++) {
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u': {
+                long codepoint;
+
+                if (end - p < 4 || (codepoint = es9p_json_hex4(p)) < 0) {
+                    return -1;
+                }
+                p += 4;
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                    long low;
+
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || (low = es9p_json_hex4(p + 2)) < 0xDC00
+                        || low > 0xDFFF) {
+                        return -1;
+                    }
+                    p += 6;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (codepoint < 0x80) {
+                    *out++ = (char)codepoint;
+                } else if (codepoint < 0x800) {
+                    *out++ = (char)(0xC0 | (codepoint >> 6));
+                    *out++ = (char)(0x80 | (codepoint & 0x3F));
+                } else if (codepoint < 0x10000) {
+                    *out++ = (char)(0xE0 | (codepoint >> 12));
+                    *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                    *out++ = (char)(0x80 | (codepoint & 0x3F));
+                } else {
+                    *out++ = (char)(0xF0 | (codepoint >> 18));
+                    *out++ = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+                    *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                    *out++ = (char)(0x80 | (codepoint & 0x3F));
+                }
+                continue;
+            }
+            default: // '"', '\\' and '/'
+                break;
+            }
+        }
+
+        if (strip_whitespace && (c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+            continue;
+        }
+        *out++ = c;
+    }
+
+    *out = '\0';
+    return out - dest;
+}
+
+// Steps through the elements of an array span, *cursor starts out NULL. Returns 1 with the next
+// element in item, 0 at the end of the array, -1 on malformed input.
+static int es9p_json_array_next(const struct es9p_json_span *array, char **cursor, struct es9p_json_span *item) {
+    char *p = *cursor;
+    const char *end = array->end;
+
+    if (p == NULL) {
+        if (array->ptr >= end || *array->ptr != '[') {
+            return -1;
+        }
+        p = es9p_json_ws(array->ptr + 1, end);
+        if (p < end && *p == ']') {
+            *cursor = (char *)end;
+            return 0;
+        }
+    } else if (p >= end) {
+        return 0;
+    } else {
+        p = es9p_json_ws(p, end);
+        if (p < end && *p == ']') {
+            *cursor = (char *)end;
+            return 0;
+        }
+        if (p >= end || *p != ',') {
+            return -1;
+        }
+        p = es9p_json_ws(p + 1, end);
+    }
+
+    item->ptr = p;
+    if ((item->end = es9p_json_value_end(p, end)) == NULL || item->end == item->ptr) {
+        return -1;
+    }
+    *cursor = item->end;
+
+    return 1;
+}
+
+// Length of a C string once quoted and escaped as a JSON string, NULL is written as null
+static size_t es9p_json_quoted_len(const char *str) {
+    size_t len = 2;
+
+    if (str == NULL) {
+        return 4;
+    }
+
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        switch (*p) {
+        case '"':
+        case '\\':
+        case '\b':
+        case '\f':
+        case '\n':
+        case '\r':
+        case '\t':
+            len += 2;
+            break;
+        default:
+            len += *p < 0x20 ? 6 : 1;
+            break;
+        }
+    }
+
+    return len;
+}
+
+static char *es9p_json_quoted_write(char *out, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (str == NULL) {
+        memcpy(out, "null", 4);
+        return out + 4;
+    }
+
+    *out++ = '"';
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        switch (*p) {
+        case '"':
+        case '\\':
+            *out++ = '\\';
+            *out++ = *p;
+            break;
+        case '\b':
+            *out++ = '\\';
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = '\\';
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = '\\';
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = '\\';
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = '\\';
+            *out++ = 't';
+            break;
+        default:
+            if (*p < 0x20) {
+                memcpy(out, "\\u00", 4);
+                out[4] = hex[*p >> 4];
+                out[5] = hex[*p & 0xF];
+                out += 6;
+            } else {
+                *out++ = *p;
+            }
+            break;
+        }
+    }
+    *out++ = '"';
+
+    return out;
+}
+
+// Serialises {"ikey[0]":"idata[0]",...} into a single exactly sized allocation
+static char *es9p_json_request(const char *ikey[], const char *idata[]) {
+    size_t len = 2;
+    char *buf, *out;
+
+    for (int i = 0; ikey[i] != NULL; i++) {
+        len += (i ? 1 : 0) + es9p_json_quoted_len(ikey[i]) + 1 + es9p_json_quoted_len(idata[i]);
+    }
+
+    if ((buf = malloc(len + 1)) == NULL) {
+        return NULL;
+    }
+
+    out = buf;
+    *out++ = '{';
+    for (int i = 0; ikey[i] != NULL; i++) {
+        if (i) {
+            *out++ = ',';
+        }
+        out = es9p_json_quoted_write(out, ikey[i]);
+        *out++ = ':';
+        out = es9p_json_quoted_write(out, idata[i]);
+    }
+    *out++ = '}';
+    *out = '\0';
+
+    return buf;
+}
+
+// Copies a string member of an object into a fixed-size status field, leaving it untouched if absent
+static int es9p_json_status_field(char *dest, size_t dest_size, const struct es9p_json_span *span) {
+    if (!es9p_json_span_is_string(span)) {
+        return -1;
+    }
+    if (es9p_json_string_extract(span, span->ptr, 0) < 0) {
+        return -1;
+    }
+    snprintf(dest, dest_size, "%s", span->ptr);
+    return 0;
+}
+
+#define ES9P_BPP_KEY "boundProfilePackage"
+
+// Splits a getBoundProfilePackage response while it is received: the base64 value of
+// "boundProfilePackage" is decoded straight into a file, everything else is kept as JSON.
+struct es9p_bpp_stream {
+    FILE *bpp;
+    uint32_t bpp_len;
+    uint32_t rx_len;
+    uint32_t memory_limit;
+    uint32_t memory_peak;
+    char *json;
+    uint32_t json_len;
+    uint32_t json_size;
+    uint32_t depth;
+    uint8_t in_string;
+    uint8_t in_key;
+    uint8_t in_bpp;
+    uint8_t escape;
+    uint8_t expect_key;
+    uint8_t key_matched;
+    uint32_t key_len;
+    char key[sizeof(ES9P_BPP_KEY)];
+    struct euicc_base64_decoder decoder;
+};
+
+static int es9p_bpp_stream_json_append(struct es9p_bpp_stream *stream, char c) {
+    if (stream->json_len + 1 >= stream->json_size) {
+        uint32_t new_size = stream->json_size ? stream->json_size * 2 : 1024;
+        char *new_json;
+
+        if (new_size > stream->memory_limit) {
+            new_size = stream->memory_limit;
+        }
+        if (new_size <= stream->json_len + 1) {
+            return -1;
+        }
+        new_json = realloc(stream->json, new_size);
+        if (new_json == NULL) {
+            return -1;
+        }
+        stream->json = new_json;
+        stream->json_size = new_size;
+    }
+
+    stream->json[stream->json_len++] = c;
+    stream->json[stream->json_len] = '\0';
+
+    return 0;
+}
+
+static int es9p_bpp_stream_decode(struct es9p_bpp_stream *stream, const char *b64, uint32_t b64_len) {
+    uint8_t bin[768];
+
+    while (b64_len) {
+        const uint32_t chunk = b64_len > 1024 ? 1024 : b64_len;
+        int bin_len;
+
+        if ((bin_len = euicc_base64_decoder_update(&stream->decoder, bin, b64, chunk)) < 0) {
+            return -1;
+        }
+        if (bin_len && fwrite(bin, 1, bin_len, stream->bpp) != (size_t)bin_len) {
+            return -1;
+        }
+        stream->bpp_len += bin_len;
+        b64 += chunk;
+        b64_len -= chunk;
+    }
+
+    return 0;
+}
+
+static int es9p_bpp_stream_callback(const uint8_t *data, uint32_t data_len, void *userdata) {
+    struct es9p_bpp_stream *stream = userdata;
+    const char *p = (const char *)data;
+    const char *end = p + data_len;
+
+    stream->rx_len += data_len;
+
+    while (p < end) {
+        const char c = *p;
+
+        if (stream->in_bpp) {
+            const char *run = p;
+
+            if (stream->escape) {
+                stream->escape = 0;
+                p++;
+                if (c == '/') {
+                    if (es9p_bpp_stream_decode(stream, "/", 1) < 0) {
+                        return -1;
+                    }
+                } else if (c != 'n' && c != 'r' && c != 't') {
+                    return -1;
+                }
+                continue;
+            }
+
+            while (p < end && *p != '"' && *p != '\\') {
+                p++;
+            }
+            if (es9p_bpp_stream_decode(stream, run, p - run) < 0) {
+                return -1;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p == '\\') {
+                stream->escape = 1;
+            } else {
+                stream->in_bpp = 0;
+                if (es9p_bpp_stream_json_append(stream, '"') < 0) {
+                    return -1;
+                }
+            }
             p++;
+            continue;
+        }
+
+        if (es9p_bpp_stream_json_append(stream, c) < 0) {
+            return -1;
+        }
+        p++;
+
+        if (stream->in_string) {
+            if (stream->escape) {
+                stream->escape = 0;
+                stream->key_len = sizeof(stream->key);
+            } else if (c == '\\') {
+                stream->escape = 1;
+            } else if (c == '"') {
+                stream->in_string = 0;
+                if (stream->in_key) {
+                    stream->in_key = 0;
+                    stream->key_matched = (stream->key_len == strlen(ES9P_BPP_KEY))
+                                          && (memcmp(stream->key, ES9P_BPP_KEY, stream->key_len) == 0);
+                }
+            } else if (stream->in_key) {
+                if (stream->key_len < sizeof(stream->key)) {
+                    stream->key[stream->key_len++] = c;
+                }
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            if (stream->depth == 1 && stream->expect_key) {
+                stream->in_string = 1;
+                stream->in_key = 1;
+                stream->key_len = 0;
+            } else if (stream->depth == 1 && stream->key_matched) {
+                stream->in_bpp = 1;
+                stream->key_matched = 0;
+            } else {
+                stream->in_string = 1;
+            }
+            break;
+        case '{':
+        case '[':
+            stream->depth++;
+            if (stream->depth == 1) {
+                stream->expect_key = 1;
+            }
+            break;
+        case '}':
+        case ']':
+            stream->depth--;
+            break;
+        case ':':
+            if (stream->depth == 1) {
+                stream->expect_key = 0;
+            }
+            break;
+        case ',':
+            if (stream->depth == 1) {
+                stream->expect_key = 1;
+                stream->key_matched = 0;
+            }
+            break;
         }
     }
+
+    if (stream->json_size > stream->memory_peak) {
+        stream->memory_peak = stream->json_size;
+    }
+
+    return 0;
+}
+
+static int es9p_bpp_stream_finish(struct es9p_bpp_stream *stream) {
+    uint8_t bin[2];
+    int bin_len;
+
+    if (stream->in_bpp || stream->json == NULL) {
+        return -1;
+    }
+
+    if ((bin_len = euicc_base64_decoder_final(&stream->decoder, bin)) < 0) {
+        return -1;
+    }
+    if (bin_len && fwrite(bin, 1, bin_len, stream->bpp) != (size_t)bin_len) {
+        return -1;
+    }
+    stream->bpp_len += bin_len;
+
+    if (fflush(stream->bpp) != 0) {
+        return -1;
+    }
+    rewind(stream->bpp);
+
+    return 0;
+}
+
+static void es9p_transfer_info_add(struct euicc_http_transfer_info *total, const struct euicc_http_transfer_info *info) {
+    total->bytes_sent += info->bytes_sent;
+    total->bytes_received_wire += info->bytes_received_wire;
+    total->bytes_received += info->bytes_received;
+    total->time_namelookup_us += info->time_namelookup_us;
+    total->time_connect_us += info->time_connect_us;
+    total->time_tls_us += info->time_tls_us;
+    total->time_first_byte_us += info->time_first_byte_us;
+    total->time_total_us += info->time_total_us;
+}
+
+static void es9p_trans_account_info(struct euicc_ctx *ctx, const char *host,
+                                    const struct euicc_http_transfer_info *transfer) {
+    struct euicc_http_host_stats *host_stats;
+    struct euicc_http_request_stats *recent;
+    const struct euicc_http_transfer_info info = *transfer;
+
+    es9p_transfer_info_add(&ctx->http.stats.transfer, &info);
+
+    for (host_stats = ctx->http.stats.hosts; host_stats != NULL; host_stats = host_stats->next) {
+        if (strcmp(host_stats->host, host) == 0) {
+            break;
+        }
+    }
+    if (host_stats == NULL && (host_stats = calloc(1, sizeof(*host_stats))) != NULL) {
+        if ((host_stats->host = strdup(host)) == NULL) {
+            free(host_stats);
+            host_stats = NULL;
+        } else {
+            host_stats->next = ctx->http.stats.hosts;
+            ctx->http.stats.hosts = host_stats;
+        }
+    }
+    if (host_stats != NULL) {
+        host_stats->requests++;
+        es9p_transfer_info_add(&host_stats->transfer, &info);
+    }
+
+    recent = &ctx->http.stats.recent[ctx->http.stats.requests % EUICC_HTTP_STATS_RECENT];
+    recent->host = host_stats ? host_stats->host : NULL;
+    recent->transfer = info;
+    ctx->http.stats.requests++;
+
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr,
+                "[DEBUG] [HTTP] [STATS] sent: %" PRIu64 ", received: %" PRIu64 ", on the wire: %" PRIu64
+                ", dns: %" PRIu64 "us, connect: %" PRIu64 "us, tls: %" PRIu64 "us, first byte: %" PRIu64
+                "us, total: %" PRIu64 "us\n",
+                info.bytes_sent, info.bytes_received, info.bytes_received_wire, info.time_namelookup_us,
+                info.time_connect_us, info.time_tls_us, info.time_first_byte_us, info.time_total_us);
+    }
+}
+
+// Adds the last request to ctx->http.stats, drivers without transfer_info are assumed not to compress
+static void es9p_trans_account(struct euicc_ctx *ctx, const char *host, uint32_t tx_len, uint32_t rx_len) {
+    struct euicc_http_transfer_info info = {
+        .bytes_sent = tx_len,
+        .bytes_received_wire = rx_len,
+        .bytes_received = rx_len,
+    };
+
+    if (ctx->http.interface->transfer_info) {
+        ctx->http.interface->transfer_info(ctx, &info);
+    }
+
+    es9p_trans_account_info(ctx, host, &info);
+}
+
+// Server addresses are host[:port] and spoken to over HTTPS. They come from activation codes, the eUICC
+// and SM-DS events, so an address carrying its own scheme (e.g. http://127.0.0.1:8080 for a local test
+// server) is only used as is when LIBEUICC_ALLOW_INSECURE_HTTP is set.
+static char *es9p_url(const char *server_address, const char *api) {
+    const char *prefix = "https://";
+    char *url;
+
+    if (getenv("LIBEUICC_ALLOW_INSECURE_HTTP")
+        && (strncmp(server_address, "http://", 7) == 0 || strncmp(server_address, "https://", 8) == 0)) {
+        prefix = "";
+    }
+
+    url = malloc(strlen(prefix) + strlen(server_address) + strlen(api) + 1);
+    if (url != NULL) {
+        sprintf(url, "%s%s%s", prefix, server_address, api);
+    }
+    return url;
 }
 
 static int es9p_trans_ex(struct euicc_ctx *ctx, const char *url, const char *url_postfix, uint32_t *rcode,
@@ -33,22 +715,16 @@ static int es9p_trans_ex(struct euicc_ctx *ctx, const char *url, const char *url
     uint8_t *rbuf = NULL;
     uint32_t rlen;
     char *full_url = NULL;
-    const char *url_prefix = "https://";
 
     if (!ctx->http.interface) {
         goto err;
     }
 
-    full_url = malloc(strlen(url_prefix) + strlen(url) + strlen(url_postfix) + 1);
+    full_url = es9p_url(url, url_postfix);
     if (full_url == NULL) {
         goto err;
     }
 
-    full_url[0] = '\0';
-    strcat(full_url, url_prefix);
-    strcat(full_url, url);
-    strcat(full_url, url_postfix);
-
     if (getenv("LIBEUICC_DEBUG_HTTP")) {
         fprintf(stderr, "[DEBUG] [HTTP] [TX] url: %s, data: %s\n", full_url, str_tx);
     }
@@ -57,22 +733,23 @@ static int es9p_trans_ex(struct euicc_ctx *ctx, const char *url, const char *url
         < 0) {
         goto err;
     }
-    if (getenv("LIBEUICC_DEBUG_HTTP")) {
-        fprintf(stderr, "[DEBUG] [HTTP] [RX] rcode: %d, data: %s\n", rcode_mearged, rbuf);
-    }
+
+    es9p_trans_account(ctx, url, strlen(str_tx), rlen);
 
     free(full_url);
     full_url = NULL;
 
-    *str_rx = malloc(rlen + 1);
+    // take over the driver buffer instead of copying it, it only needs room for the terminator
+    *str_rx = realloc(rbuf, rlen + 1);
     if (*str_rx == NULL) {
         goto err;
     }
-    memcpy(*str_rx, rbuf, rlen);
+    rbuf = NULL;
     (*str_rx)[rlen] = '\0';
 
-    free(rbuf);
-    rbuf = NULL;
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [RX] rcode: %d, data: %s\n", rcode_mearged, *str_rx);
+    }
 
     *rcode = rcode_mearged;
 
@@ -87,45 +764,59 @@ exit:
     return fret;
 }
 
-static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *api, const char *ikey[],
-                           const char *idata[], const char *okey[], const char *oobj, void **optr[]) {
+static int es9p_trans_stream_ex(struct euicc_ctx *ctx, const char *url, const char *url_postfix, uint32_t *rcode,
+                                struct es9p_bpp_stream *stream, const char *str_tx) {
     int fret = 0;
-    cJSON *sjroot = NULL;
-    char *sbuf = NULL;
-    uint32_t rcode;
-    char *rbuf = NULL;
-    cJSON *rjroot = NULL, *rjheader = NULL, *rjfunctionExecutionStatus = NULL;
-
-    strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
-    strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
-    strncpy(ctx->http.status.subjectIdentifier, "unknown", sizeof(ctx->http.status.subjectIdentifier));
-    strncpy(ctx->http.status.message, "unknown", sizeof(ctx->http.status.message));
+    uint32_t rcode_mearged;
+    char *full_url = NULL;
 
-    if (!(sjroot = cJSON_CreateObject())) {
+    if (!ctx->http.interface || !ctx->http.interface->transmit_stream) {
         goto err;
     }
 
-    for (int i = 0; ikey[i] != NULL; i++) {
-        if (!cJSON_AddStringOrNullToObject(sjroot, ikey[i], idata[i])) {
-            goto err;
-        }
+    full_url = es9p_url(url, url_postfix);
+    if (full_url == NULL) {
+        goto err;
     }
 
-    if (!(sbuf = cJSON_PrintUnformatted(sjroot))) {
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [TX] url: %s, data: %s\n", full_url, str_tx);
+    }
+    if (ctx->http.interface->transmit_stream(ctx, full_url, &rcode_mearged, es9p_bpp_stream_callback, stream,
+                                             (const uint8_t *)str_tx, strlen(str_tx), lpa_header)
+        < 0) {
         goto err;
     }
-    cJSON_Delete(sjroot);
-    sjroot = NULL;
-
-    if (es9p_trans_ex(ctx, smdp, api, &rcode, &rbuf, sbuf) < 0) {
-        strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
-        strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
-        strncpy(ctx->http.status.subjectIdentifier, "unknown", sizeof(ctx->http.status.subjectIdentifier));
-        strncpy(ctx->http.status.message, "HTTP transport failed", sizeof(ctx->http.status.message));
+    es9p_trans_account(ctx, url, strlen(str_tx), stream->rx_len);
+    if (es9p_bpp_stream_finish(stream) < 0) {
         goto err;
     }
-    free(sbuf);
-    sbuf = NULL;
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [RX] rcode: %d, data: %s, spooled: %u bytes\n", rcode_mearged, stream->json,
+                stream->bpp_len);
+    }
+
+    *rcode = rcode_mearged;
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    free(full_url);
+    return fret;
+}
+
+// Checks the status and decodes the okey values of a response, the largest string may take over *rbuf
+static int es9p_json_response(struct euicc_ctx *ctx, uint32_t rcode, char *json, char **rbuf, const char *okey[],
+                              const char *oobj, void **optr[]) {
+    int fret = 0;
+    const char *rkey[ES9P_JSON_MAX_KEYS + 1];
+    struct es9p_json_span root, rspan[ES9P_JSON_MAX_KEYS], function_execution_status, status_code_data,
+        status_span[4];
+    uint8_t owned[ES9P_JSON_MAX_KEYS] = {0};
+    int okey_count = 0, handover = -1;
 
     if (rcode / 100 != 2) {
         strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
@@ -140,25 +831,33 @@ static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *
         goto exit;
     }
 
-    if (!(rjroot = cJSON_Parse((const char *)rbuf))) {
-        strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
-        strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
-        strncpy(ctx->http.status.subjectIdentifier, "root", sizeof(ctx->http.status.subjectIdentifier));
-        strncpy(ctx->http.status.message, "Not JSON", sizeof(ctx->http.status.message));
-        goto err;
+    root.ptr = es9p_json_ws(json, json + strlen(json));
+    root.end = json + strlen(json);
+
+    rkey[0] = "header";
+    for (okey_count = 0; okey[okey_count] != NULL; okey_count++) {
+        if (okey_count + 1 >= ES9P_JSON_MAX_KEYS) {
+            goto err;
+        }
+        rkey[okey_count + 1] = okey[okey_count];
     }
-    free(rbuf);
-    rbuf = NULL;
+    rkey[okey_count + 1] = NULL;
+
+    if (es9p_json_object_lookup(&root, rkey, rspan) < 0) {
+        const char *root_end = es9p_json_value_end(root.ptr, root.end);
 
-    if (!cJSON_IsObject(rjroot)) {
         strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
         strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
         strncpy(ctx->http.status.subjectIdentifier, "root", sizeof(ctx->http.status.subjectIdentifier));
-        strncpy(ctx->http.status.message, "Not Object", sizeof(ctx->http.status.message));
+        if (root_end != NULL && root.ptr < root.end && strchr("[\"-0123456789tfn", *root.ptr) != NULL) {
+            strncpy(ctx->http.status.message, "Not Object", sizeof(ctx->http.status.message));
+        } else {
+            strncpy(ctx->http.status.message, "Not JSON", sizeof(ctx->http.status.message));
+        }
         goto err;
     }
 
-    if (!cJSON_HasObjectItem(rjroot, "header")) {
+    if (rspan[0].ptr == NULL) {
         strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
         strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
         strncpy(ctx->http.status.subjectIdentifier, "header", sizeof(ctx->http.status.subjectIdentifier));
@@ -166,9 +865,11 @@ static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *
         goto err;
     }
 
-    rjheader = cJSON_GetObjectItem(rjroot, "header");
-
-    if (!cJSON_HasObjectItem(rjheader, "functionExecutionStatus")) {
+    if (!es9p_json_span_is_object(&rspan[0])
+        || es9p_json_object_lookup(&rspan[0], (const char *[]){"functionExecutionStatus", NULL},
+                                   &function_execution_status)
+               < 0
+        || function_execution_status.ptr == NULL) {
         strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
         strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
         strncpy(ctx->http.status.subjectIdentifier, "functionExecutionStatus",
@@ -177,32 +878,20 @@ static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *
         goto err;
     }
 
-    rjfunctionExecutionStatus = cJSON_GetObjectItem(rjheader, "functionExecutionStatus");
-
-    if (cJSON_HasObjectItem(rjfunctionExecutionStatus, "statusCodeData")) {
-        cJSON *statusCodeData = cJSON_GetObjectItem(rjfunctionExecutionStatus, "statusCodeData");
-
-        if (cJSON_HasObjectItem(statusCodeData, "reasonCode")
-            && cJSON_IsString(cJSON_GetObjectItem(statusCodeData, "reasonCode"))) {
-            strncpy(ctx->http.status.reasonCode, cJSON_GetObjectItem(statusCodeData, "reasonCode")->valuestring,
-                    sizeof(ctx->http.status.reasonCode));
-        }
-        if (cJSON_HasObjectItem(statusCodeData, "subjectCode")
-            && cJSON_IsString(cJSON_GetObjectItem(statusCodeData, "subjectCode"))) {
-            strncpy(ctx->http.status.subjectCode, cJSON_GetObjectItem(statusCodeData, "subjectCode")->valuestring,
-                    sizeof(ctx->http.status.subjectCode));
-        }
-        if (cJSON_HasObjectItem(statusCodeData, "subjectIdentifier")
-            && cJSON_IsString(cJSON_GetObjectItem(statusCodeData, "subjectIdentifier"))) {
-            strncpy(ctx->http.status.subjectIdentifier,
-                    cJSON_GetObjectItem(statusCodeData, "subjectIdentifier")->valuestring,
-                    sizeof(ctx->http.status.subjectIdentifier));
-        }
-        if (cJSON_HasObjectItem(statusCodeData, "message")
-            && cJSON_IsString(cJSON_GetObjectItem(statusCodeData, "message"))) {
-            strncpy(ctx->http.status.message, cJSON_GetObjectItem(statusCodeData, "message")->valuestring,
-                    sizeof(ctx->http.status.message));
-        } else {
+    if (es9p_json_span_is_object(&function_execution_status)
+        && es9p_json_object_lookup(&function_execution_status, (const char *[]){"statusCodeData", NULL},
+                                   &status_code_data)
+               == 0
+        && es9p_json_span_is_object(&status_code_data)
+        && es9p_json_object_lookup(&status_code_data,
+                                   (const char *[]){"reasonCode", "subjectCode", "subjectIdentifier", "message", NULL},
+                                   status_span)
+               == 0) {
+        es9p_json_status_field(ctx->http.status.reasonCode, sizeof(ctx->http.status.reasonCode), &status_span[0]);
+        es9p_json_status_field(ctx->http.status.subjectCode, sizeof(ctx->http.status.subjectCode), &status_span[1]);
+        es9p_json_status_field(ctx->http.status.subjectIdentifier, sizeof(ctx->http.status.subjectIdentifier),
+                               &status_span[2]);
+        if (es9p_json_status_field(ctx->http.status.message, sizeof(ctx->http.status.message), &status_span[3]) < 0) {
             const char *message = es9p_error_message(ctx->http.status.subjectCode, ctx->http.status.reasonCode);
             if (message != NULL) {
                 strncpy(ctx->http.status.message, message, sizeof(ctx->http.status.message));
@@ -214,41 +903,139 @@ static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *
         }
     }
 
-    for (int i = 0; okey[i] != NULL; i++) {
-        cJSON *obj;
+    // The spans are disjoint, so each value is decoded in place without disturbing the others.
+    // The largest string (the base64 payload) is decoded to the start of the response buffer
+    // and handed over as is, saving a copy of the biggest allocation of the exchange.
+    for (int i = 0; i < okey_count; i++) {
+        struct es9p_json_span *span = &rspan[i + 1];
 
-        obj = cJSON_GetObjectItem(rjroot, okey[i]);
-        if (!obj) {
+        if (span->ptr == NULL) {
             goto err;
         }
-
-        if (cJSON_IsString(obj)) {
-            if (!(*optr[i] = strdup(obj->valuestring))) {
-                goto err;
-            }
-        } else {
-            if (oobj[i] == 0) {
-                goto err;
-            }
-            if (!(*(optr[i]) = cJSON_Duplicate(obj, 1))) {
-                goto err;
+        if (es9p_json_span_is_string(span)) {
+            if (rbuf && (handover < 0 || span->end - span->ptr > rspan[handover + 1].end - rspan[handover + 1].ptr)) {
+                handover = i;
             }
+            continue;
+        }
+        if (oobj[i] == 0) {
+            goto err;
+        }
+        // non-string values are handed out as their raw JSON text, to be walked by the caller
+        if (!(*(optr[i]) = malloc(span->end - span->ptr + 1))) {
+            goto err;
+        }
+        memcpy(*(optr[i]), span->ptr, span->end - span->ptr);
+        ((char *)*(optr[i]))[span->end - span->ptr] = '\0';
+        owned[i] = 1;
+    }
+
+    for (int i = 0; i < okey_count; i++) {
+        struct es9p_json_span *span = &rspan[i + 1];
+
+        if (i == handover || !es9p_json_span_is_string(span)) {
+            continue;
+        }
+        // all ES9+/ES11 string fields are base64 or identifiers, line breaks inside are insignificant
+        if (es9p_json_string_extract(span, span->ptr, 1) < 0) {
+            goto err;
+        }
+        if (!(*optr[i] = strdup(span->ptr))) {
+            goto err;
         }
+        owned[i] = 1;
     }
 
-    cJSON_Delete(rjroot);
-    rjroot = NULL;
+    if (handover >= 0) {
+        if (es9p_json_string_extract(&rspan[handover + 1], *rbuf, 1) < 0) {
+            goto err;
+        }
+        *optr[handover] = *rbuf;
+        owned[handover] = 1;
+        *rbuf = NULL;
+    }
 
     fret = 0;
     goto exit;
 
+err:
+    fret = -1;
+    for (int i = 0; i < okey_count; i++) {
+        if (owned[i]) {
+            free(*optr[i]);
+            *optr[i] = NULL;
+        }
+    }
+exit:
+    return fret;
+}
+
+static int es9p_trans_json_ex(struct euicc_ctx *ctx, const char *smdp, const char *api, const char *ikey[],
+                              const char *idata[], const char *okey[], const char *oobj, void **optr[],
+                              struct es9p_bpp_stream *stream) {
+    int fret = 0;
+    char *sbuf = NULL;
+    uint32_t rcode;
+    char *rbuf = NULL;
+
+    strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
+    strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
+    strncpy(ctx->http.status.subjectIdentifier, "unknown", sizeof(ctx->http.status.subjectIdentifier));
+    strncpy(ctx->http.status.message, "unknown", sizeof(ctx->http.status.message));
+
+    if (!(sbuf = es9p_json_request(ikey, idata))) {
+        goto err;
+    }
+
+    // buffering the whole response would silently break the memory limit the caller asked for
+    if (stream && (!ctx->http.interface || !ctx->http.interface->transmit_stream)) {
+        strncpy(ctx->http.status.message, "HTTP backend cannot stream, bounded-memory mode unavailable",
+                sizeof(ctx->http.status.message));
+        goto err;
+    }
+
+    if ((stream ? es9p_trans_stream_ex(ctx, smdp, api, &rcode, stream, sbuf)
+                : es9p_trans_ex(ctx, smdp, api, &rcode, &rbuf, sbuf))
+        < 0) {
+        strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
+        strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
+        strncpy(ctx->http.status.subjectIdentifier, "unknown", sizeof(ctx->http.status.subjectIdentifier));
+        strncpy(ctx->http.status.message, "HTTP transport failed", sizeof(ctx->http.status.message));
+        goto err;
+    }
+
+    fret = es9p_json_response(ctx, rcode, stream ? stream->json : rbuf, stream ? NULL : &rbuf, okey, oobj, optr);
+    goto exit;
+
 err:
     fret = -1;
 exit:
     free(sbuf);
-    cJSON_Delete(sjroot);
     free(rbuf);
-    cJSON_Delete(rjroot);
+    return fret;
+}
+
+static int es9p_trans_json(struct euicc_ctx *ctx, const char *smdp, const char *api, const char *ikey[],
+                           const char *idata[], const char *okey[], const char *oobj, void **optr[]) {
+    return es9p_trans_json_ex(ctx, smdp, api, ikey, idata, okey, oobj, optr, NULL);
+}
+
+int es9p_prewarm_r(struct euicc_ctx *ctx, const char *server_address) {
+    int fret;
+    char *url;
+
+    if (!ctx->http.interface || !ctx->http.interface->prewarm || server_address == NULL) {
+        return 0;
+    }
+
+    url = es9p_url(server_address, "/");
+    if (url == NULL) {
+        return -1;
+    }
+
+    fret = ctx->http.interface->prewarm(ctx, url);
+
+    free(url);
     return fret;
 }
 
@@ -272,11 +1059,6 @@ int es9p_initiate_authentication_r(struct euicc_ctx *ctx, char **transaction_id,
         return -1;
     }
 
-    es9p_base64_trim(resp->b64_serverSigned1);
-    es9p_base64_trim(resp->b64_serverSignature1);
-    es9p_base64_trim(resp->b64_euiccCiPKIdToBeUsed);
-    es9p_base64_trim(resp->b64_serverCertificate);
-
     return 0;
 }
 
@@ -294,11 +1076,37 @@ int es9p_get_bound_profile_package_r(struct euicc_ctx *ctx, char **b64_bound_pro
         return -1;
     }
 
-    es9p_base64_trim(*b64_bound_profile_package);
-
     return 0;
 }
 
+int es9p_get_bound_profile_package_stream_r(struct euicc_ctx *ctx, FILE *bpp, uint32_t memory_limit,
+                                            uint32_t *memory_peak, const char *server_address,
+                                            const char *transaction_id, const char *b64_prepare_download_response) {
+    int fret;
+    const char *ikey[] = {"transactionId", "prepareDownloadResponse", NULL};
+    const char *idata[] = {transaction_id, b64_prepare_download_response, NULL};
+    const char *okey[] = {NULL};
+    struct es9p_bpp_stream stream;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.bpp = bpp;
+    stream.memory_limit = memory_limit;
+    euicc_base64_decoder_init(&stream.decoder);
+
+    fret = es9p_trans_json_ex(ctx, server_address, "/gsma/rsp2/es9plus/getBoundProfilePackage", ikey, idata, okey,
+                              NULL, NULL, &stream);
+    if (fret == 0 && stream.bpp_len == 0) {
+        fret = -1;
+    }
+
+    if (memory_peak) {
+        *memory_peak = stream.memory_peak;
+    }
+    free(stream.json);
+
+    return fret;
+}
+
 int es9p_authenticate_client_r(struct euicc_ctx *ctx, struct es10b_prepare_download_param *resp,
                                const char *server_address, const char *transaction_id,
                                const char *b64_authenticate_server_response) {
@@ -313,11 +1121,6 @@ int es9p_authenticate_client_r(struct euicc_ctx *ctx, struct es10b_prepare_downl
         return -1;
     }
 
-    es9p_base64_trim(resp->b64_profileMetadata);
-    es9p_base64_trim(resp->b64_smdpSigned2);
-    es9p_base64_trim(resp->b64_smdpSignature2);
-    es9p_base64_trim(resp->b64_smdpCertificate);
-
     return 0;
 }
 
@@ -333,52 +1136,54 @@ int es9p_cancel_session_r(struct euicc_ctx *ctx, const char *server_address, con
     return 0;
 }
 
-int es11_authenticate_client_r(struct euicc_ctx *ctx, char ***smdp_list, const char *server_address,
-                               const char *transaction_id, const char *b64_authenticate_server_response) {
+static int es11_smdp_list_parse(char ***smdp_list, char *j_eventEntries) {
     int fret = 0;
-    cJSON *j_eventEntries = NULL;
-    int j_eventEntries_size = 0;
-    const char *ikey[] = {"transactionId", "authenticateServerResponse", NULL};
-    const char *idata[] = {transaction_id, b64_authenticate_server_response, NULL};
-    const char *okey[] = {"eventEntries", NULL};
-    const char oobj[] = {1};
-    void **optr[] = {(void **)&j_eventEntries, NULL};
+    struct es9p_json_span eventEntries, event, rspServerAddress;
+    char *cursor;
+    int eventEntries_size = 0, ret;
 
-    if (es9p_trans_json(ctx, server_address, "/gsma/rsp2/es9plus/authenticateClient", ikey, idata, okey, oobj, optr)) {
-        return -1;
-    }
+    *smdp_list = NULL;
 
-    if (j_eventEntries == NULL || !cJSON_IsArray(j_eventEntries)) {
-        return -1;
-    }
+    eventEntries.ptr = j_eventEntries;
+    eventEntries.end = j_eventEntries + strlen(j_eventEntries);
 
-    j_eventEntries_size = cJSON_GetArraySize(j_eventEntries);
+    cursor = NULL;
+    while ((ret = es9p_json_array_next(&eventEntries, &cursor, &event)) > 0) {
+        eventEntries_size++;
+    }
+    if (ret < 0) {
+        goto err;
+    }
 
-    *smdp_list = malloc(sizeof(char *) * (j_eventEntries_size + 1));
+    *smdp_list = malloc(sizeof(char *) * (eventEntries_size + 1));
     if (*smdp_list == NULL) {
-        fret = -1;
         goto err;
     }
-    memset(*smdp_list, 0, sizeof(char *) * (j_eventEntries_size + 1));
-
-    for (int i = 0; i < j_eventEntries_size; i++) {
-        cJSON *j_event = cJSON_GetArrayItem(j_eventEntries, i);
-        cJSON *j_eventType = cJSON_GetObjectItem(j_event, "rspServerAddress");
+    memset(*smdp_list, 0, sizeof(char *) * (eventEntries_size + 1));
 
-        if (j_eventType == NULL || !cJSON_IsString(j_eventType)) {
-            fret = -1;
+    cursor = NULL;
+    for (int i = 0; i < eventEntries_size; i++) {
+        if (es9p_json_array_next(&eventEntries, &cursor, &event) <= 0) {
+            goto err;
+        }
+        if (es9p_json_object_lookup(&event, (const char *[]){"rspServerAddress", NULL}, &rspServerAddress) < 0
+            || !es9p_json_span_is_string(&rspServerAddress)) {
+            goto err;
+        }
+        if (es9p_json_string_extract(&rspServerAddress, rspServerAddress.ptr, 0) < 0) {
             goto err;
         }
 
-        (*smdp_list)[i] = strdup(j_eventType->valuestring);
+        (*smdp_list)[i] = strdup(rspServerAddress.ptr);
     }
 
     fret = 0;
     goto exit;
 
 err:
+    fret = -1;
     if (*smdp_list) {
-        for (int i = 0; i < j_eventEntries_size; i++) {
+        for (int i = 0; i < eventEntries_size; i++) {
             free((*smdp_list)[i]);
         }
         free(*smdp_list);
@@ -386,10 +1191,33 @@ err:
     }
 
 exit:
-    cJSON_Delete(j_eventEntries);
     return fret;
 }
 
+int es11_authenticate_client_r(struct euicc_ctx *ctx, char ***smdp_list, const char *server_address,
+                               const char *transaction_id, const char *b64_authenticate_server_response) {
+    int fret;
+    char *j_eventEntries = NULL;
+    const char *ikey[] = {"transactionId", "authenticateServerResponse", NULL};
+    const char *idata[] = {transaction_id, b64_authenticate_server_response, NULL};
+    const char *okey[] = {"eventEntries", NULL};
+    const char oobj[] = {1};
+    void **optr[] = {(void **)&j_eventEntries, NULL};
+
+    *smdp_list = NULL;
+
+    if (es9p_trans_json(ctx, server_address, "/gsma/rsp2/es9plus/authenticateClient", ikey, idata, okey, oobj, optr)) {
+        return -1;
+    }
+
+    fret = es11_smdp_list_parse(smdp_list, j_eventEntries);
+
+    free(j_eventEntries);
+    return fret;
+}
+
+int es9p_prewarm(struct euicc_ctx *ctx) { return es9p_prewarm_r(ctx, ctx->http.server_address); }
+
 int es9p_initiate_authentication(struct euicc_ctx *ctx) {
     int fret;
 
@@ -435,10 +1263,35 @@ int es9p_get_bound_profile_package(struct euicc_ctx *ctx) {
         return -1;
     }
 
+    if (ctx->http._internal.bpp_spool) {
+        return -1;
+    }
+
     if (ctx->http._internal.b64_prepare_download_response == NULL) {
         return -1;
     }
 
+    if (ctx->http.bpp_memory_limit) {
+        if ((ctx->http._internal.bpp_spool = tmpfile()) == NULL) {
+            return -1;
+        }
+
+        fret = es9p_get_bound_profile_package_stream_r(
+            ctx, ctx->http._internal.bpp_spool, ctx->http.bpp_memory_limit, &ctx->http.bpp_memory_peak,
+            ctx->http.server_address, ctx->http._internal.transaction_id_http,
+            ctx->http._internal.b64_prepare_download_response);
+        if (fret < 0) {
+            fclose(ctx->http._internal.bpp_spool);
+            ctx->http._internal.bpp_spool = NULL;
+            return fret;
+        }
+
+        free(ctx->http._internal.b64_prepare_download_response);
+        ctx->http._internal.b64_prepare_download_response = NULL;
+
+        return fret;
+    }
+
     fret = es9p_get_bound_profile_package_r(ctx, &ctx->http._internal.b64_bound_profile_package,
                                             ctx->http.server_address, ctx->http._internal.transaction_id_http,
                                             ctx->http._internal.b64_prepare_download_response);
@@ -531,6 +1384,204 @@ int es9p_handle_notification(struct euicc_ctx *ctx, const char *b64_PendingNotif
                            NULL, NULL);
 }
 
+struct es9p_async_notification {
+    char *server_address;
+    void (*callback)(struct euicc_ctx *ctx, int result, void *userdata);
+    void *userdata;
+};
+
+static void es9p_handle_notification_async_done(struct euicc_ctx *ctx, struct euicc_http_response *response,
+                                                void *userdata) {
+    struct es9p_async_notification *request = userdata;
+    int result = 0;
+
+    es9p_trans_account_info(ctx, request->server_address, &response->info);
+
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [RX] rcode: %d, data: %.*s\n", response->rcode, (int)response->rx_len,
+                response->rx ? (const char *)response->rx : "");
+    }
+
+    if (response->result < 0) {
+        strncpy(ctx->http.status.message, "HTTP transport failed", sizeof(ctx->http.status.message));
+        result = -1;
+    } else if (response->rcode / 100 != 2) {
+        snprintf(ctx->http.status.subjectIdentifier, sizeof(ctx->http.status.subjectIdentifier), "%d",
+                 response->rcode);
+        strncpy(ctx->http.status.message, "HTTP status code error", sizeof(ctx->http.status.message));
+        result = -1;
+    }
+    free(response->rx);
+
+    request->callback(ctx, result, request->userdata);
+
+    free(request->server_address);
+    free(request);
+}
+
+int es9p_handle_notification_async_r(struct euicc_ctx *ctx, const char *server_address,
+                                     const char *b64_PendingNotification,
+                                     void (*callback)(struct euicc_ctx *ctx, int result, void *userdata),
+                                     void *userdata) {
+    int fret = 0;
+    const char *ikey[] = {"pendingNotification", NULL};
+    const char *idata[] = {b64_PendingNotification, NULL};
+    const char *api = "/gsma/rsp2/es9plus/handleNotification";
+    struct es9p_async_notification *request = NULL;
+    char *full_url = NULL;
+    char *sbuf = NULL;
+
+    if (!ctx->http.interface || !ctx->http.interface->async_submit) {
+        goto err;
+    }
+
+    if (!(sbuf = es9p_json_request(ikey, idata))) {
+        goto err;
+    }
+
+    full_url = es9p_url(server_address, api);
+    if (full_url == NULL) {
+        goto err;
+    }
+
+    request = calloc(1, sizeof(*request));
+    if (request == NULL || (request->server_address = strdup(server_address)) == NULL) {
+        goto err;
+    }
+    request->callback = callback;
+    request->userdata = userdata;
+
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [TX] url: %s, data: %s\n", full_url, sbuf);
+    }
+    if (ctx->http.interface->async_submit(ctx, full_url, (const uint8_t *)sbuf, strlen(sbuf), lpa_header,
+                                          es9p_handle_notification_async_done, request)
+        < 0) {
+        goto err;
+    }
+    request = NULL;
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+    if (request) {
+        free(request->server_address);
+        free(request);
+    }
+exit:
+    free(full_url);
+    free(sbuf);
+    return fret;
+}
+
+struct es11_async_authenticate_client {
+    char *server_address;
+    void (*callback)(struct euicc_ctx *ctx, int result, char **smdp_list, void *userdata);
+    void *userdata;
+};
+
+static void es11_authenticate_client_async_done(struct euicc_ctx *ctx, struct euicc_http_response *response,
+                                                void *userdata) {
+    struct es11_async_authenticate_client *request = userdata;
+    char *j_eventEntries = NULL;
+    char *rbuf = NULL;
+    char **smdp_list = NULL;
+    const char *okey[] = {"eventEntries", NULL};
+    const char oobj[] = {1};
+    void **optr[] = {(void **)&j_eventEntries, NULL};
+    int result = -1;
+
+    es9p_trans_account_info(ctx, request->server_address, &response->info);
+
+    // the response body is not terminated, take it over with room for the terminator
+    if (response->result >= 0 && (rbuf = realloc(response->rx, response->rx_len + 1)) != NULL) {
+        rbuf[response->rx_len] = '\0';
+    } else {
+        free(response->rx);
+    }
+    response->rx = NULL;
+
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [RX] rcode: %d, data: %s\n", response->rcode, rbuf ? rbuf : "");
+    }
+
+    strncpy(ctx->http.status.reasonCode, "0.0.0", sizeof(ctx->http.status.reasonCode));
+    strncpy(ctx->http.status.subjectCode, "0.0.0", sizeof(ctx->http.status.subjectCode));
+    strncpy(ctx->http.status.subjectIdentifier, "unknown", sizeof(ctx->http.status.subjectIdentifier));
+    if (response->result < 0 || rbuf == NULL) {
+        strncpy(ctx->http.status.message, "HTTP transport failed", sizeof(ctx->http.status.message));
+    } else if (es9p_json_response(ctx, response->rcode, rbuf, &rbuf, okey, oobj, optr) == 0) {
+        result = es11_smdp_list_parse(&smdp_list, j_eventEntries);
+    }
+    free(j_eventEntries);
+    free(rbuf);
+
+    request->callback(ctx, result, smdp_list, request->userdata);
+
+    free(request->server_address);
+    free(request);
+}
+
+int es11_authenticate_client_async_r(struct euicc_ctx *ctx, const char *server_address, const char *transaction_id,
+                                     const char *b64_authenticate_server_response,
+                                     void (*callback)(struct euicc_ctx *ctx, int result, char **smdp_list,
+                                                      void *userdata),
+                                     void *userdata) {
+    int fret = 0;
+    const char *ikey[] = {"transactionId", "authenticateServerResponse", NULL};
+    const char *idata[] = {transaction_id, b64_authenticate_server_response, NULL};
+    const char *api = "/gsma/rsp2/es9plus/authenticateClient";
+    struct es11_async_authenticate_client *request = NULL;
+    char *full_url = NULL;
+    char *sbuf = NULL;
+
+    if (!ctx->http.interface || !ctx->http.interface->async_submit) {
+        goto err;
+    }
+
+    if (!(sbuf = es9p_json_request(ikey, idata))) {
+        goto err;
+    }
+
+    full_url = es9p_url(server_address, api);
+    if (full_url == NULL) {
+        goto err;
+    }
+
+    request = calloc(1, sizeof(*request));
+    if (request == NULL || (request->server_address = strdup(server_address)) == NULL) {
+        goto err;
+    }
+    request->callback = callback;
+    request->userdata = userdata;
+
+    if (getenv("LIBEUICC_DEBUG_HTTP")) {
+        fprintf(stderr, "[DEBUG] [HTTP] [TX] url: %s, data: %s\n", full_url, sbuf);
+    }
+    if (ctx->http.interface->async_submit(ctx, full_url, (const uint8_t *)sbuf, strlen(sbuf), lpa_header,
+                                          es11_authenticate_client_async_done, request)
+        < 0) {
+        goto err;
+    }
+    request = NULL;
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+    if (request) {
+        free(request->server_address);
+        free(request);
+    }
+exit:
+    free(full_url);
+    free(sbuf);
+    return fret;
+}
+
 void es11_smdp_list_free_all(char **smdp_list) {
     if (smdp_list) {
         for (int i = 0; smdp_list[i] != NULL; i++) {
@@ -4,6 +4,7 @@
 #include "euicc.h"
 
 #include <inttypes.h>
+#include <stdio.h>
 
 int es9p_initiate_authentication_r(struct euicc_ctx *ctx, char **transaction_id,
                                    struct es10b_authenticate_server_param *resp, const char *server_address,
@@ -11,12 +12,20 @@ int es9p_initiate_authentication_r(struct euicc_ctx *ctx, char **transaction_id,
 int es9p_get_bound_profile_package_r(struct euicc_ctx *ctx, char **b64_bound_profile_package,
                                      const char *server_address, const char *transaction_id,
                                      const char *b64_prepare_download_response);
+int es9p_get_bound_profile_package_stream_r(struct euicc_ctx *ctx, FILE *bpp, uint32_t memory_limit,
+                                            uint32_t *memory_peak, const char *server_address,
+                                            const char *transaction_id, const char *b64_prepare_download_response);
 int es9p_authenticate_client_r(struct euicc_ctx *ctx, struct es10b_prepare_download_param *resp,
                                const char *server_address, const char *transaction_id,
                                const char *b64_authenticate_server_response);
 int es9p_cancel_session_r(struct euicc_ctx *ctx, const char *server_address, const char *transaction_id,
                           const char *b64_cancel_session_response);
 
+// Lets the HTTP driver set up the connection to the server while the eUICC is still busy,
+// a no-op for drivers without prewarm support
+int es9p_prewarm_r(struct euicc_ctx *ctx, const char *server_address);
+
+int es9p_prewarm(struct euicc_ctx *ctx);
 int es9p_initiate_authentication(struct euicc_ctx *ctx);
 int es9p_get_bound_profile_package(struct euicc_ctx *ctx);
 int es9p_authenticate_client(struct euicc_ctx *ctx);
@@ -25,6 +34,20 @@ int es9p_cancel_session(struct euicc_ctx *ctx);
 int es11_authenticate_client_r(struct euicc_ctx *ctx, char ***smdp_list, const char *server_address,
                                const char *transaction_id, const char *b64_authenticate_server_response);
 int es11_authenticate_client(struct euicc_ctx *ctx, char ***smdp_list);
+// Queues ES11 AuthenticateClient on the driver's async interface, callback gets the SM-DP+ addresses of
+// the event entries (freed with es11_smdp_list_free_all) once the SM-DS answered; -1 without async support
+int es11_authenticate_client_async_r(struct euicc_ctx *ctx, const char *server_address, const char *transaction_id,
+                                     const char *b64_authenticate_server_response,
+                                     void (*callback)(struct euicc_ctx *ctx, int result, char **smdp_list,
+                                                      void *userdata),
+                                     void *userdata);
 
 int es9p_handle_notification(struct euicc_ctx *ctx, const char *b64_PendingNotification);
+// Queues the notification on the driver's async interface and returns at once, callback gets 0 once
+// the server acknowledged it. Progress is made by the driver's async_dispatch/async_wait; -1 when the
+// driver has no async interface.
+int es9p_handle_notification_async_r(struct euicc_ctx *ctx, const char *server_address,
+                                     const char *b64_PendingNotification,
+                                     void (*callback)(struct euicc_ctx *ctx, int result, void *userdata),
+                                     void *userdata);
 void es11_smdp_list_free_all(char **smdp_list);
@@ -182,6 +182,16 @@ void euicc_fini(struct euicc_ctx *ctx) {
     ctx->apdu.interface->logic_channel_close(ctx, ctx->apdu._internal.logic_channel);
     ctx->apdu.interface->disconnect(ctx);
     ctx->apdu._internal.logic_channel = 0;
+
+    while (ctx->http.stats.hosts) {
+        struct euicc_http_host_stats *next = ctx->http.stats.hosts->next;
+        free(ctx->http.stats.hosts->host);
+        free(ctx->http.stats.hosts);
+        ctx->http.stats.hosts = next;
+    }
+
+    free(ctx->http.b64_euicc_info_1_cache);
+    ctx->http.b64_euicc_info_1_cache = NULL;
 }
 
 void euicc_http_cleanup(struct euicc_ctx *ctx) {
@@ -197,5 +207,8 @@ void euicc_http_cleanup(struct euicc_ctx *ctx) {
     free(ctx->http._internal.b64_prepare_download_response);
     free(ctx->http._internal.b64_bound_profile_package);
     free(ctx->http._internal.b64_cancel_session_response);
+    if (ctx->http._internal.bpp_spool) {
+        fclose(ctx->http._internal.bpp_spool);
+    }
     memset(&ctx->http._internal, 0, sizeof(ctx->http._internal));
 }
@@ -4,11 +4,28 @@
 #include "interface.h"
 
 #include <inttypes.h>
+#include <stdio.h>
 
 #ifdef interface
 #    undef interface
 #endif
 
+// Per server totals, the fields of transfer (times included) are sums over all requests
+struct euicc_http_host_stats {
+    char *host;
+    uint32_t requests;
+    struct euicc_http_transfer_info transfer;
+    struct euicc_http_host_stats *next;
+};
+
+// The most recent requests are kept one by one, so a caller polling now and then can still report each of them
+#define EUICC_HTTP_STATS_RECENT 16
+
+struct euicc_http_request_stats {
+    const char *host; // owned by the matching entry of stats.hosts, NULL if that could not be allocated
+    struct euicc_http_transfer_info transfer;
+};
+
 struct euicc_ctx {
     const uint8_t *aid;
     uint8_t aid_len;
@@ -26,6 +43,20 @@ struct euicc_ctx {
     struct {
         const struct euicc_http_interface *interface;
         const char *server_address;
+        // non-zero enables bounded-memory download: the BPP is spooled to a temporary file
+        // and loaded segment by segment, keeping at most this many bytes in memory
+        uint32_t bpp_memory_limit;
+        uint32_t bpp_memory_peak;
+        // EUICCInfo1 does not change while the context is open, it is read once and reused by every session
+        char *b64_euicc_info_1_cache;
+        // accumulated over every ES9+/ES11 request made with this context
+        struct {
+            uint32_t requests;
+            struct euicc_http_transfer_info transfer;
+            // request n (counting from 1) is recent[(n - 1) % EUICC_HTTP_STATS_RECENT]
+            struct euicc_http_request_stats recent[EUICC_HTTP_STATS_RECENT];
+            struct euicc_http_host_stats *hosts;
+        } stats;
         struct {
             char subjectCode[8 + 1];
             char reasonCode[8 + 1];
@@ -43,6 +74,7 @@ struct euicc_ctx {
             struct es10b_prepare_download_param *prepare_download_param;
             char *b64_prepare_download_response;
             char *b64_bound_profile_package;
+            FILE *bpp_spool;
             char *b64_cancel_session_response;
         } _internal;
     } http;
@@ -13,8 +13,67 @@ struct euicc_apdu_interface {
     void *userdata;
 };
 
+struct euicc_http_transfer_info {
+    uint64_t bytes_sent;          // request body
+    uint64_t bytes_received_wire; // response body as transferred, before content decoding
+    uint64_t bytes_received;      // response body after content decoding
+    // microseconds from the start of the request until each phase completed, 0 when unknown;
+    // a reused connection completes name lookup, connect and TLS immediately
+    uint64_t time_namelookup_us;
+    uint64_t time_connect_us;
+    uint64_t time_tls_us;
+    uint64_t time_first_byte_us;
+    uint64_t time_total_us;
+};
+
+// result is 0 once an HTTP status was received, -1 when the request failed before that;
+// rx is owned by the completion callback
+struct euicc_http_response {
+    int result;
+    uint32_t rcode;
+    uint8_t *rx;
+    uint32_t rx_len;
+    struct euicc_http_transfer_info info;
+};
+
+#define EUICC_HTTP_POLL_IN 0x01
+#define EUICC_HTTP_POLL_OUT 0x02
+#define EUICC_HTTP_POLL_ERR 0x04
+
+struct euicc_http_pollfd {
+    int fd;
+    uint8_t events;
+};
+
 struct euicc_http_interface {
     int (*transmit)(struct euicc_ctx *ctx, const char *url, uint32_t *rcode, uint8_t **rx, uint32_t *rx_len,
                     const uint8_t *tx, uint32_t tx_len, const char **headers);
     void *userdata;
+    // everything below was appended after userdata, which keeps its offset from the original layout
+    // optional, hands the response body to rx_callback as it arrives instead of buffering it
+    int (*transmit_stream)(struct euicc_ctx *ctx, const char *url, uint32_t *rcode,
+                           int (*rx_callback)(const uint8_t *data, uint32_t data_len, void *userdata),
+                           void *rx_userdata, const uint8_t *tx, uint32_t tx_len, const char **headers);
+    // optional, details of the last completed transmit/transmit_stream call
+    int (*transfer_info)(struct euicc_ctx *ctx, struct euicc_http_transfer_info *info);
+    // optional, starts connecting to the server of url in the background so that a later
+    // transmit to it can skip DNS, TCP and TLS setup
+    int (*prewarm)(struct euicc_ctx *ctx, const char *url);
+    // optional non-blocking interface: async_submit queues a request (tx is copied) and returns at once,
+    // callback runs from async_dispatch/async_wait, never from async_submit itself
+    int (*async_submit)(struct euicc_ctx *ctx, const char *url, const uint8_t *tx, uint32_t tx_len,
+                        const char **headers,
+                        void (*callback)(struct euicc_ctx *ctx, struct euicc_http_response *response, void *userdata),
+                        void *userdata);
+    // for an external event loop: fills at most *fds_count sockets to watch, updates *fds_count and sets
+    // *timeout_ms to the longest the loop may sleep before calling async_dispatch (-1 for no limit);
+    // returns 1 without filling fds when more than *fds_count are open, *fds_count is then the number needed
+    int (*async_fds)(struct euicc_ctx *ctx, struct euicc_http_pollfd *fds, uint32_t *fds_count, long *timeout_ms);
+    // makes progress without blocking, returns the number of requests still in flight or -1
+    int (*async_dispatch)(struct euicc_ctx *ctx);
+    // waits up to timeout_ms for socket activity, then dispatches, for callers without their own loop
+    int (*async_wait)(struct euicc_ctx *ctx, int timeout_ms);
+    // optional, async_dispatch for a loop that polled the async_fds sockets itself: only acts on the
+    // fds_count sockets found ready (events set to what happened) and on expired timers
+    int (*async_dispatch_fds)(struct euicc_ctx *ctx, const struct euicc_http_pollfd *fds, uint32_t fds_count);
 };
@@ -2,6 +2,7 @@
 
 #include "main.h"
 #include "notification/dump.h"
+#include "notification/flush.h"
 #include "notification/list.h"
 #include "notification/process.h"
 #include "notification/remove.h"
@@ -14,7 +15,7 @@
 
 static const struct applet_entry *applets[] = {
     &applet_notification_list, &applet_notification_process, &applet_notification_remove,
-    &applet_notification_dump, &applet_notification_replay,  NULL,
+    &applet_notification_dump, &applet_notification_replay,  &applet_notification_flush, NULL,
 };
 
 static int applet_main(const int argc, char **argv) {
@@ -0,0 +1,610 @@
+#include "archive.h"
+
+#include <euicc/base64.h>
+#include <euicc/hexutil.h>
+#include <lpac/utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#    include <sys/mman.h>
+#    include <unistd.h>
+#    define archive_fseek fseeko
+#else
+#    include <io.h>
+#    define archive_fseek _fseeki64
+#endif
+
+#ifndef O_BINARY
+#    define O_BINARY 0
+#endif
+
+#ifdef LPAC_WITH_ZLIB
+#    include <zlib.h>
+#endif
+
+// Layout, all integers big-endian:
+//   header   "LPACNTFA" version:u16 flags:u16 reserved:u32
+//   records  marker:u16 ("NR") length:u32, then length bytes of
+//            flags:u8 eid:16 seqNumber:u32 address_length:u16 address payload_length:u32 payload
+//            where payload is the PendingNotification DER, deflated when flags has ARCHIVE_FLAG_DEFLATE
+//   index    eid:16 seqNumber:u32 offset:u64 per record, sorted by EID and seqNumber
+//   trailer  index_offset:u64 index_count:u32 reserved:u32 "LPACNIDX"
+// Opening a writer truncates the index and trailer away, new records go where they were and the
+// index is written once, when the writer is closed. Until then, and for good if the writer dies,
+// readers rebuild the index by walking the records, the marker tells where they end.
+#define ARCHIVE_MAGIC "LPACNTFA"
+#define ARCHIVE_INDEX_MAGIC "LPACNIDX"
+#define ARCHIVE_MAGIC_SIZE 8
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_TRAILER_SIZE 24
+#define ARCHIVE_RECORD_MARKER 0x4E52
+#define ARCHIVE_RECORD_HEADER_SIZE 6
+#define ARCHIVE_RECORD_FIXED_SIZE 27
+#define ARCHIVE_EID_SIZE 16
+#define ARCHIVE_INDEX_ENTRY_SIZE 28
+#define ARCHIVE_FLAG_DEFLATE 0x01
+// far above any PendingNotification, only there to refuse absurd lengths from a damaged file
+#define ARCHIVE_PAYLOAD_MAX (1024 * 1024)
+
+struct archive_record {
+    uint8_t flags;
+    const uint8_t *eid;
+    uint32_t seqNumber;
+    const uint8_t *address;
+    uint16_t address_len;
+    uint32_t payload_len;
+    const uint8_t *payload;
+    uint32_t stored_len;
+};
+
+struct notification_archive_writer {
+    FILE *fp;
+    bool compress;
+    uint8_t *index;
+    uint32_t count;
+    uint32_t sorted_count; // entries loaded from the archive, searchable with bsearch
+    uint32_t capacity;
+    uint64_t offset;
+};
+
+static uint16_t archive_get16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+static uint32_t archive_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t archive_get64(const uint8_t *p) { return ((uint64_t)archive_get32(p) << 32) | archive_get32(p + 4); }
+
+static void archive_put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void archive_put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void archive_put64(uint8_t *p, uint64_t v) {
+    archive_put32(p, v >> 32);
+    archive_put32(p + 4, v);
+}
+
+static int archive_eid_bin(uint8_t *bin, const char *eid) {
+    return euicc_hexutil_hex2bin(bin, ARCHIVE_EID_SIZE, eid) == ARCHIVE_EID_SIZE ? 0 : -1;
+}
+
+// Offset past the record at offset, 0 when no complete record starts there
+static size_t archive_record_parse(const uint8_t *data, size_t size, size_t offset, struct archive_record *record) {
+    const uint8_t *body;
+    uint32_t length;
+
+    if (offset > size || size - offset < ARCHIVE_RECORD_HEADER_SIZE) {
+        return 0;
+    }
+    if (archive_get16(data + offset) != ARCHIVE_RECORD_MARKER) {
+        return 0;
+    }
+    length = archive_get32(data + offset + 2);
+    if (length < ARCHIVE_RECORD_FIXED_SIZE || length > size - offset - ARCHIVE_RECORD_HEADER_SIZE) {
+        return 0;
+    }
+
+    body = data + offset + ARCHIVE_RECORD_HEADER_SIZE;
+    record->flags = body[0];
+    record->eid = body + 1;
+    record->seqNumber = archive_get32(body + 17);
+    record->address_len = archive_get16(body + 21);
+    if ((record->flags & ~ARCHIVE_FLAG_DEFLATE) != 0 || (uint32_t)ARCHIVE_RECORD_FIXED_SIZE + record->address_len > length) {
+        return 0;
+    }
+    record->address = body + 23;
+    record->payload_len = archive_get32(body + 23 + record->address_len);
+    record->payload = body + ARCHIVE_RECORD_FIXED_SIZE + record->address_len;
+    record->stored_len = length - ARCHIVE_RECORD_FIXED_SIZE - record->address_len;
+    if (!(record->flags & ARCHIVE_FLAG_DEFLATE) && record->stored_len != record->payload_len) {
+        return 0;
+    }
+
+    return offset + ARCHIVE_RECORD_HEADER_SIZE + length;
+}
+
+static int archive_index_compare(const void *a, const void *b) {
+    const int ret = memcmp(a, b, ARCHIVE_EID_SIZE);
+    uint32_t seq_a, seq_b;
+
+    if (ret != 0) {
+        return ret;
+    }
+    seq_a = archive_get32((const uint8_t *)a + ARCHIVE_EID_SIZE);
+    seq_b = archive_get32((const uint8_t *)b + ARCHIVE_EID_SIZE);
+
+    return seq_a < seq_b ? -1 : seq_a > seq_b;
+}
+
+static void archive_index_entry(uint8_t *entry, const uint8_t *eid, uint32_t seqNumber, uint64_t offset) {
+    memcpy(entry, eid, ARCHIVE_EID_SIZE);
+    archive_put32(entry + ARCHIVE_EID_SIZE, seqNumber);
+    archive_put64(entry + ARCHIVE_EID_SIZE + 4, offset);
+}
+
+static int archive_load_index(struct notification_archive *archive) {
+    const uint8_t *trailer;
+    uint64_t index_offset;
+    uint32_t count;
+
+    if (archive->size < ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE) {
+        return -1;
+    }
+    trailer = archive->data + archive->size - ARCHIVE_TRAILER_SIZE;
+    if (memcmp(trailer + 16, ARCHIVE_INDEX_MAGIC, ARCHIVE_MAGIC_SIZE) != 0) {
+        return -1;
+    }
+
+    index_offset = archive_get64(trailer);
+    count = archive_get32(trailer + 8);
+    if (index_offset < ARCHIVE_HEADER_SIZE
+        || index_offset + (uint64_t)count * ARCHIVE_INDEX_ENTRY_SIZE != archive->size - ARCHIVE_TRAILER_SIZE) {
+        return -1;
+    }
+
+    archive->records_end = index_offset;
+    archive->index = archive->data + index_offset;
+    archive->count = count;
+
+    return 0;
+}
+
+static int archive_rebuild_index(struct notification_archive *archive) {
+    struct archive_record record;
+    size_t offset = ARCHIVE_HEADER_SIZE, next;
+    uint32_t capacity = 0;
+    uint8_t *index_new;
+
+    while ((next = archive_record_parse(archive->data, archive->size, offset, &record)) != 0) {
+        if (archive->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            index_new = realloc(archive->owned_index, (size_t)capacity * ARCHIVE_INDEX_ENTRY_SIZE);
+            if (index_new == NULL) {
+                return -1;
+            }
+            archive->owned_index = index_new;
+        }
+        archive_index_entry(archive->owned_index + (size_t)archive->count * ARCHIVE_INDEX_ENTRY_SIZE, record.eid,
+                            record.seqNumber, offset);
+        archive->count++;
+        offset = next;
+    }
+
+    if (archive->count > 0) {
+        qsort(archive->owned_index, archive->count, ARCHIVE_INDEX_ENTRY_SIZE, archive_index_compare);
+    }
+    archive->index = archive->owned_index;
+    archive->records_end = offset;
+
+    return 0;
+}
+
+bool notification_archive_probe(const char *path) {
+    char magic[ARCHIVE_MAGIC_SIZE];
+    FILE *fp = fopen(path, "rb");
+    bool ret;
+
+    if (fp == NULL) {
+        return false;
+    }
+    ret = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+
+    return ret;
+}
+
+int notification_archive_open(const char *path, struct notification_archive *archive) {
+    struct stat st;
+    int fd;
+
+    memset(archive, 0, sizeof(*archive));
+
+    fd = open(path, O_RDONLY | O_BINARY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < ARCHIVE_HEADER_SIZE || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return -1;
+    }
+    archive->size = st.st_size;
+
+#ifndef _WIN32
+    // only the records that are replayed get paged in
+    archive->data = mmap(NULL, archive->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (archive->data == MAP_FAILED) {
+        archive->data = NULL;
+        return -1;
+    }
+#else
+    archive->owned_data = malloc(archive->size);
+    if (archive->owned_data == NULL || _read(fd, archive->owned_data, archive->size) != (int)archive->size) {
+        close(fd);
+        goto err;
+    }
+    close(fd);
+    archive->data = archive->owned_data;
+#endif
+
+    if (memcmp(archive->data, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) != 0
+        || archive_get16(archive->data + ARCHIVE_MAGIC_SIZE) != ARCHIVE_VERSION) {
+        goto err;
+    }
+
+    if (archive_load_index(archive) < 0 && archive_rebuild_index(archive) < 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    notification_archive_close(archive);
+    return -1;
+}
+
+void notification_archive_close(struct notification_archive *archive) {
+#ifndef _WIN32
+    if (archive->data != NULL) {
+        munmap((void *)archive->data, archive->size);
+    }
+#endif
+    free(archive->owned_data);
+    free(archive->owned_index);
+    memset(archive, 0, sizeof(*archive));
+}
+
+static uint32_t archive_lower_bound(const struct notification_archive *archive, const uint8_t *eid, bool upper) {
+    uint32_t lo = 0, hi = archive->count;
+
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        const int ret = memcmp(archive->index + (size_t)mid * ARCHIVE_INDEX_ENTRY_SIZE, eid, ARCHIVE_EID_SIZE);
+        if (ret < 0 || (upper && ret == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+int notification_archive_find(const struct notification_archive *archive, const char *eid, uint32_t *first,
+                              uint32_t *count) {
+    uint8_t eid_bin[ARCHIVE_EID_SIZE];
+
+    if (archive_eid_bin(eid_bin, eid) < 0) {
+        return -1;
+    }
+
+    *first = archive_lower_bound(archive, eid_bin, false);
+    *count = archive_lower_bound(archive, eid_bin, true) - *first;
+
+    return 0;
+}
+
+int notification_archive_read(const struct notification_archive *archive, const uint32_t position,
+                              uint32_t *seqNumber, struct es10b_pending_notification *notification) {
+    struct archive_record record;
+    const uint8_t *entry;
+    uint64_t offset;
+    const uint8_t *payload;
+    _cleanup_free_ uint8_t *inflated = NULL;
+
+    memset(notification, 0, sizeof(*notification));
+
+    if (position >= archive->count) {
+        return -1;
+    }
+    entry = archive->index + (size_t)position * ARCHIVE_INDEX_ENTRY_SIZE;
+    offset = archive_get64(entry + ARCHIVE_EID_SIZE + 4);
+    if (offset >= archive->records_end
+        || archive_record_parse(archive->data, archive->records_end, offset, &record) == 0) {
+        return -1;
+    }
+
+    // a stored payload is bounded by the record, an inflated one only by this
+    if (record.payload_len > ARCHIVE_PAYLOAD_MAX) {
+        return -1;
+    }
+
+    payload = record.payload;
+    if (record.flags & ARCHIVE_FLAG_DEFLATE) {
+#ifdef LPAC_WITH_ZLIB
+        uLongf inflated_len = record.payload_len;
+
+        inflated = malloc((size_t)record.payload_len + 1);
+        if (inflated == NULL
+            || uncompress(inflated, &inflated_len, record.payload, record.stored_len) != Z_OK
+            || inflated_len != record.payload_len) {
+            return -1;
+        }
+        payload = inflated;
+#else
+        fprintf(stderr, "notification archive is compressed, but lpac was built without zlib\n");
+        return -1;
+#endif
+    }
+
+    notification->notificationAddress = malloc((size_t)record.address_len + 1);
+    notification->b64_PendingNotification = malloc(euicc_base64_encode_len((int)record.payload_len));
+    if (notification->notificationAddress == NULL || notification->b64_PendingNotification == NULL) {
+        goto err;
+    }
+    memcpy(notification->notificationAddress, record.address, record.address_len);
+    notification->notificationAddress[record.address_len] = '\0';
+    if (euicc_base64_encode(notification->b64_PendingNotification, payload, record.payload_len) < 0) {
+        goto err;
+    }
+
+    *seqNumber = record.seqNumber;
+
+    return 0;
+
+err:
+    es10b_pending_notification_free(notification);
+    return -1;
+}
+
+static int archive_truncate(FILE *fp, uint64_t size) {
+#ifndef _WIN32
+    return ftruncate(fileno(fp), size);
+#else
+    return _chsize_s(_fileno(fp), size);
+#endif
+}
+
+struct notification_archive_writer *notification_archive_writer_open(const char *path, const bool compress) {
+    struct notification_archive_writer *writer;
+    struct notification_archive archive;
+    uint8_t header[ARCHIVE_HEADER_SIZE] = {0};
+    FILE *fp;
+    long size = 0;
+
+#ifndef LPAC_WITH_ZLIB
+    if (compress) {
+        fprintf(stderr, "lpac was built without zlib, notification archives cannot be compressed\n");
+        return NULL;
+    }
+#endif
+
+    writer = calloc(1, sizeof(*writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->compress = compress;
+
+    if ((fp = fopen(path, "rb")) != NULL) {
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fclose(fp);
+    }
+
+    if (size > 0) {
+        // an existing archive keeps its records, anything else is not overwritten
+        if (!notification_archive_probe(path) || notification_archive_open(path, &archive) < 0) {
+            fprintf(stderr, "%s is not a notification archive\n", path);
+            goto err;
+        }
+        writer->capacity = writer->count = writer->sorted_count = archive.count;
+        writer->offset = archive.records_end;
+        if (archive.count > 0) {
+            writer->index = malloc((size_t)archive.count * ARCHIVE_INDEX_ENTRY_SIZE);
+            if (writer->index == NULL) {
+                notification_archive_close(&archive);
+                goto err;
+            }
+            memcpy(writer->index, archive.index, (size_t)archive.count * ARCHIVE_INDEX_ENTRY_SIZE);
+        }
+        notification_archive_close(&archive);
+
+        writer->fp = fopen(path, "r+b");
+        if (writer->fp == NULL || archive_truncate(writer->fp, writer->offset) != 0
+            || archive_fseek(writer->fp, writer->offset, SEEK_SET) != 0) {
+            goto err;
+        }
+    } else {
+        writer->fp = fopen(path, "w+b");
+        if (writer->fp == NULL) {
+            goto err;
+        }
+        memcpy(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE);
+        archive_put16(header + ARCHIVE_MAGIC_SIZE, ARCHIVE_VERSION);
+        if (fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header)) {
+            goto err;
+        }
+        writer->offset = ARCHIVE_HEADER_SIZE;
+    }
+
+    return writer;
+
+err:
+    if (writer->fp) {
+        fclose(writer->fp);
+    }
+    free(writer->index);
+    free(writer);
+    return NULL;
+}
+
+static bool archive_writer_contains(const struct notification_archive_writer *writer, const uint8_t *key) {
+    if (writer->sorted_count > 0
+        && bsearch(key, writer->index, writer->sorted_count, ARCHIVE_INDEX_ENTRY_SIZE, archive_index_compare)
+               != NULL) {
+        return true;
+    }
+    for (uint32_t i = writer->sorted_count; i < writer->count; i++) {
+        if (archive_index_compare(key, writer->index + (size_t)i * ARCHIVE_INDEX_ENTRY_SIZE) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int notification_archive_append(struct notification_archive_writer *writer, const char *eid,
+                                const uint32_t seqNumber, const struct es10b_pending_notification *notification) {
+    uint8_t eid_bin[ARCHIVE_EID_SIZE];
+    uint8_t key[ARCHIVE_INDEX_ENTRY_SIZE];
+    uint8_t fixed[ARCHIVE_RECORD_HEADER_SIZE + 23];
+    uint8_t payload_len_buf[4];
+    _cleanup_free_ uint8_t *payload = NULL;
+    _cleanup_free_ uint8_t *deflated = NULL;
+    const uint8_t *stored;
+    uint32_t stored_len;
+    const char *address = notification->notificationAddress ? notification->notificationAddress : "";
+    size_t address_len;
+    int payload_len;
+    uint8_t flags = 0;
+    uint8_t *index_new;
+
+    if (archive_eid_bin(eid_bin, eid) < 0) {
+        return -1;
+    }
+    archive_index_entry(key, eid_bin, seqNumber, 0);
+    if (archive_writer_contains(writer, key)) {
+        return 0;
+    }
+
+    while (*address == ' ' || *address == '\t' || *address == '\r' || *address == '\n') {
+        address++;
+    }
+    address_len = strlen(address);
+    while (address_len > 0 && strchr(" \t\r\n", address[address_len - 1]) != NULL) {
+        address_len--;
+    }
+    if (address_len > UINT16_MAX) {
+        return -1;
+    }
+
+    payload = malloc(euicc_base64_decode_len(notification->b64_PendingNotification));
+    if (payload == NULL) {
+        return -1;
+    }
+    payload_len = euicc_base64_decode(payload, notification->b64_PendingNotification);
+    if (payload_len < 0 || payload_len > ARCHIVE_PAYLOAD_MAX) {
+        return -1;
+    }
+    stored = payload;
+    stored_len = payload_len;
+
+#ifdef LPAC_WITH_ZLIB
+    if (writer->compress) {
+        uLongf deflated_len = compressBound(payload_len);
+
+        deflated = malloc(deflated_len);
+        if (deflated == NULL) {
+            return -1;
+        }
+        // signatures barely compress, keep whichever is smaller
+        if (compress2(deflated, &deflated_len, payload, payload_len, Z_BEST_COMPRESSION) == Z_OK
+            && deflated_len < (uLongf)payload_len) {
+            stored = deflated;
+            stored_len = deflated_len;
+            flags |= ARCHIVE_FLAG_DEFLATE;
+        }
+    }
+#endif
+
+    archive_put16(fixed, ARCHIVE_RECORD_MARKER);
+    archive_put32(fixed + 2, ARCHIVE_RECORD_FIXED_SIZE + address_len + stored_len);
+    fixed[ARCHIVE_RECORD_HEADER_SIZE] = flags;
+    memcpy(fixed + ARCHIVE_RECORD_HEADER_SIZE + 1, eid_bin, ARCHIVE_EID_SIZE);
+    archive_put32(fixed + ARCHIVE_RECORD_HEADER_SIZE + 17, seqNumber);
+    archive_put16(fixed + ARCHIVE_RECORD_HEADER_SIZE + 21, address_len);
+    archive_put32(payload_len_buf, payload_len);
+
+    if (fwrite(fixed, 1, sizeof(fixed), writer->fp) != sizeof(fixed)
+        || fwrite(address, 1, address_len, writer->fp) != address_len
+        || fwrite(payload_len_buf, 1, sizeof(payload_len_buf), writer->fp) != sizeof(payload_len_buf)
+        || fwrite(stored, 1, stored_len, writer->fp) != stored_len) {
+        return -1;
+    }
+
+    if (writer->count == writer->capacity) {
+        const uint32_t capacity = writer->capacity ? writer->capacity * 2 : 64;
+        index_new = realloc(writer->index, (size_t)capacity * ARCHIVE_INDEX_ENTRY_SIZE);
+        if (index_new == NULL) {
+            return -1;
+        }
+        writer->index = index_new;
+        writer->capacity = capacity;
+    }
+    archive_index_entry(writer->index + (size_t)writer->count * ARCHIVE_INDEX_ENTRY_SIZE, eid_bin, seqNumber,
+                        writer->offset);
+    writer->count++;
+    writer->offset += ARCHIVE_RECORD_HEADER_SIZE + ARCHIVE_RECORD_FIXED_SIZE + address_len + stored_len;
+
+    return 1;
+}
+
+int notification_archive_writer_close(struct notification_archive_writer *writer) {
+    uint8_t trailer[ARCHIVE_TRAILER_SIZE] = {0};
+    int fret = 0;
+
+    if (writer->count > 0) {
+        qsort(writer->index, writer->count, ARCHIVE_INDEX_ENTRY_SIZE, archive_index_compare);
+    }
+
+    archive_put64(trailer, writer->offset);
+    archive_put32(trailer + 8, writer->count);
+    memcpy(trailer + 16, ARCHIVE_INDEX_MAGIC, ARCHIVE_MAGIC_SIZE);
+
+    // drops whatever a failed append left behind the last complete record
+    if (archive_fseek(writer->fp, writer->offset, SEEK_SET) != 0 || archive_truncate(writer->fp, writer->offset) != 0) {
+        fret = -1;
+    } else if ((writer->count > 0
+                && fwrite(writer->index, ARCHIVE_INDEX_ENTRY_SIZE, writer->count, writer->fp) != writer->count)
+               || fwrite(trailer, 1, sizeof(trailer), writer->fp) != sizeof(trailer) || fflush(writer->fp) != 0) {
+        fret = -1;
+    }
+#ifndef _WIN32
+    if (fret == 0 && fsync(fileno(writer->fp)) != 0) {
+        fret = -1;
+    }
+#endif
+
+    if (fclose(writer->fp) != 0) {
+        fret = -1;
+    }
+    free(writer->index);
+    free(writer);
+
+    return fret;
+}
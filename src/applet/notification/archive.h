@@ -0,0 +1,47 @@
+#pragma once
+
+#include <euicc/es10b.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A read-only view of a notification archive: mapped from disk where possible, with an index
+// sorted by EID and seqNumber either stored in the file or rebuilt from the records.
+struct notification_archive {
+    const uint8_t *data;
+    size_t size;
+    size_t records_end;
+    const uint8_t *index;
+    uint32_t count;
+    uint8_t *owned_index; // index rebuilt by scanning an archive without a valid one
+    uint8_t *owned_data;  // file contents read into memory where mmap is unavailable
+};
+
+struct notification_archive_writer;
+
+// True when the file starts with the archive magic, so callers can fall back to JSON lines
+bool notification_archive_probe(const char *path);
+
+int notification_archive_open(const char *path, struct notification_archive *archive);
+
+void notification_archive_close(struct notification_archive *archive);
+
+// Range [*first, *first + *count) of index positions holding the records of one EID
+int notification_archive_find(const struct notification_archive *archive, const char *eid, uint32_t *first,
+                              uint32_t *count);
+
+// Decodes the record at an index position, the notification strings are allocated
+int notification_archive_read(const struct notification_archive *archive, uint32_t position, uint32_t *seqNumber,
+                              struct es10b_pending_notification *notification);
+
+// Opens an archive for appending, creating it when missing. Records already in the archive are
+// skipped by notification_archive_append, so archiving the same eUICC twice does not duplicate them.
+struct notification_archive_writer *notification_archive_writer_open(const char *path, bool compress);
+
+// Returns 1 when the record was written, 0 when the archive already had it
+int notification_archive_append(struct notification_archive_writer *writer, const char *eid, uint32_t seqNumber,
+                                const struct es10b_pending_notification *notification);
+
+// Writes the index, syncs the file and frees the writer
+int notification_archive_writer_close(struct notification_archive_writer *writer);
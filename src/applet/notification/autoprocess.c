@@ -0,0 +1,180 @@
+#include "autoprocess.h"
+#include "notification_common.h"
+
+#include <euicc/es10b.h>
+#include <euicc/es9p.h>
+#include <lpac/utils.h>
+
+#include <main.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENV_NOTIFICATION_AUTOPROCESS "LPAC_NOTIFICATION_AUTOPROCESS"
+
+static struct {
+    bool active;
+    long long last_seqNumber; // -1 when nothing was pending before the operation
+    struct notification_pending *pending;
+    struct notification_delivery *items;
+    int count;
+    int inflight;
+} autoprocess;
+
+void notification_autoprocess_begin(void) {
+    struct es10b_notification_metadata_list *notifications, *rptr;
+
+    if (!getenv_or_default(ENV_NOTIFICATION_AUTOPROCESS, (bool)false)) {
+        return;
+    }
+
+    // without the list the new Notifications cannot be told apart, so they are left on the eUICC
+    jprint_progress("es10b_list_notification", NULL);
+    if (es10b_list_notification(&euicc_ctx, &notifications)) {
+        return;
+    }
+
+    autoprocess.last_seqNumber = -1;
+    for (rptr = notifications; rptr; rptr = rptr->next) {
+        if ((long long)rptr->seqNumber > autoprocess.last_seqNumber) {
+            autoprocess.last_seqNumber = rptr->seqNumber;
+        }
+    }
+    es10b_notification_metadata_list_free_all(notifications);
+
+    autoprocess.active = true;
+}
+
+static void notification_autoprocess_delivered(__attribute__((unused)) struct euicc_ctx *ctx, int result,
+                                               void *userdata) {
+    struct notification_delivery *item = userdata;
+
+    item->state = result == 0 ? NOTIFICATION_DELIVERED : NOTIFICATION_FAILED;
+    autoprocess.inflight--;
+}
+
+static void notification_autoprocess_reset(void) {
+    free(autoprocess.items);
+    notification_pending_free_all(autoprocess.pending, autoprocess.count);
+    memset(&autoprocess, 0, sizeof(autoprocess));
+}
+
+static void notification_autoprocess_submit(void) {
+    struct notification_pending *pending = NULL;
+    char str_seqNumber[11];
+    int count = 0;
+    int n = 0;
+
+    if (!autoprocess.active) {
+        return;
+    }
+
+    jprint_progress("es10b_retrieve_notifications_list", NULL);
+    if (notification_retrieve_all(&pending, &count)) {
+        notification_autoprocess_reset();
+        return;
+    }
+
+    // keep only the Notifications created by the operation
+    for (int i = 0; i < count; i++) {
+        if ((long long)pending[i].seqNumber > autoprocess.last_seqNumber) {
+            pending[n++] = pending[i];
+        } else {
+            es10b_pending_notification_free(&pending[i].notification);
+        }
+    }
+    autoprocess.pending = pending;
+    autoprocess.count = n;
+
+    autoprocess.items = calloc(n ? n : 1, sizeof(*autoprocess.items));
+    if (autoprocess.items == NULL) {
+        notification_autoprocess_reset();
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        autoprocess.items[i].seqNumber = pending[i].seqNumber;
+        autoprocess.items[i].host = notification_strstrip(pending[i].notification.notificationAddress);
+        autoprocess.items[i].b64_PendingNotification = pending[i].notification.b64_PendingNotification;
+    }
+
+    if (euicc_ctx.http.interface->async_submit == NULL) {
+        // delivered one at a time by notification_autoprocess_end
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        struct notification_delivery *item = &autoprocess.items[i];
+
+        snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", item->seqNumber);
+        jprint_progress("es9p_handle_notification", str_seqNumber);
+        if (es9p_handle_notification_async_r(&euicc_ctx, item->host, item->b64_PendingNotification,
+                                             notification_autoprocess_delivered, item)
+            < 0) {
+            item->state = NOTIFICATION_FAILED;
+            continue;
+        }
+        item->state = NOTIFICATION_INFLIGHT;
+        autoprocess.inflight++;
+    }
+}
+
+void notification_autoprocess_end(void) {
+    _cleanup_free_ unsigned long *seqNumbers = NULL;
+    _cleanup_free_ int *results = NULL;
+    cJSON *jdata = NULL;
+    cJSON *jdelivered = NULL;
+    cJSON *jremoved = NULL;
+    cJSON *jfailed = NULL;
+    int delivered = 0;
+
+    if (!autoprocess.active) {
+        return;
+    }
+
+    notification_autoprocess_submit();
+    if (!autoprocess.active) {
+        return;
+    }
+
+    if (euicc_ctx.http.interface->async_submit == NULL) {
+        notification_deliver(autoprocess.items, autoprocess.count, 1, 1);
+    }
+    while (autoprocess.inflight > 0 && euicc_ctx.http.interface->async_wait(&euicc_ctx, 1000) >= 0) {
+    }
+
+    seqNumbers = calloc(autoprocess.count ? autoprocess.count : 1, sizeof(*seqNumbers));
+    results = calloc(autoprocess.count ? autoprocess.count : 1, sizeof(*results));
+    jdata = cJSON_CreateObject();
+    jdelivered = cJSON_AddArrayToObject(jdata, "delivered");
+    jremoved = cJSON_AddArrayToObject(jdata, "removed");
+    jfailed = cJSON_AddArrayToObject(jdata, "failed");
+    if (seqNumbers == NULL || results == NULL || jdelivered == NULL || jremoved == NULL || jfailed == NULL) {
+        cJSON_Delete(jdata);
+        notification_autoprocess_reset();
+        return;
+    }
+
+    for (int i = 0; i < autoprocess.count; i++) {
+        const struct notification_delivery *item = &autoprocess.items[i];
+
+        if (item->state != NOTIFICATION_DELIVERED) {
+            cJSON_AddItemToArray(jfailed, cJSON_CreateNumber(item->seqNumber));
+            continue;
+        }
+        cJSON_AddItemToArray(jdelivered, cJSON_CreateNumber(item->seqNumber));
+        seqNumbers[delivered++] = item->seqNumber;
+    }
+
+    if (delivered > 0) {
+        es10b_remove_notifications_from_list(&euicc_ctx, seqNumbers, delivered, results);
+        for (int i = 0; i < delivered; i++) {
+            if (results[i] == 0) {
+                cJSON_AddItemToArray(jremoved, cJSON_CreateNumber(seqNumbers[i]));
+            }
+        }
+    }
+
+    jprint_progress_obj("notification_autoprocess", jdata);
+
+    notification_autoprocess_reset();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// With LPAC_NOTIFICATION_AUTOPROCESS set, profile operations deliver the Notifications they create
+// themselves instead of leaving them for another lpac run.
+
+// Runs before the operation: notes the highest pending seqNumber, so the new Notifications can be told apart
+void notification_autoprocess_begin(void);
+
+// Runs after the operation, also when it failed: reads the new Notifications off the eUICC, delivers them
+// (concurrently over the HTTP driver's async interface when it has one), removes the acknowledged ones and
+// reports the outcome as one progress event. Failed ones stay on the eUICC, so a failure does not fail the
+// operation.
+void notification_autoprocess_end(void);
@@ -1,3 +1,4 @@
+#include "archive.h"
 #include "notification_common.h"
 #include "process.h"
 
@@ -12,7 +13,31 @@
 #include <string.h>
 #include <unistd.h>
 
-static bool retrieve_notification(const char *eid, const uint32_t seqNumber) {
+struct dump_output {
+    const char *eid;
+    struct notification_archive_writer *archive; // JSON lines on stdout when NULL
+    int archived;
+};
+
+static bool dump_notification(struct dump_output *output, const uint32_t seqNumber,
+                              const struct es10b_pending_notification *notification) {
+    if (output->archive != NULL) {
+        const int written = notification_archive_append(output->archive, output->eid, seqNumber, notification);
+        if (written < 0) {
+            jprint_error("notification_archive_append", NULL);
+            return false;
+        }
+        // records the archive already had are not counted
+        output->archived += written;
+        return true;
+    }
+
+    write_notification(output->eid, seqNumber, notification);
+
+    return json_writer_line_end();
+}
+
+static bool retrieve_notification(struct dump_output *output, const uint32_t seqNumber) {
     _cleanup_(es10b_pending_notification_free) struct es10b_pending_notification notification;
 
     if (es10b_retrieve_notifications_list(&euicc_ctx, &notification, seqNumber)) {
@@ -20,34 +45,42 @@ static bool retrieve_notification(const char *eid, const uint32_t seqNumber) {
         return false;
     }
 
-    _cleanup_cjson_ cJSON *jroot = build_notification(eid, seqNumber, &notification);
-    if (jroot == NULL)
-        return false;
-
-    _cleanup_free_ char *jstr = cJSON_PrintUnformatted(jroot);
-    printf("%s\n", jstr);
-    fflush(stdout);
+    return dump_notification(output, seqNumber, &notification);
+}
 
-    return true;
+static int dump_notification_callback(const unsigned long seqNumber,
+                                      struct es10b_pending_notification *PendingNotification, void *userdata) {
+    return dump_notification(userdata, seqNumber, PendingNotification) ? 0 : -1;
 }
 
 static int applet_main(const int argc, char **argv) {
-    static const char *opt_string = "ah?";
+    static const char *opt_string = "ao:zh?";
 
     int fret = 0;
     int all = 0;
+    int compress = 0;
+    const char *archive_path = NULL;
     int opt = 0;
     char *eid = NULL;
+    struct dump_output output = {0};
 
     while ((opt = getopt(argc, argv, opt_string)) != -1) {
         switch (opt) {
         case 'a':
             all = 1;
             break;
+        case 'o':
+            archive_path = optarg;
+            break;
+        case 'z':
+            compress = 1;
+            break;
         case 'h':
         case '?':
             printf("Usage: %s [OPTIONS] [seqNumber_0] [seqNumber_1]...\n", argv[0]);
             printf("\t -a All notifications\n");
+            printf("\t -o Append to a binary notification archive instead of printing JSON lines\n");
+            printf("\t -z With -o, compress the records (needs lpac built with zlib)\n");
             return -1;
         default:
             break;
@@ -58,24 +91,22 @@ static int applet_main(const int argc, char **argv) {
         jprint_error("es10c_get_eid", NULL);
         return -1;
     }
+    output.eid = eid;
 
-    if (all) {
-        _cleanup_es10b_notification_metadata_list_ struct es10b_notification_metadata_list *notifications, *rptr;
-
-        if (es10b_list_notification(&euicc_ctx, &notifications)) {
-            jprint_error("es10b_list_notification", NULL);
+    if (archive_path != NULL) {
+        output.archive = notification_archive_writer_open(archive_path, compress);
+        if (output.archive == NULL) {
+            jprint_error("notification_archive_writer_open", archive_path);
             return -1;
         }
+    }
 
-        rptr = notifications;
-        while (rptr) {
-            if (!retrieve_notification(eid, rptr->seqNumber)) {
-                fret = -1;
-                break;
-            }
-            rptr = rptr->next;
+    if (all) {
+        // written as the single response is decoded, one command for all of them
+        if (es10b_retrieve_notifications_list_all(&euicc_ctx, dump_notification_callback, &output)) {
+            jprint_error("es10b_retrieve_notifications_list", NULL);
+            fret = -1;
         }
-
     } else {
         for (int i = optind; i < argc; i++) {
             errno = 0;
@@ -87,13 +118,26 @@ static int applet_main(const int argc, char **argv) {
             if ((seqNumber == 0 && strcmp(argv[i], str_end)) || errno != 0) {
                 continue;
             }
-            if (!retrieve_notification(eid, seqNumber)) {
+            if (!retrieve_notification(&output, seqNumber)) {
                 fret = -1;
                 break;
             }
         }
     }
 
+    if (output.archive != NULL) {
+        // the records appended before a failure are indexed as well
+        if (notification_archive_writer_close(output.archive) < 0 && fret == 0) {
+            jprint_error("notification_archive_writer_close", archive_path);
+            fret = -1;
+        }
+        if (fret == 0) {
+            cJSON *jdata = cJSON_CreateObject();
+            cJSON_AddNumberToObject(jdata, "archived", output.archived);
+            jprint_success(jdata);
+        }
+    }
+
     return fret;
 }
 
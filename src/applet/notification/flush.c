@@ -0,0 +1,95 @@
+#include "flush.h"
+#include "notification_common.h"
+#include "spool.h"
+
+#include <lpac/utils.h>
+
+#include <main.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FLUSH_WORKERS_DEFAULT 4
+
+static int applet_main(int argc, char **argv) {
+    static const char *opt_string = "cfp:P:h?";
+
+    struct notification_spool_result result;
+    int capture = 0;
+    int force = 0;
+    int workers = FLUSH_WORKERS_DEFAULT;
+    int per_host = NOTIFICATION_PER_HOST_DEFAULT;
+    int captured = 0;
+    int opt = 0;
+    cJSON *jdata = NULL;
+
+    while ((opt = getopt(argc, argv, opt_string)) != -1) {
+        switch (opt) {
+        case 'c':
+            capture = 1;
+            break;
+        case 'f':
+            force = 1;
+            break;
+        case 'p':
+            workers = atoi(optarg);
+            if (workers < 1) {
+                printf("Number of parallel deliveries must be at least 1\n");
+                return -1;
+            }
+            break;
+        case 'P':
+            per_host = atoi(optarg);
+            if (per_host < 1) {
+                printf("Number of parallel deliveries per server must be at least 1\n");
+                return -1;
+            }
+            break;
+        case 'h':
+        case '?':
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("\t -c Move the notifications on the eUICC into the spool first\n");
+            printf("\t -f Retry failed notifications now instead of waiting for their backoff\n");
+            printf("\t -p Deliver up to N notifications in parallel (default: %d)\n", FLUSH_WORKERS_DEFAULT);
+            printf("\t -P At most N parallel deliveries to the same server (default: %d)\n",
+                   NOTIFICATION_PER_HOST_DEFAULT);
+            return -1;
+        default:
+            break;
+        }
+    }
+
+    if (notification_spool_path() == NULL) {
+        jprint_error("notification_spool_flush", "LPAC_NOTIFICATION_SPOOL is not set");
+        return -1;
+    }
+
+    if (capture) {
+        jprint_progress("notification_spool_capture", NULL);
+        if ((captured = notification_spool_capture()) < 0) {
+            jprint_error("notification_spool_capture", NULL);
+            return -1;
+        }
+    }
+
+    jprint_progress("notification_spool_flush", NULL);
+    if (notification_spool_flush(force, workers, per_host, &result) < 0) {
+        jprint_error("notification_spool_flush", NULL);
+        return -1;
+    }
+
+    jdata = cJSON_CreateObject();
+    cJSON_AddNumberToObject(jdata, "captured", captured);
+    cJSON_AddNumberToObject(jdata, "delivered", result.delivered);
+    cJSON_AddNumberToObject(jdata, "failed", result.failed);
+    cJSON_AddNumberToObject(jdata, "pending", result.pending);
+    jprint_success(jdata);
+
+    return 0;
+}
+
+struct applet_entry applet_notification_flush = {
+    .name = "flush",
+    .main = applet_main,
+};
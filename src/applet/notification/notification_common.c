@@ -1,6 +1,12 @@
 #include "notification_common.h"
 
+#include <euicc/es9p.h>
+#include <lpac/utils.h>
+
 #include <ctype.h>
+#include <main.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 char *notification_strstrip(char *input) {
@@ -26,17 +32,140 @@ char *notification_strstrip(char *input) {
     return input;
 }
 
-cJSON *build_notification(const char *eid, const uint32_t seqNumber,
-                          const struct es10b_pending_notification *notification) {
-    cJSON *jroot = cJSON_CreateObject();
-    if (jroot == NULL)
-        return jroot;
-    cJSON_AddStringToObject(jroot, "type", "notification");
-    cJSON_AddStringToObject(jroot, "eid", eid);
-    cJSON_AddNumberToObject(jroot, "seqNumber", seqNumber);
-    cJSON_AddStringToObject(jroot, "notificationAddress", notification_strstrip(notification->notificationAddress));
-    cJSON_AddStringToObject(jroot, "pendingNotification", notification->b64_PendingNotification);
-    return jroot;
+struct notification_retrieve_all_data {
+    struct notification_pending *pending;
+    int count;
+    int capacity;
+};
+
+static int notification_retrieve_all_callback(const unsigned long seqNumber,
+                                              struct es10b_pending_notification *PendingNotification,
+                                              void *userdata) {
+    struct notification_retrieve_all_data *data = userdata;
+
+    if (data->count == data->capacity) {
+        const int capacity = data->capacity ? data->capacity * 2 : 8;
+        struct notification_pending *npending = realloc(data->pending, capacity * sizeof(*npending));
+        if (npending == NULL) {
+            return -1;
+        }
+        data->pending = npending;
+        data->capacity = capacity;
+    }
+
+    data->pending[data->count].seqNumber = seqNumber;
+    data->pending[data->count].notification = *PendingNotification;
+    data->count++;
+    // now owned by the array
+    memset(PendingNotification, 0, sizeof(*PendingNotification));
+
+    return 0;
+}
+
+int notification_retrieve_all(struct notification_pending **pending, int *count) {
+    struct notification_retrieve_all_data data = {0};
+
+    *pending = NULL;
+    *count = 0;
+
+    if (es10b_retrieve_notifications_list_all(&euicc_ctx, notification_retrieve_all_callback, &data) != 0) {
+        notification_pending_free_all(data.pending, data.count);
+        return -1;
+    }
+
+    *pending = data.pending;
+    *count = data.count;
+
+    return 0;
+}
+
+void notification_pending_free_all(struct notification_pending *pending, const int count) {
+    if (pending == NULL) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        es10b_pending_notification_free(&pending[i].notification);
+    }
+    free(pending);
+}
+
+static bool notification_seq_append(char **list, size_t *len, const uint32_t seqNumber) {
+    char *nlist = realloc(*list, *len + 12);
+
+    if (nlist == NULL) {
+        return false;
+    }
+    *list = nlist;
+    *len += sprintf(*list + *len, "%s%u", *len ? "," : "", seqNumber);
+
+    return true;
+}
+
+int notification_remove_batch(const uint32_t *seqNumbers, const int count, char **reason) {
+    _cleanup_free_ unsigned long *batch = NULL;
+    _cleanup_free_ int *results = NULL;
+    _cleanup_free_ char *not_found = NULL;
+    _cleanup_free_ char *failed = NULL;
+    size_t not_found_len = 0, failed_len = 0;
+    char str_count[12];
+
+    *reason = NULL;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    batch = malloc(count * sizeof(*batch));
+    results = malloc(count * sizeof(*results));
+    if (batch == NULL || results == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        batch[i] = seqNumbers[i];
+    }
+
+    snprintf(str_count, sizeof(str_count), "%d", count);
+    jprint_progress("es10b_remove_notifications_from_list", str_count);
+    if (es10b_remove_notifications_from_list(&euicc_ctx, batch, count, results) == count) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        bool ok = true;
+        if (results[i] == 1) {
+            ok = notification_seq_append(&not_found, &not_found_len, seqNumbers[i]);
+        } else if (results[i] != 0) {
+            ok = notification_seq_append(&failed, &failed_len, seqNumbers[i]);
+        }
+        if (!ok) {
+            return -1;
+        }
+    }
+
+    *reason = malloc(not_found_len + failed_len + 64);
+    if (*reason == NULL) {
+        return -1;
+    }
+    sprintf(*reason, "%s%s%s%s%s", not_found ? "seqNumber not found: " : "", not_found ? not_found : "",
+            not_found && failed ? "; " : "", failed ? "unknown: " : "", failed ? failed : "");
+
+    return -1;
+}
+
+void write_notification(const char *eid, const uint32_t seqNumber,
+                        const struct es10b_pending_notification *notification) {
+    json_writer_object_begin();
+    json_writer_key("type");
+    json_writer_string("notification");
+    json_writer_key("eid");
+    json_writer_string(eid);
+    json_writer_key("seqNumber");
+    json_writer_number(seqNumber);
+    json_writer_key("notificationAddress");
+    json_writer_string(notification_strstrip(notification->notificationAddress));
+    json_writer_key("pendingNotification");
+    json_writer_string(notification->b64_PendingNotification);
+    json_writer_object_end();
 }
 
 bool parse_notification(const cJSON *jroot, const char *eid, uint32_t *seqNumber,
@@ -75,3 +204,93 @@ bool parse_notification(const cJSON *jroot, const char *eid, uint32_t *seqNumber
 
     return true;
 }
+
+static int notification_inflight;
+
+static void notification_delivered(__attribute__((unused)) struct euicc_ctx *ctx, int result, void *userdata) {
+    struct notification_delivery *item = userdata;
+
+    item->state = result == 0 ? NOTIFICATION_DELIVERED : NOTIFICATION_FAILED;
+    notification_inflight--;
+}
+
+static int notification_host_inflight(const struct notification_delivery *items, int count, const char *host) {
+    int n = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (items[i].state == NOTIFICATION_INFLIGHT && strcmp(items[i].host, host) == 0) {
+            n++;
+        }
+    }
+    return n;
+}
+
+int notification_deliver(struct notification_delivery *items, int count, int workers, int per_host) {
+    char str_seqNumber[11];
+    int fret = 0;
+
+    if (euicc_ctx.http.interface->async_submit == NULL) {
+        workers = 1;
+    }
+
+    if (workers <= 1) {
+        for (int i = 0; i < count; i++) {
+            if (items[i].state != NOTIFICATION_PENDING) {
+                continue;
+            }
+            snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", items[i].seqNumber);
+            jprint_progress("es9p_handle_notification", str_seqNumber);
+            euicc_ctx.http.server_address = items[i].host;
+            items[i].state = es9p_handle_notification(&euicc_ctx, items[i].b64_PendingNotification) == 0
+                                 ? NOTIFICATION_DELIVERED
+                                 : NOTIFICATION_FAILED;
+        }
+        return 0;
+    }
+
+    notification_inflight = 0;
+    for (;;) {
+        bool pending = false;
+
+        for (int i = 0; i < count; i++) {
+            if (items[i].state != NOTIFICATION_PENDING) {
+                continue;
+            }
+            if (notification_inflight >= workers
+                || notification_host_inflight(items, count, items[i].host) >= per_host) {
+                pending = true;
+                continue;
+            }
+
+            snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", items[i].seqNumber);
+            jprint_progress("es9p_handle_notification", str_seqNumber);
+            if (es9p_handle_notification_async_r(&euicc_ctx, items[i].host, items[i].b64_PendingNotification,
+                                                 notification_delivered, &items[i])
+                < 0) {
+                items[i].state = NOTIFICATION_FAILED;
+                continue;
+            }
+            items[i].state = NOTIFICATION_INFLIGHT;
+            notification_inflight++;
+        }
+
+        if (notification_inflight == 0 && !pending) {
+            break;
+        }
+        if (euicc_ctx.http.interface->async_wait(&euicc_ctx, 1000) < 0) {
+            fret = -1;
+            break;
+        }
+    }
+
+    // the callbacks of abandoned requests still point into items, let them finish first
+    while (notification_inflight > 0 && euicc_ctx.http.interface->async_wait(&euicc_ctx, 1000) >= 0) {
+    }
+    for (int i = 0; i < count; i++) {
+        if (items[i].state == NOTIFICATION_INFLIGHT) {
+            items[i].state = NOTIFICATION_FAILED;
+        }
+    }
+
+    return fret;
+}
@@ -5,9 +5,45 @@
 
 #include <stdbool.h>
 
+#define NOTIFICATION_PER_HOST_DEFAULT 4
+
+enum notification_delivery_state {
+    NOTIFICATION_PENDING,
+    NOTIFICATION_INFLIGHT,
+    NOTIFICATION_DELIVERED,
+    NOTIFICATION_FAILED,
+};
+
+struct notification_delivery {
+    uint32_t seqNumber;
+    const char *host;
+    const char *b64_PendingNotification;
+    enum notification_delivery_state state;
+};
+
+struct notification_pending {
+    uint32_t seqNumber;
+    struct es10b_pending_notification notification;
+};
+
 char *notification_strstrip(char *input);
 
-cJSON *build_notification(const char *eid, uint32_t seqNumber, const struct es10b_pending_notification *notification);
+// Reads every pending notification off the eUICC with one RetrieveNotificationsListRequest
+int notification_retrieve_all(struct notification_pending **pending, int *count);
+
+void notification_pending_free_all(struct notification_pending *pending, int count);
+
+// Removes the notifications from the eUICC in one batch with a single progress line. Every one is
+// attempted; on failure *reason lists the ones that could not be removed (NULL when out of memory),
+// for the caller to report as the error of es10b_remove_notifications_from_list.
+int notification_remove_batch(const uint32_t *seqNumbers, int count, char **reason);
+
+void write_notification(const char *eid, uint32_t seqNumber, const struct es10b_pending_notification *notification);
 
 bool parse_notification(const cJSON *jroot, const char *eid, uint32_t *seqNumber,
                         struct es10b_pending_notification *notification);
+
+// Sends every pending item with handleNotification, up to `workers` at once and at most `per_host`
+// to one server over the HTTP driver's async interface, one at a time without it. Each item ends up
+// delivered or failed; -1 only when the HTTP driver itself failed.
+int notification_deliver(struct notification_delivery *items, int count, int workers, int per_host);
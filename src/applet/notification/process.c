@@ -12,56 +12,145 @@
 #include <string.h>
 #include <unistd.h>
 
-static int _process_single(uint32_t seqNumber, uint8_t autoremove) {
-    int ret;
+// A failed delivery is only reported once the acknowledged notifications were removed, so the error
+// stays the last message of the applet. When the removal fails as well, its reason is appended.
+struct process_error {
+    const char *function_name;
+    char *detail;
+};
+
+static void process_error_set(struct process_error *error, const char *function_name, const char *detail) {
+    error->function_name = function_name;
+    free(error->detail);
+    error->detail = detail ? strdup(detail) : NULL;
+}
+
+static void process_error_append_remove(struct process_error *error, const char *reason) {
+    static const char *remove_name = "es10b_remove_notifications_from_list";
+    char *detail;
+
+    if (reason == NULL) {
+        reason = "unknown";
+    }
+    detail = malloc((error->detail ? strlen(error->detail) + 2 : 0) + strlen(remove_name) + strlen(reason) + 3);
+    if (detail == NULL) {
+        return;
+    }
+    sprintf(detail, "%s%s%s: %s", error->detail ? error->detail : "", error->detail ? "; " : "", remove_name,
+            reason);
+    free(error->detail);
+    error->detail = detail;
+}
+
+// The notification is only read from the card when `-a` did not retrieve it already
+static int _process_single(struct notification_pending *pending, struct process_error *error) {
     char str_seqNumber[11];
-    _cleanup_(es10b_pending_notification_free) struct es10b_pending_notification notification;
+    struct es10b_pending_notification *notification = &pending->notification;
 
-    snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", seqNumber);
+    snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", pending->seqNumber);
 
-    jprint_progress("es10b_retrieve_notifications_list", str_seqNumber);
-    if (es10b_retrieve_notifications_list(&euicc_ctx, &notification, seqNumber)) {
-        jprint_error("es10b_retrieve_notifications_list", NULL);
-        return -1;
+    if (notification->b64_PendingNotification == NULL) {
+        jprint_progress("es10b_retrieve_notifications_list", str_seqNumber);
+        if (es10b_retrieve_notifications_list(&euicc_ctx, notification, pending->seqNumber)) {
+            process_error_set(error, "es10b_retrieve_notifications_list", NULL);
+            return -1;
+        }
     }
 
-    euicc_ctx.http.server_address = notification_strstrip(notification.notificationAddress);
+    euicc_ctx.http.server_address = notification_strstrip(notification->notificationAddress);
 
     jprint_progress("es9p_handle_notification", str_seqNumber);
-    if (es9p_handle_notification(&euicc_ctx, notification.b64_PendingNotification)) {
-        jprint_error("es9p_handle_notification", NULL);
+    if (es9p_handle_notification(&euicc_ctx, notification->b64_PendingNotification)) {
+        process_error_set(error, "es9p_handle_notification", NULL);
         return -1;
     }
 
-    if (!autoremove) {
-        return 0;
+    return 0;
+}
+
+// Reads every notification off the card first, so the APDU channel is free while the deliveries
+// run in parallel. The seqNumbers of acknowledged notifications are collected into acked in their
+// original order; a failed delivery does not stop the others.
+static int _process_concurrent(struct notification_pending *pending, int count, int workers, int per_host,
+                               uint32_t *acked, int *acked_count, struct process_error *error) {
+    int fret = 0;
+    struct notification_delivery *items = NULL;
+    char str_seqNumber[11];
+    _cleanup_free_ char *failed = NULL;
+    size_t failed_len = 0;
+
+    items = calloc(count, sizeof(*items));
+    if (items == NULL) {
+        process_error_set(error, "calloc", NULL);
+        goto err;
     }
 
-    jprint_progress("es10b_remove_notification_from_list", str_seqNumber);
-    if ((ret = es10b_remove_notification_from_list(&euicc_ctx, seqNumber))) {
-        const char *reason;
-        switch (ret) {
-        case 1:
-            reason = "seqNumber not found";
-            break;
-        default:
-            reason = "unknown";
-            break;
+    for (int i = 0; i < count; i++) {
+        struct es10b_pending_notification *notification = &pending[i].notification;
+
+        if (notification->b64_PendingNotification == NULL) {
+            snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", pending[i].seqNumber);
+
+            jprint_progress("es10b_retrieve_notifications_list", str_seqNumber);
+            if (es10b_retrieve_notifications_list(&euicc_ctx, notification, pending[i].seqNumber)) {
+                process_error_set(error, "es10b_retrieve_notifications_list", NULL);
+                goto err;
+            }
         }
-        jprint_error("es10b_remove_notification_from_list", reason);
-        return -1;
+        items[i].seqNumber = pending[i].seqNumber;
+        items[i].host = notification_strstrip(notification->notificationAddress);
+        items[i].b64_PendingNotification = notification->b64_PendingNotification;
     }
 
-    return 0;
+    if (notification_deliver(items, count, workers, per_host) < 0) {
+        process_error_set(error, "es9p_handle_notification", "HTTP transport failed");
+        goto err;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (items[i].state != NOTIFICATION_DELIVERED) {
+            char *nfailed = realloc(failed, failed_len + sizeof(str_seqNumber) + 1);
+            if (nfailed == NULL) {
+                process_error_set(error, "realloc", NULL);
+                goto err;
+            }
+            failed = nfailed;
+            failed_len += sprintf(failed + failed_len, "%s%u", failed_len ? "," : "", items[i].seqNumber);
+            continue;
+        }
+        acked[(*acked_count)++] = items[i].seqNumber;
+    }
+
+    if (failed != NULL) {
+        process_error_set(error, "es9p_handle_notification", failed);
+        goto err;
+    }
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    free(items);
+    return fret;
 }
 
 static int applet_main(int argc, char **argv) {
-    static const char *opt_string = "arh?";
+    static const char *opt_string = "arp:P:h?";
 
     int fret = 0;
     int all = 0;
     int autoremove = 0;
+    int workers = 1;
+    int per_host = NOTIFICATION_PER_HOST_DEFAULT;
     int opt = 0;
+    struct notification_pending *pending = NULL;
+    int count = 0;
+    _cleanup_free_ uint32_t *acked = NULL;
+    int acked_count = 0;
+    struct process_error error = {0};
+    _cleanup_free_ char *remove_reason = NULL;
 
     while ((opt = getopt(argc, argv, opt_string)) != -1) {
         switch (opt) {
@@ -71,11 +160,28 @@ static int applet_main(int argc, char **argv) {
         case 'r':
             autoremove = 1;
             break;
+        case 'p':
+            workers = atoi(optarg);
+            if (workers < 1) {
+                printf("Number of parallel deliveries must be at least 1\n");
+                return -1;
+            }
+            break;
+        case 'P':
+            per_host = atoi(optarg);
+            if (per_host < 1) {
+                printf("Number of parallel deliveries per server must be at least 1\n");
+                return -1;
+            }
+            break;
         case 'h':
         case '?':
             printf("Usage: %s [OPTIONS] [seqNumber_0] [seqNumber_1]...\n", argv[0]);
             printf("\t -a All notifications\n");
             printf("\t -r Automatically remove processed notifications\n");
+            printf("\t -p Retrieve all notifications first, then deliver up to N of them in parallel\n");
+            printf("\t -P With -p, at most N parallel deliveries to the same server (default: %d)\n",
+                   NOTIFICATION_PER_HOST_DEFAULT);
             return -1;
         default:
             break;
@@ -83,23 +189,18 @@ static int applet_main(int argc, char **argv) {
     }
 
     if (all) {
-        _cleanup_es10b_notification_metadata_list_ struct es10b_notification_metadata_list *notifications, *rptr;
-
-        jprint_progress("es10b_list_notification", NULL);
-        if (es10b_list_notification(&euicc_ctx, &notifications)) {
-            jprint_error("es10b_list_notification", NULL);
+        // one command for all of them instead of a list and a retrieval per notification
+        jprint_progress("es10b_retrieve_notifications_list", NULL);
+        if (notification_retrieve_all(&pending, &count)) {
+            jprint_error("es10b_retrieve_notifications_list", NULL);
             return -1;
         }
-
-        rptr = notifications;
-        while (rptr) {
-            if (_process_single(rptr->seqNumber, autoremove)) {
-                fret = -1;
-                break;
-            }
-            rptr = rptr->next;
-        }
     } else {
+        pending = calloc(argc > optind ? argc - optind : 1, sizeof(*pending));
+        if (pending == NULL) {
+            jprint_error("calloc", NULL);
+            return -1;
+        }
         for (int i = optind; i < argc; i++) {
             unsigned long seqNumber;
 
@@ -112,13 +213,47 @@ static int applet_main(int argc, char **argv) {
             if ((seqNumber == 0 && strcmp(argv[i], str_end)) || errno != 0) {
                 continue;
             }
-            if (_process_single(seqNumber, autoremove)) {
+            pending[count++].seqNumber = seqNumber;
+        }
+    }
+
+    acked = calloc(count ? count : 1, sizeof(*acked));
+    if (acked == NULL) {
+        jprint_error("calloc", NULL);
+        notification_pending_free_all(pending, count);
+        return -1;
+    }
+
+    if (workers > 1 && count > 1 && euicc_ctx.http.interface->async_submit) {
+        fret = _process_concurrent(pending, count, workers, per_host, acked, &acked_count, &error);
+    } else {
+        // drivers without the async interface deliver one at a time
+        for (int i = 0; i < count; i++) {
+            if (_process_single(&pending[i], &error)) {
                 fret = -1;
                 break;
             }
+            acked[acked_count++] = pending[i].seqNumber;
         }
     }
 
+    // acknowledged notifications are removed together, even when a later delivery failed; the delivery
+    // error is still the one reported, with the reason of a failed removal added to it
+    if (autoremove && acked_count > 0 && notification_remove_batch(acked, acked_count, &remove_reason)) {
+        if (fret == 0) {
+            process_error_set(&error, "es10b_remove_notifications_from_list", remove_reason);
+        } else {
+            process_error_append_remove(&error, remove_reason);
+        }
+        fret = -1;
+    }
+    if (fret != 0) {
+        jprint_error(error.function_name, error.detail);
+    }
+
+    notification_pending_free_all(pending, count);
+    free(error.detail);
+
     if (fret == 0) {
         jprint_success(NULL);
     }
@@ -1,4 +1,5 @@
 #include "remove.h"
+#include "notification_common.h"
 
 #include <euicc/es10b.h>
 #include <lpac/utils.h>
@@ -10,28 +11,48 @@
 #include <string.h>
 #include <unistd.h>
 
-static int _delete_single(uint32_t seqNumber) {
-    char str_seqNumber[11];
-    int ret;
+struct remove_range {
+    unsigned long first;
+    unsigned long last;
+};
 
-    snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", seqNumber);
+static bool parse_seqNumber(const char *str, const char **str_end, unsigned long *seqNumber) {
+    char *end;
 
-    jprint_progress("es10b_remove_notification_from_list", str_seqNumber);
-    if ((ret = es10b_remove_notification_from_list(&euicc_ctx, seqNumber))) {
-        const char *reason;
-        switch (ret) {
-        case 1:
-            reason = "seqNumber not found";
-            break;
-        default:
-            reason = "unknown";
-            break;
+    errno = 0;
+    *seqNumber = strtoul(str, &end, 10);
+    // Although POSIX said user should check errno instead of return value,
+    // but errno may not be set when no conversion is performed according to C99.
+    // Check nptr is same as str_end to ensure there is no conversion.
+    if (end == str || errno != 0) {
+        return false;
+    }
+    *str_end = end;
+
+    return true;
+}
+
+// "5" or "5-9"
+static bool parse_range(const char *str, struct remove_range *range) {
+    const char *end;
+
+    if (!parse_seqNumber(str, &end, &range->first)) {
+        return false;
+    }
+    range->last = range->first;
+    if (*end == '-') {
+        if (!parse_seqNumber(end + 1, &end, &range->last) || range->last < range->first) {
+            return false;
         }
-        jprint_error("es10b_remove_notification_from_list", reason);
-        return -1;
     }
 
-    return 0;
+    return *end == '\0';
+}
+
+static int compare_seqNumber(const void *a, const void *b) {
+    const uint32_t seq_a = *(const uint32_t *)a, seq_b = *(const uint32_t *)b;
+
+    return seq_a < seq_b ? -1 : seq_a > seq_b;
 }
 
 static int applet_main(int argc, char **argv) {
@@ -40,6 +61,14 @@ static int applet_main(int argc, char **argv) {
     int fret = 0;
     int all = 0;
     int opt = 0;
+    bool need_list;
+    _cleanup_free_ struct remove_range *ranges = NULL;
+    int ranges_count = 0;
+    _cleanup_free_ uint32_t *seqNumbers = NULL;
+    int count = 0, unique = 0;
+    _cleanup_free_ char *reason = NULL;
+    _cleanup_es10b_notification_metadata_list_ struct es10b_notification_metadata_list *notifications = NULL;
+    struct es10b_notification_metadata_list *rptr;
 
     while ((opt = getopt(argc, argv, opt_string)) != -1) {
         switch (opt) {
@@ -48,7 +77,7 @@ static int applet_main(int argc, char **argv) {
             break;
         case 'h':
         case '?':
-            printf("Usage: %s [OPTIONS] [seqNumber_0] [seqNumber_1]...\n", argv[0]);
+            printf("Usage: %s [OPTIONS] [seqNumber_0|first-last] [seqNumber_1|first-last]...\n", argv[0]);
             printf("\t -a All notifications\n");
             return -1;
         default:
@@ -56,44 +85,71 @@ static int applet_main(int argc, char **argv) {
         }
     }
 
-    if (all) {
-        _cleanup_es10b_notification_metadata_list_ struct es10b_notification_metadata_list *notifications, *rptr;
+    ranges = calloc(argc > optind ? argc - optind : 1, sizeof(*ranges));
+    if (ranges == NULL) {
+        jprint_error("calloc", NULL);
+        return -1;
+    }
+    need_list = all;
+    for (int i = optind; i < argc; i++) {
+        if (!parse_range(argv[i], &ranges[ranges_count])) {
+            continue;
+        }
+        need_list |= ranges[ranges_count].first != ranges[ranges_count].last;
+        ranges_count++;
+    }
 
+    if (need_list) {
+        // ranges only cover the notifications that exist, instead of every number in between
         jprint_progress("es10b_list_notification", NULL);
         if (es10b_list_notification(&euicc_ctx, &notifications)) {
             jprint_error("es10b_list_notification", NULL);
             return -1;
         }
+        for (rptr = notifications; rptr; rptr = rptr->next) {
+            count++;
+        }
+    }
 
-        rptr = notifications;
-        while (rptr) {
-            if (_delete_single(rptr->seqNumber)) {
-                fret = -1;
-                break;
-            }
-            rptr = rptr->next;
+    seqNumbers = calloc(count + ranges_count + 1, sizeof(*seqNumbers));
+    if (seqNumbers == NULL) {
+        jprint_error("calloc", NULL);
+        return -1;
+    }
+    count = 0;
+    for (rptr = notifications; rptr; rptr = rptr->next) {
+        bool selected = all;
+        for (int i = 0; i < ranges_count && !selected; i++) {
+            selected = ranges[i].first != ranges[i].last && rptr->seqNumber >= ranges[i].first
+                       && rptr->seqNumber <= ranges[i].last;
+        }
+        if (selected) {
+            seqNumbers[count++] = rptr->seqNumber;
         }
-    } else {
-        for (int i = optind; i < argc; i++) {
-            unsigned long seqNumber;
-
-            errno = 0;
-            char *str_end;
-            seqNumber = strtoul(argv[i], &str_end, 10);
-            // Although POSIX said user should check errno instead of return value,
-            // but errno may not be set when no conversion is performed according to C99.
-            // Check nptr is same as str_end to ensure there is no conversion.
-            if ((seqNumber == 0 && strcmp(argv[i], str_end)) || errno != 0) {
-                continue;
+    }
+    if (!all) {
+        for (int i = 0; i < ranges_count; i++) {
+            if (ranges[i].first == ranges[i].last) {
+                seqNumbers[count++] = ranges[i].first;
             }
+        }
+    }
 
-            if (_delete_single(seqNumber)) {
-                fret = -1;
-                break;
+    // overlapping arguments ("5 5-9") must not remove, or report, a notification twice
+    if (count > 0) {
+        qsort(seqNumbers, count, sizeof(*seqNumbers), compare_seqNumber);
+        for (int i = 0; i < count; i++) {
+            if (unique == 0 || seqNumbers[unique - 1] != seqNumbers[i]) {
+                seqNumbers[unique++] = seqNumbers[i];
             }
         }
     }
 
+    if (notification_remove_batch(seqNumbers, unique, &reason)) {
+        jprint_error("es10b_remove_notifications_from_list", reason);
+        fret = -1;
+    }
+
     if (fret == 0) {
         jprint_success(NULL);
     }
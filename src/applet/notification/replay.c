@@ -1,3 +1,4 @@
+#include "archive.h"
 #include "notification_common.h"
 #include "process.h"
 
@@ -59,62 +60,229 @@ ssize_t getline(char **lineptr, size_t *n, FILE *stream) {
 }
 #endif
 
-static int handle_notification(const uint32_t seqNumber, const struct es10b_pending_notification notification) {
-    char str_seqNumber[11];
-
-    snprintf(str_seqNumber, sizeof(str_seqNumber), "%u", seqNumber);
-
-    euicc_ctx.http.server_address = notification.notificationAddress;
+struct replay_input {
+    struct notification_pending *pending;
+    int count;
+    int capacity;
+};
 
-    jprint_progress("es9p_handle_notification", str_seqNumber);
-    if (es9p_handle_notification(&euicc_ctx, notification.b64_PendingNotification)) {
-        jprint_error("es9p_handle_notification", NULL);
-        return -1;
+static struct notification_pending *replay_input_add(struct replay_input *input) {
+    if (input->count == input->capacity) {
+        const int capacity = input->capacity ? input->capacity * 2 : 16;
+        struct notification_pending *npending = realloc(input->pending, capacity * sizeof(*npending));
+        if (npending == NULL) {
+            return NULL;
+        }
+        input->pending = npending;
+        input->capacity = capacity;
     }
 
-    return 0;
+    memset(&input->pending[input->count], 0, sizeof(input->pending[input->count]));
+    return &input->pending[input->count++];
 }
 
-static int applet_main(__attribute__((unused)) const int argc, __attribute__((unused)) char **argv) {
-    if (isatty(fileno(stdin))) {
-        jprint_error("This applet must be run with input redirection from a file or pipe.", NULL);
+// Only the records of the EID are decoded, the index finds them without reading the others
+static int replay_load_archive(struct replay_input *input, const char *path, const char *eid) {
+    struct notification_archive archive;
+    uint32_t first, count;
+    int fret = 0;
+
+    if (notification_archive_open(path, &archive) < 0) {
+        jprint_error("notification_archive_open", path);
         return -1;
     }
 
-    char *input = NULL;
-    char *eid = NULL;
-    uint32_t seqNumber = 0;
+    if (notification_archive_find(&archive, eid, &first, &count) < 0) {
+        jprint_error("notification_archive_find", eid);
+        goto err;
+    }
 
-    if (es10c_get_eid(&euicc_ctx, &eid) != 0) {
-        jprint_error("es10c_get_eid", NULL);
-        return -1;
+    for (uint32_t i = first; i < first + count; i++) {
+        struct notification_pending *pending = replay_input_add(input);
+        if (pending == NULL) {
+            jprint_error("realloc", NULL);
+            goto err;
+        }
+        if (notification_archive_read(&archive, i, &pending->seqNumber, &pending->notification) < 0) {
+            input->count--;
+            jprint_error("notification_archive_read", NULL);
+            goto err;
+        }
     }
 
-    size_t n;
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    notification_archive_close(&archive);
+    return fret;
+}
+
+// Lines of other EIDs and other record types, like the outcomes in a spool journal, are skipped
+static int replay_load_json(struct replay_input *input, FILE *fp, const char *eid) {
+    _cleanup_free_ char *line = NULL;
+    size_t n = 0;
+    ssize_t len;
 
-    _cleanup_(es10b_pending_notification_free) struct es10b_pending_notification notification;
+    while ((len = getline(&line, &n, fp)) != -1) {
+        struct es10b_pending_notification parsed = {0};
+        struct notification_pending *pending;
+        uint32_t seqNumber = 0;
+        _cleanup_cjson_ cJSON *jroot = NULL;
 
-    while (getline(&input, &n, stdin) != -1) {
-        _cleanup_cjson_ cJSON *jroot = cJSON_ParseWithLength(input, n);
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        jroot = cJSON_ParseWithLength(line, len);
         if (jroot == NULL) {
             jprint_error("cJSON_ParseWithLength", NULL);
             return -1;
         }
-        if (parse_notification(jroot, eid, &seqNumber, &notification) != 0) {
-            jprint_error("parse_notification", NULL);
+        if (!parse_notification(jroot, eid, &seqNumber, &parsed)) {
+            continue;
+        }
+
+        pending = replay_input_add(input);
+        if (pending == NULL) {
+            jprint_error("realloc", NULL);
             return -1;
         }
-        if (handle_notification(seqNumber, notification) != 0) {
-            jprint_error("handle_notification", NULL);
+        pending->seqNumber = seqNumber;
+        // parsed points into jroot
+        pending->notification.notificationAddress = strdup(parsed.notificationAddress);
+        pending->notification.b64_PendingNotification = strdup(parsed.b64_PendingNotification);
+        if (pending->notification.notificationAddress == NULL || pending->notification.b64_PendingNotification == NULL) {
+            jprint_error("strdup", NULL);
             return -1;
         }
     }
 
-    jprint_success(NULL);
-
     return 0;
 }
 
+static int applet_main(const int argc, char **argv) {
+    static const char *opt_string = "f:e:p:P:h?";
+
+    int fret = 0;
+    int opt = 0;
+    const char *path = NULL;
+    const char *eid = NULL;
+    _cleanup_free_ char *card_eid = NULL;
+    int workers = 1;
+    int per_host = NOTIFICATION_PER_HOST_DEFAULT;
+    struct replay_input input = {0};
+    struct notification_delivery *items = NULL;
+    int failed = 0;
+    FILE *fp = NULL;
+
+    while ((opt = getopt(argc, argv, opt_string)) != -1) {
+        switch (opt) {
+        case 'f':
+            path = optarg;
+            break;
+        case 'e':
+            eid = optarg;
+            break;
+        case 'p':
+            workers = atoi(optarg);
+            if (workers < 1) {
+                printf("Number of parallel deliveries must be at least 1\n");
+                return -1;
+            }
+            break;
+        case 'P':
+            per_host = atoi(optarg);
+            if (per_host < 1) {
+                printf("Number of parallel deliveries per server must be at least 1\n");
+                return -1;
+            }
+            break;
+        case 'h':
+        case '?':
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("\t -f Read a notification archive or a `notification dump` output file instead of stdin\n");
+            printf("\t -e Replay the notifications of this EID (default: the EID of the eUICC)\n");
+            printf("\t -p Deliver up to N notifications in parallel\n");
+            printf("\t -P With -p, at most N parallel deliveries to the same server (default: %d)\n",
+                   NOTIFICATION_PER_HOST_DEFAULT);
+            return -1;
+        default:
+            break;
+        }
+    }
+
+    if (path == NULL && isatty(fileno(stdin))) {
+        jprint_error("This applet must be run with input redirection from a file or pipe.", NULL);
+        return -1;
+    }
+
+    if (eid == NULL) {
+        if (es10c_get_eid(&euicc_ctx, &card_eid) != 0) {
+            jprint_error("es10c_get_eid", NULL);
+            return -1;
+        }
+        eid = card_eid;
+    }
+
+    if (path != NULL && notification_archive_probe(path)) {
+        if (replay_load_archive(&input, path, eid) < 0) {
+            goto err;
+        }
+    } else {
+        fp = path != NULL ? fopen(path, "r") : stdin;
+        if (fp == NULL) {
+            jprint_error("fopen", path);
+            goto err;
+        }
+        if (replay_load_json(&input, fp, eid) < 0) {
+            goto err;
+        }
+    }
+
+    if (input.count > 0) {
+        items = calloc(input.count, sizeof(*items));
+        if (items == NULL) {
+            jprint_error("calloc", NULL);
+            goto err;
+        }
+    }
+    for (int i = 0; i < input.count; i++) {
+        items[i].seqNumber = input.pending[i].seqNumber;
+        items[i].host = notification_strstrip(input.pending[i].notification.notificationAddress);
+        items[i].b64_PendingNotification = input.pending[i].notification.b64_PendingNotification;
+    }
+
+    if (notification_deliver(items, input.count, workers, per_host) < 0) {
+        jprint_error("es9p_handle_notification", "HTTP transport failed");
+        goto err;
+    }
+    for (int i = 0; i < input.count; i++) {
+        if (items[i].state != NOTIFICATION_DELIVERED) {
+            failed++;
+        }
+    }
+    if (failed > 0) {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "%d of %d failed", failed, input.count);
+        jprint_error("es9p_handle_notification", reason);
+        goto err;
+    }
+
+    jprint_success(NULL);
+
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    if (fp != NULL && fp != stdin) {
+        fclose(fp);
+    }
+    free(items);
+    notification_pending_free_all(input.pending, input.count);
+    return fret;
+}
 struct applet_entry applet_notification_replay = {
     .name = "replay",
     .main = applet_main,
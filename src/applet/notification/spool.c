@@ -0,0 +1,485 @@
+#include "spool.h"
+#include "notification_common.h"
+
+#include <euicc/es10b.h>
+#include <euicc/es10c.h>
+#include <lpac/utils.h>
+
+#include <main.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+
+#ifndef _WIN32
+#    include <sys/file.h>
+#    include <unistd.h>
+#else
+#    include <io.h>
+#    include <windows.h>
+#endif
+
+#define ENV_NOTIFICATION_SPOOL "LPAC_NOTIFICATION_SPOOL"
+
+#define SPOOL_BACKOFF_MIN 60
+#define SPOOL_BACKOFF_MAX (24 * 60 * 60)
+
+// The spool is a JSON-lines journal. Notifications use the `notification dump` format, so the file
+// can also be fed to `notification replay`; outcomes are appended as separate records:
+//   {"type":"notification","eid":...,"seqNumber":...,"notificationAddress":...,"pendingNotification":...}
+//   {"type":"delivered","eid":...,"seqNumber":...}
+//   {"type":"retry","eid":...,"seqNumber":...,"attempts":...,"next":<unix time>}
+// A flush rewrites the file with only the undelivered notifications.
+struct spool_entry {
+    char *eid;
+    uint32_t seqNumber;
+    char *notificationAddress;
+    char *b64_PendingNotification;
+    bool delivered;
+    int attempts;
+    long long next_attempt;
+    struct spool_entry *next;
+};
+
+const char *notification_spool_path(void) {
+    const char *path = getenv(ENV_NOTIFICATION_SPOOL);
+
+    return path != NULL && path[0] != '\0' ? path : NULL;
+}
+
+static void spool_entries_free(struct spool_entry *entries) {
+    while (entries) {
+        struct spool_entry *next = entries->next;
+        free(entries->eid);
+        free(entries->notificationAddress);
+        free(entries->b64_PendingNotification);
+        free(entries);
+        entries = next;
+    }
+}
+
+static struct spool_entry *spool_entry_find(struct spool_entry *entries, const char *eid, uint32_t seqNumber) {
+    for (; entries != NULL; entries = entries->next) {
+        if (entries->seqNumber == seqNumber && strcmp(entries->eid, eid) == 0) {
+            return entries;
+        }
+    }
+    return NULL;
+}
+
+static void spool_apply_record(struct spool_entry **entries, struct spool_entry ***tail, const cJSON *jroot) {
+    const char *type = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "type"));
+    const char *eid = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "eid"));
+    const cJSON *jseqNumber = cJSON_GetObjectItem(jroot, "seqNumber");
+    struct spool_entry *entry;
+    uint32_t seqNumber;
+
+    if (type == NULL || eid == NULL || !cJSON_IsNumber(jseqNumber)) {
+        return;
+    }
+    seqNumber = (uint32_t)cJSON_GetNumberValue(jseqNumber);
+    entry = spool_entry_find(*entries, eid, seqNumber);
+
+    if (strcmp(type, "notification") == 0) {
+        const char *address = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "notificationAddress"));
+        const char *b64 = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "pendingNotification"));
+
+        if (entry != NULL || address == NULL || b64 == NULL || (entry = calloc(1, sizeof(*entry))) == NULL) {
+            return;
+        }
+        entry->eid = strdup(eid);
+        entry->seqNumber = seqNumber;
+        entry->notificationAddress = strdup(address);
+        entry->b64_PendingNotification = strdup(b64);
+        if (entry->eid == NULL || entry->notificationAddress == NULL || entry->b64_PendingNotification == NULL) {
+            spool_entries_free(entry);
+            return;
+        }
+        // records from `notification dump` keep the address as read from the card
+        memmove(entry->notificationAddress, notification_strstrip(entry->notificationAddress),
+                strlen(notification_strstrip(entry->notificationAddress)) + 1);
+        **tail = entry;
+        *tail = &entry->next;
+    } else if (entry == NULL) {
+        return;
+    } else if (strcmp(type, "delivered") == 0) {
+        entry->delivered = true;
+    } else if (strcmp(type, "retry") == 0) {
+        const cJSON *jattempts = cJSON_GetObjectItem(jroot, "attempts");
+        const cJSON *jnext = cJSON_GetObjectItem(jroot, "next");
+
+        if (cJSON_IsNumber(jattempts) && cJSON_IsNumber(jnext)) {
+            entry->attempts = (int)cJSON_GetNumberValue(jattempts);
+            entry->next_attempt = (long long)cJSON_GetNumberValue(jnext);
+        }
+    }
+}
+
+// Replays the journal in order. A torn last line left by a crash does not parse and is skipped.
+static int spool_load(const char *path, struct spool_entry **entries) {
+    _cleanup_free_ char *buf = NULL;
+    struct spool_entry **tail = entries;
+    FILE *fp;
+    long size;
+    char *line, *end;
+
+    *entries = NULL;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        // nothing spooled yet
+        return 0;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0
+        || (buf = malloc(size + 1)) == NULL || fread(buf, 1, size, fp) != (size_t)size) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    buf[size] = '\0';
+
+    for (line = buf; line < buf + size; line = end + 1) {
+        _cleanup_cjson_ cJSON *jroot = NULL;
+
+        if ((end = strchr(line, '\n')) == NULL) {
+            end = buf + size;
+        }
+        if ((jroot = cJSON_ParseWithLength(line, end - line)) != NULL) {
+            spool_apply_record(entries, &tail, jroot);
+        }
+    }
+
+    return 0;
+}
+
+static int spool_sync(FILE *fp) {
+    if (fflush(fp) != 0) {
+        return -1;
+    }
+#ifndef _WIN32
+    return fsync(fileno(fp));
+#else
+    return _commit(_fileno(fp));
+#endif
+}
+
+static FILE *spool_open(const char *path, const char *mode, int flags) {
+#ifndef _WIN32
+    // notifications identify the eUICC, keep the spool private to the user
+    const int fd = open(path, flags | O_CREAT, 0600);
+    FILE *fp = fd < 0 ? NULL : fdopen(fd, mode);
+
+    if (fp == NULL && fd >= 0) {
+        close(fd);
+    }
+    return fp;
+#else
+    (void)flags;
+    return fopen(path, mode);
+#endif
+}
+
+// Serializes capture and flush between lpac processes sharing the spool. The lock lives in a
+// separate file because compaction replaces the spool itself.
+static int spool_lock(const char *path) {
+    _cleanup_free_ char *lock_path = malloc(strlen(path) + 6);
+    int fd;
+#ifdef _WIN32
+    OVERLAPPED overlapped = {0};
+#endif
+
+    if (lock_path == NULL) {
+        return -1;
+    }
+    sprintf(lock_path, "%s.lock", path);
+    if ((fd = open(lock_path, O_RDWR | O_CREAT, 0600)) < 0) {
+        return -1;
+    }
+#ifndef _WIN32
+    if (flock(fd, LOCK_EX) != 0) {
+#else
+    if (!LockFileEx((HANDLE)_get_osfhandle(fd), LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+#endif
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void spool_unlock(int fd) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {0};
+#endif
+
+    if (fd < 0) {
+        return;
+    }
+#ifdef _WIN32
+    // closing the handle releases the lock too, but not necessarily right away
+    UnlockFileEx((HANDLE)_get_osfhandle(fd), 0, MAXDWORD, MAXDWORD, &overlapped);
+#endif
+    close(fd);
+}
+
+static bool spool_write_record(FILE *fp, const char *type, const char *eid, uint32_t seqNumber,
+                               const struct spool_entry *entry) {
+    _cleanup_cjson_ cJSON *jroot = cJSON_CreateObject();
+    _cleanup_free_ char *line = NULL;
+
+    if (jroot == NULL) {
+        return false;
+    }
+    cJSON_AddStringToObject(jroot, "type", type);
+    cJSON_AddStringToObject(jroot, "eid", eid);
+    cJSON_AddNumberToObject(jroot, "seqNumber", seqNumber);
+    if (strcmp(type, "notification") == 0) {
+        cJSON_AddStringToObject(jroot, "notificationAddress", entry->notificationAddress);
+        cJSON_AddStringToObject(jroot, "pendingNotification", entry->b64_PendingNotification);
+    } else if (strcmp(type, "retry") == 0) {
+        cJSON_AddNumberToObject(jroot, "attempts", entry->attempts);
+        cJSON_AddNumberToObject(jroot, "next", (double)entry->next_attempt);
+    }
+
+    if ((line = cJSON_PrintUnformatted(jroot)) == NULL) {
+        return false;
+    }
+    return fprintf(fp, "%s\n", line) > 0;
+}
+
+// Rewrites the spool with the undelivered notifications only, replacing it atomically
+static int spool_compact(const char *path, const struct spool_entry *entries) {
+    _cleanup_free_ char *tmp_path = malloc(strlen(path) + 5);
+    FILE *fp;
+    bool ok = true;
+
+    if (tmp_path == NULL) {
+        return -1;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+
+    if ((fp = spool_open(tmp_path, "wb", O_WRONLY | O_TRUNC)) == NULL) {
+        return -1;
+    }
+    for (; entries != NULL && ok; entries = entries->next) {
+        if (entries->delivered) {
+            continue;
+        }
+        ok = spool_write_record(fp, "notification", entries->eid, entries->seqNumber, entries);
+        if (ok && entries->attempts > 0) {
+            ok = spool_write_record(fp, "retry", entries->eid, entries->seqNumber, entries);
+        }
+    }
+    if (!ok || spool_sync(fp) != 0) {
+        fclose(fp);
+        remove(tmp_path);
+        return -1;
+    }
+    if (fclose(fp) != 0 || rename_replace(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+int notification_spool_capture(void) {
+    const char *path = notification_spool_path();
+    struct notification_pending *pending = NULL;
+    int count = 0;
+    struct spool_entry *entries = NULL;
+    _cleanup_free_ char *eid = NULL;
+    FILE *fp = NULL;
+    int lock = -1;
+    int fret = 0;
+
+    if (path == NULL) {
+        return 0;
+    }
+
+    if (es10c_get_eid(&euicc_ctx, &eid) != 0 || notification_retrieve_all(&pending, &count) != 0) {
+        return -1;
+    }
+    if (count == 0) {
+        goto exit;
+    }
+
+    if ((lock = spool_lock(path)) < 0 || spool_load(path, &entries) < 0) {
+        goto err;
+    }
+    if ((fp = spool_open(path, "ab", O_WRONLY | O_APPEND)) == NULL) {
+        goto err;
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct spool_entry entry = {0};
+
+        // already spooled by an earlier capture that could not remove it from the card
+        if (spool_entry_find(entries, eid, pending[i].seqNumber) != NULL) {
+            continue;
+        }
+        entry.notificationAddress = notification_strstrip(pending[i].notification.notificationAddress);
+        entry.b64_PendingNotification = pending[i].notification.b64_PendingNotification;
+        if (!spool_write_record(fp, "notification", eid, pending[i].seqNumber, &entry)) {
+            goto err;
+        }
+    }
+
+    // one sync for the whole batch, nothing leaves the card before it is on disk
+    if (spool_sync(fp) != 0) {
+        goto err;
+    }
+    fclose(fp);
+    fp = NULL;
+    spool_unlock(lock);
+    lock = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (es10b_remove_notification_from_list(&euicc_ctx, pending[i].seqNumber) == 0) {
+            fret++;
+        }
+    }
+
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    if (fp) {
+        fclose(fp);
+    }
+    spool_unlock(lock);
+    spool_entries_free(entries);
+    notification_pending_free_all(pending, count);
+    return fret;
+}
+
+int notification_spool_autocapture(void) {
+    int captured;
+
+    if (notification_spool_path() == NULL) {
+        return 0;
+    }
+
+    jprint_progress("notification_spool_capture", NULL);
+    if ((captured = notification_spool_capture()) < 0) {
+        jprint_progress("notification_spool_capture", "failed, the notifications stay on the eUICC");
+    }
+    return captured;
+}
+
+static long long spool_backoff(int attempts) {
+    long long delay = SPOOL_BACKOFF_MIN;
+
+    while (--attempts > 0 && delay < SPOOL_BACKOFF_MAX) {
+        delay *= 2;
+    }
+    return delay < SPOOL_BACKOFF_MAX ? delay : SPOOL_BACKOFF_MAX;
+}
+
+int notification_spool_flush(bool force, int workers, int per_host, struct notification_spool_result *result) {
+    const char *path = notification_spool_path();
+    const long long now = time(NULL);
+    struct spool_entry *entries = NULL, *entry;
+    struct spool_entry **due = NULL;
+    struct notification_delivery *items = NULL;
+    FILE *fp = NULL;
+    int lock = -1;
+    int count = 0;
+    int fret = 0;
+
+    memset(result, 0, sizeof(*result));
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    // the lock is not held while delivering, so profile operations can keep capturing meanwhile
+    if ((lock = spool_lock(path)) < 0 || spool_load(path, &entries) < 0) {
+        goto err;
+    }
+    spool_unlock(lock);
+    lock = -1;
+
+    for (entry = entries; entry != NULL; entry = entry->next) {
+        if (!entry->delivered) {
+            count++;
+        }
+    }
+    due = calloc(count ? count : 1, sizeof(*due));
+    items = calloc(count ? count : 1, sizeof(*items));
+    if (due == NULL || items == NULL) {
+        goto err;
+    }
+    count = 0;
+    for (entry = entries; entry != NULL; entry = entry->next) {
+        if (entry->delivered || (!force && entry->next_attempt > now)) {
+            continue;
+        }
+        due[count] = entry;
+        items[count].seqNumber = entry->seqNumber;
+        items[count].host = entry->notificationAddress;
+        items[count].b64_PendingNotification = entry->b64_PendingNotification;
+        count++;
+    }
+
+    if (count > 0 && notification_deliver(items, count, workers, per_host) < 0) {
+        goto err;
+    }
+
+    if ((lock = spool_lock(path)) < 0) {
+        goto err;
+    }
+    if (count > 0) {
+        if ((fp = spool_open(path, "ab", O_WRONLY | O_APPEND)) == NULL) {
+            goto err;
+        }
+        for (int i = 0; i < count; i++) {
+            entry = due[i];
+            if (items[i].state == NOTIFICATION_DELIVERED) {
+                result->delivered++;
+                if (!spool_write_record(fp, "delivered", entry->eid, entry->seqNumber, entry)) {
+                    goto err;
+                }
+            } else {
+                result->failed++;
+                entry->attempts++;
+                entry->next_attempt = now + spool_backoff(entry->attempts);
+                if (!spool_write_record(fp, "retry", entry->eid, entry->seqNumber, entry)) {
+                    goto err;
+                }
+            }
+        }
+        if (spool_sync(fp) != 0) {
+            goto err;
+        }
+        fclose(fp);
+        fp = NULL;
+    }
+
+    // reload to pick up notifications captured while delivering, then drop the delivered ones
+    spool_entries_free(entries);
+    if (spool_load(path, &entries) < 0 || spool_compact(path, entries) < 0) {
+        goto err;
+    }
+    for (entry = entries; entry != NULL; entry = entry->next) {
+        if (!entry->delivered) {
+            result->pending++;
+        }
+    }
+
+    fret = 0;
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    if (fp) {
+        fclose(fp);
+    }
+    spool_unlock(lock);
+    spool_entries_free(entries);
+    free(due);
+    free(items);
+    return fret;
+}
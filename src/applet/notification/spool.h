@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct notification_spool_result {
+    int delivered;
+    int failed;
+    int pending;
+};
+
+// Path of the local notification spool from LPAC_NOTIFICATION_SPOOL, NULL when spooling is off
+const char *notification_spool_path(void);
+
+// Moves the pending notifications of the eUICC into the spool: all of them are appended and synced
+// to disk before any is removed from the card. Returns the number moved, -1 on error.
+int notification_spool_capture(void);
+
+// Runs after profile operations: moves their notifications into the spool when spooling is on.
+// A failure is reported as progress and returned (-1), but just leaves them on the eUICC, so callers
+// do not fail the operation for it. Returns the number moved otherwise.
+int notification_spool_autocapture(void);
+
+// Delivers the spooled notifications whose retry time has come (all of them with force), records
+// the outcome and compacts the spool. Failed deliveries are retried later with exponential backoff.
+int notification_spool_flush(bool force, int workers, int per_host, struct notification_spool_result *result);
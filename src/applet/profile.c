@@ -1,6 +1,7 @@
 #include "profile.h"
 
 #include "main.h"
+#include "profile/batch.h"
 #include "profile/delete.h"
 #include "profile/disable.h"
 #include "profile/discovery.h"
@@ -16,7 +17,7 @@
 
 static const struct applet_entry *applets[] = {
     &applet_profile_list,   &applet_profile_enable,   &applet_profile_disable,   &applet_profile_nickname,
-    &applet_profile_delete, &applet_profile_download, &applet_profile_discovery, NULL,
+    &applet_profile_delete, &applet_profile_download, &applet_profile_discovery, &applet_profile_batch, NULL,
 };
 
 static int applet_main(const int argc, char **argv) {
@@ -0,0 +1,357 @@
+#include "batch.h"
+#include "applet/notification/autoprocess.h"
+#include "applet/notification/spool.h"
+#include "main.h"
+
+#include <euicc/es10c.h>
+#include <lpac/utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+// One operation per JSON line:
+//   {"action":"enable","id":"<iccid/aid>","refreshFlag":1}
+//   {"action":"disable","id":"<iccid/aid>"}
+//   {"action":"delete","id":"<iccid/aid>"}
+//   {"action":"nickname","id":"<iccid>","nickname":"<alias>"}
+enum batch_action {
+    BATCH_ENABLE,
+    BATCH_DISABLE,
+    BATCH_DELETE,
+    BATCH_NICKNAME,
+};
+
+static const char *batch_action_names[] = {
+    [BATCH_ENABLE] = "enable",
+    [BATCH_DISABLE] = "disable",
+    [BATCH_DELETE] = "delete",
+    [BATCH_NICKNAME] = "nickname",
+};
+
+static const char *batch_function_names[] = {
+    [BATCH_ENABLE] = "es10c_enable_profile",
+    [BATCH_DISABLE] = "es10c_disable_profile",
+    [BATCH_DELETE] = "es10c_delete_profile",
+    [BATCH_NICKNAME] = "es10c_set_nickname",
+};
+
+struct batch_op {
+    enum batch_action action;
+    char *id;
+    uint8_t refreshFlag;
+    char *nickname;
+    bool done;
+};
+
+struct batch_manifest {
+    struct batch_op *ops;
+    int count;
+    int capacity;
+};
+
+static void batch_manifest_free(struct batch_manifest *manifest) {
+    for (int i = 0; i < manifest->count; i++) {
+        free(manifest->ops[i].id);
+        free(manifest->ops[i].nickname);
+    }
+    free(manifest->ops);
+}
+
+static int batch_parse_op(const cJSON *jroot, struct batch_op *op) {
+    const char *action = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "action"));
+    const char *id = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "id"));
+    const cJSON *jrefreshFlag = cJSON_GetObjectItem(jroot, "refreshFlag");
+    const char *nickname = cJSON_GetStringValue(cJSON_GetObjectItem(jroot, "nickname"));
+    size_t i;
+
+    if (action == NULL || id == NULL) {
+        return -1;
+    }
+    for (i = 0; i < sizeof(batch_action_names) / sizeof(batch_action_names[0]); i++) {
+        if (strcmp(action, batch_action_names[i]) == 0) {
+            break;
+        }
+    }
+    if (i == sizeof(batch_action_names) / sizeof(batch_action_names[0])) {
+        return -1;
+    }
+
+    memset(op, 0, sizeof(*op));
+    op->action = i;
+    op->refreshFlag = cJSON_IsTrue(jrefreshFlag) || (cJSON_IsNumber(jrefreshFlag) && jrefreshFlag->valueint != 0);
+    op->id = strdup(id);
+    op->nickname = strdup(nickname != NULL ? nickname : "");
+    if (op->id == NULL || op->nickname == NULL) {
+        free(op->id);
+        free(op->nickname);
+        return -1;
+    }
+
+    return 0;
+}
+
+// The whole manifest is read and checked before the first operation touches the eUICC
+static int batch_manifest_load(struct batch_manifest *manifest, FILE *fp) {
+    char line[1024];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        _cleanup_cjson_ cJSON *jroot = NULL;
+        char str_lineno[16];
+
+        lineno++;
+        snprintf(str_lineno, sizeof(str_lineno), "line %d", lineno);
+
+        if (strchr(line, '\n') == NULL && !feof(fp)) {
+            jprint_error("profile_batch", str_lineno);
+            return -1;
+        }
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#') {
+            continue;
+        }
+
+        if (manifest->count == manifest->capacity) {
+            const int capacity = manifest->capacity ? manifest->capacity * 2 : 16;
+            struct batch_op *nops = realloc(manifest->ops, capacity * sizeof(*nops));
+            if (nops == NULL) {
+                jprint_error("realloc", NULL);
+                return -1;
+            }
+            manifest->ops = nops;
+            manifest->capacity = capacity;
+        }
+
+        jroot = cJSON_Parse(line);
+        if (jroot == NULL || batch_parse_op(jroot, &manifest->ops[manifest->count]) < 0) {
+            jprint_error("profile_batch", str_lineno);
+            return -1;
+        }
+        manifest->count++;
+    }
+
+    return 0;
+}
+
+static const char *batch_reason(enum batch_action action, int ret) {
+    switch (ret) {
+    case 1:
+        return action == BATCH_NICKNAME ? "iccid not found" : "iccid or aid not found";
+    case 2:
+        return action == BATCH_DISABLE ? "profile not in enabled state" : "profile not in disabled state";
+    case 3:
+        return "disallowed by policy";
+    case 4:
+        return action == BATCH_ENABLE ? "wrong profile reenabling" : "unknown";
+    case -1:
+        return "internal error, maybe illegal iccid/aid coding";
+    default:
+        return "unknown";
+    }
+}
+
+static int batch_run(struct batch_op *op) {
+    switch (op->action) {
+    case BATCH_ENABLE:
+        return es10c_enable_profile(&euicc_ctx, op->id, op->refreshFlag);
+    case BATCH_DISABLE:
+        return es10c_disable_profile(&euicc_ctx, op->id, op->refreshFlag);
+    case BATCH_DELETE:
+        return es10c_delete_profile(&euicc_ctx, op->id);
+    case BATCH_NICKNAME:
+        return es10c_set_nickname(&euicc_ctx, op->id, op->nickname);
+    }
+    return -1;
+}
+
+static const struct es10c_profile_info_list *batch_find_profile(const struct es10c_profile_info_list *profiles,
+                                                                const char *id) {
+    for (; profiles != NULL; profiles = profiles->next) {
+        if (strcasecmp(profiles->iccid, id) == 0 || strcasecmp(profiles->isdpAid, id) == 0) {
+            return profiles;
+        }
+    }
+    return NULL;
+}
+
+static bool batch_verify_op(const struct es10c_profile_info_list *profiles, const struct batch_op *op) {
+    const struct es10c_profile_info_list *profile = batch_find_profile(profiles, op->id);
+
+    switch (op->action) {
+    case BATCH_ENABLE:
+        return profile != NULL && profile->profileState == ES10C_PROFILE_STATE_ENABLED;
+    case BATCH_DISABLE:
+        return profile != NULL && profile->profileState == ES10C_PROFILE_STATE_DISABLED;
+    case BATCH_DELETE:
+        return profile == NULL;
+    case BATCH_NICKNAME:
+        return profile != NULL && strcmp(profile->profileNickname ? profile->profileNickname : "", op->nickname) == 0;
+    }
+    return false;
+}
+
+// Only the last successful operation on a profile determines its expected state, or nickname
+static int batch_verify(const struct batch_manifest *manifest) {
+    // iccid, isdpAid, profileState and profileNickname; no names or icons are read
+    static const uint8_t tagList[] = {0x5A, 0x4F, 0x9F, 0x70, 0x90};
+    _cleanup_es10c_profile_info_list_ struct es10c_profile_info_list *profiles = NULL;
+    int unverified = 0;
+
+    jprint_progress("es10c_get_profiles_info", NULL);
+    if (es10c_get_profiles_info_taglist(&euicc_ctx, tagList, sizeof(tagList), &profiles)) {
+        jprint_error("es10c_get_profiles_info", NULL);
+        return -1;
+    }
+
+    for (int i = 0; i < manifest->count; i++) {
+        const struct batch_op *op = &manifest->ops[i];
+        bool superseded = false;
+        cJSON *jdata;
+
+        if (!op->done) {
+            continue;
+        }
+        for (int j = i + 1; j < manifest->count && !superseded; j++) {
+            const struct batch_op *later = &manifest->ops[j];
+            if (!later->done) {
+                continue;
+            }
+            // enabling another profile disables this one
+            superseded = (later->action == BATCH_ENABLE && op->action == BATCH_ENABLE)
+                         || (strcasecmp(later->id, op->id) == 0
+                             && (later->action == BATCH_DELETE
+                                 || (later->action == BATCH_NICKNAME) == (op->action == BATCH_NICKNAME)));
+        }
+        if (superseded) {
+            continue;
+        }
+
+        jdata = cJSON_CreateObject();
+        cJSON_AddNumberToObject(jdata, "index", i);
+        cJSON_AddStringOrNullToObject(jdata, "id", op->id);
+        if (batch_verify_op(profiles, op)) {
+            cJSON_AddTrueToObject(jdata, "verified");
+        } else {
+            cJSON_AddFalseToObject(jdata, "verified");
+            unverified++;
+        }
+        jprint_progress_obj("profile_batch_verify", jdata);
+    }
+
+    return unverified;
+}
+
+static int applet_main(int argc, char **argv) {
+    static const char *opt_string = "f:vsh?";
+
+    int fret = 0;
+    int opt = 0;
+    const char *path = NULL;
+    bool verify = false;
+    bool stop = false;
+    struct batch_manifest manifest = {0};
+    FILE *fp = NULL;
+    int failed = 0;
+    int unverified = 0;
+    char reason[64];
+
+    while ((opt = getopt(argc, argv, opt_string)) != -1) {
+        switch (opt) {
+        case 'f':
+            path = optarg;
+            break;
+        case 'v':
+            verify = true;
+            break;
+        case 's':
+            stop = true;
+            break;
+        case 'h':
+        case '?':
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("\t -f Read the manifest from a file instead of stdin\n");
+            printf("\t -v Verify the profile states with one profile list once all operations ran\n");
+            printf("\t -s Stop at the first failed operation\n");
+            return -1;
+        default:
+            break;
+        }
+    }
+
+    if (path == NULL && isatty(fileno(stdin))) {
+        jprint_error("This applet must be run with input redirection from a file or pipe.", NULL);
+        return -1;
+    }
+
+    fp = path != NULL ? fopen(path, "r") : stdin;
+    if (fp == NULL) {
+        jprint_error("fopen", path);
+        return -1;
+    }
+    if (batch_manifest_load(&manifest, fp) < 0) {
+        goto err;
+    }
+
+    notification_autoprocess_begin();
+
+    for (int i = 0; i < manifest.count; i++) {
+        struct batch_op *op = &manifest.ops[i];
+        cJSON *jdata;
+        int ret;
+
+        ret = batch_run(op);
+        op->done = ret == 0;
+
+        jdata = cJSON_CreateObject();
+        cJSON_AddNumberToObject(jdata, "index", i);
+        cJSON_AddStringOrNullToObject(jdata, "id", op->id);
+        cJSON_AddStringOrNullToObject(jdata, "reason", ret ? batch_reason(op->action, ret) : NULL);
+        jprint_progress_obj(batch_function_names[op->action], jdata);
+
+        if (ret) {
+            failed++;
+            if (stop) {
+                break;
+            }
+        }
+    }
+
+    // notifications of the operations that succeeded, even when others failed
+    notification_autoprocess_end();
+    notification_spool_autocapture();
+
+    if (verify && (unverified = batch_verify(&manifest)) < 0) {
+        goto err;
+    }
+
+    if (failed > 0) {
+        snprintf(reason, sizeof(reason), "%d of %d failed", failed, manifest.count);
+        jprint_error("profile_batch", reason);
+        goto err;
+    }
+    if (unverified > 0) {
+        snprintf(reason, sizeof(reason), "%d of %d not verified", unverified, manifest.count);
+        jprint_error("profile_batch_verify", reason);
+        goto err;
+    }
+
+    jprint_success(NULL);
+
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    if (fp != stdin) {
+        fclose(fp);
+    }
+    batch_manifest_free(&manifest);
+    return fret;
+}
+
+struct applet_entry applet_profile_batch = {
+    .name = "batch",
+    .main = applet_main,
+};
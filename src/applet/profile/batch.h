@@ -0,0 +1,5 @@
+#pragma once
+
+#include <applet.h>
+
+extern struct applet_entry applet_profile_batch;
@@ -1,4 +1,6 @@
 #include "delete.h"
+#include "applet/notification/autoprocess.h"
+#include "applet/notification/spool.h"
 #include "main.h"
 
 #include <euicc/es10c.h>
@@ -19,6 +21,8 @@ static int applet_main(int argc, char **argv) {
 
     param = argv[1];
 
+    notification_autoprocess_begin();
+
     ret = es10c_delete_profile(&euicc_ctx, param);
 
     if (ret) {
@@ -44,6 +48,9 @@ static int applet_main(int argc, char **argv) {
         return -1;
     }
 
+    notification_autoprocess_end();
+    notification_spool_autocapture();
+
     jprint_success(NULL);
 
     return 0;
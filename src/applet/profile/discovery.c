@@ -6,75 +6,206 @@
 #include <lpac/utils.h>
 
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-static const char *opt_string = "s:i:h?";
+static const char *opt_string = "s:i:Hh?";
+
+#define DISCOVERY_DEFAULT_SMDS "lpa.ds.gsma.com"
+// other well-known roots: "prod.smds.rsp.goog", "lpa.live.esimdiscovery.com"
+
+enum discovery_state {
+    DISCOVERY_PENDING,
+    DISCOVERY_INFLIGHT,
+    DISCOVERY_DONE,
+    DISCOVERY_FAILED,
+};
+
+struct discovery_root {
+    char *smds;
+    enum discovery_state state;
+    char **smdp_list;
+    const char *function;
+    char reason[128];
+};
+
+static int discovery_inflight = 0;
+
+static void discovery_fail(struct discovery_root *root, const char *function, const char *reason) {
+    root->state = DISCOVERY_FAILED;
+    root->function = function;
+    snprintf(root->reason, sizeof(root->reason), "%s", reason ? reason : "");
+}
+
+static void discovery_authenticated(struct euicc_ctx *ctx, int result, char **smdp_list, void *userdata) {
+    struct discovery_root *root = userdata;
+
+    if (result == 0) {
+        root->state = DISCOVERY_DONE;
+        root->smdp_list = smdp_list;
+    } else {
+        discovery_fail(root, "es11_authenticate_client", ctx->http.status.message);
+    }
+    discovery_inflight--;
+}
+
+static bool discovery_any_done(const struct discovery_root *roots, int count) {
+    for (int i = 0; i < count; i++) {
+        if (roots[i].state == DISCOVERY_DONE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The eUICC holds one RSP session at a time, so the challenge, initiateAuthentication and
+// AuthenticateServer legs run root after root. Only ES11 AuthenticateClient is left in flight,
+// overlapping with the sessions of the following roots.
+static void discovery_authenticate(struct discovery_root *root, const char *imei, bool async) {
+    const char *smds = root->smds;
+
+    euicc_ctx.http.server_address = smds;
+
+    jprint_progress("es10b_get_euicc_challenge_and_info", smds);
+    if (es10b_get_euicc_challenge_and_info(&euicc_ctx)) {
+        discovery_fail(root, "es10b_get_euicc_challenge_and_info", NULL);
+        goto exit;
+    }
+
+    jprint_progress("es9p_initiate_authentication", smds);
+    if (es9p_initiate_authentication(&euicc_ctx)) {
+        discovery_fail(root, "es9p_initiate_authentication", euicc_ctx.http.status.message);
+        goto exit;
+    }
+
+    jprint_progress("es10b_authenticate_server", smds);
+    if (es10b_authenticate_server(&euicc_ctx, NULL, imei)) {
+        discovery_fail(root, "es10b_authenticate_server", NULL);
+        goto exit;
+    }
+
+    jprint_progress("es11_authenticate_client", smds);
+    if (async) {
+        if (es11_authenticate_client_async_r(&euicc_ctx, smds, euicc_ctx.http._internal.transaction_id_http,
+                                             euicc_ctx.http._internal.b64_authenticate_server_response,
+                                             discovery_authenticated, root)
+            < 0) {
+            discovery_fail(root, "es11_authenticate_client", NULL);
+            goto exit;
+        }
+        root->state = DISCOVERY_INFLIGHT;
+        discovery_inflight++;
+    } else if (es11_authenticate_client(&euicc_ctx, &root->smdp_list)) {
+        discovery_fail(root, "es11_authenticate_client", euicc_ctx.http.status.message);
+    } else {
+        root->state = DISCOVERY_DONE;
+    }
+
+exit:
+    euicc_http_cleanup(&euicc_ctx);
+}
+
+static int discovery_add_root(struct discovery_root **roots, int *count, const char *list) {
+    // -s takes one address or a comma-separated list, and may be repeated
+    while (*list) {
+        const size_t len = strcspn(list, ",");
+        struct discovery_root *nroots;
+
+        if (len > 0) {
+            nroots = realloc(*roots, (*count + 1) * sizeof(**roots));
+            if (nroots == NULL) {
+                return -1;
+            }
+            *roots = nroots;
+            memset(&(*roots)[*count], 0, sizeof(**roots));
+            if (((*roots)[*count].smds = malloc(len + 1)) == NULL) {
+                return -1;
+            }
+            memcpy((*roots)[*count].smds, list, len);
+            (*roots)[*count].smds[len] = '\0';
+            (*count)++;
+        }
+        list += len;
+        if (*list == ',') {
+            list++;
+        }
+    }
+
+    return 0;
+}
 
 static int applet_main(int argc, char **argv) {
     int fret;
 
     int opt;
 
-    char *smds = NULL;
-    char *imei = NULL;
-
-    _cleanup_es11_smdp_list_ char **smdp_list = NULL;
+    _cleanup_free_ char *imei = NULL;
+    struct discovery_root *roots = NULL;
+    int roots_count = 0;
+    bool hedged = false;
+    bool async;
+    const struct discovery_root *failed = NULL;
 
     cJSON *jdata = NULL;
 
     while ((opt = getopt(argc, argv, opt_string)) != -1) {
         switch (opt) {
         case 's':
-            smds = strdup(optarg);
+            if (discovery_add_root(&roots, &roots_count, optarg) < 0) {
+                jprint_error("realloc", NULL);
+                goto err;
+            }
             break;
         case 'i':
+            free(imei);
             imei = strdup(optarg);
             break;
+        case 'H':
+            hedged = true;
+            break;
         case 'h':
         case '?':
             printf("Usage: %s [OPTIONS]\n", argv[0]);
-            printf("\t -s SM-DS Domain\n");
+            printf("\t -s SM-DS Domain, a comma-separated list or repeated to query several\n");
             printf("\t -i IMEI\n");
+            printf("\t -H Return the events of the first SM-DS that answers\n");
             printf("\t -h This help info\n");
-            return -1;
-            break;
+            fret = -1;
+            goto exit;
         }
-        opt = getopt(argc, argv, opt_string);
     }
 
-    if (smds == NULL) {
-        // smds = "prod.smds.rsp.goog";
-        // smds = "lpa.live.esimdiscovery.com";
-        smds = "lpa.ds.gsma.com";
-    }
-
-    euicc_ctx.http.server_address = smds;
-
-    jprint_progress("es10b_get_euicc_challenge_and_info", smds);
-    if (es10b_get_euicc_challenge_and_info(&euicc_ctx)) {
-        jprint_error("es10b_get_euicc_challenge_and_info", NULL);
+    if (roots_count == 0 && discovery_add_root(&roots, &roots_count, DISCOVERY_DEFAULT_SMDS) < 0) {
+        jprint_error("realloc", NULL);
         goto err;
     }
 
-    jprint_progress("es9p_initiate_authentication", smds);
-    if (es9p_initiate_authentication(&euicc_ctx)) {
-        jprint_error("es9p_initiate_authentication", euicc_ctx.http.status.message);
-        goto err;
+    async = roots_count > 1 && euicc_ctx.http.interface->async_submit != NULL;
+
+    // connect to every SM-DS while the eUICC works on the first challenge
+    for (int i = 0; i < roots_count; i++) {
+        es9p_prewarm_r(&euicc_ctx, roots[i].smds);
     }
 
-    jprint_progress("es10b_authenticate_server", smds);
-    if (es10b_authenticate_server(&euicc_ctx, NULL, imei)) {
-        jprint_error("es10b_authenticate_server", NULL);
-        goto err;
+    discovery_inflight = 0;
+    for (int i = 0; i < roots_count; i++) {
+        if (hedged && async) {
+            // collect the answers that arrived during the previous session
+            euicc_ctx.http.interface->async_dispatch(&euicc_ctx);
+        }
+        if (hedged && discovery_any_done(roots, roots_count)) {
+            break;
+        }
+        discovery_authenticate(&roots[i], imei, async);
     }
 
-    jprint_progress("es11_authenticate_client", smds);
-    if (es11_authenticate_client(&euicc_ctx, &smdp_list)) {
-        jprint_error("es11_authenticate_client", NULL);
-        goto err;
+    while (discovery_inflight > 0 && !(hedged && discovery_any_done(roots, roots_count))) {
+        if (euicc_ctx.http.interface->async_wait(&euicc_ctx, 1000) < 0) {
+            break;
+        }
     }
 
     jdata = cJSON_CreateArray();
@@ -82,15 +213,51 @@ static int applet_main(int argc, char **argv) {
         goto err;
     }
 
-    for (int i = 0; smdp_list[i] != NULL; i++) {
-        cJSON *jsmdp = cJSON_CreateString(smdp_list[i]);
-        if (jsmdp == NULL) {
-            goto err;
+    // the same SM-DP+ may be announced by several roots
+    for (int i = 0; i < roots_count; i++) {
+        const struct discovery_root *root = &roots[i];
+
+        if (root->state == DISCOVERY_FAILED) {
+            failed = root;
+            if (roots_count > 1) {
+                cJSON *jfailed = cJSON_CreateObject();
+                cJSON_AddStringOrNullToObject(jfailed, "smds", root->smds);
+                cJSON_AddStringOrNullToObject(jfailed, "function", root->function);
+                cJSON_AddStringOrNullToObject(jfailed, "reason", root->reason[0] ? root->reason : NULL);
+                jprint_progress_obj("discovery_failed", jfailed);
+            }
+            continue;
+        }
+        if (root->state != DISCOVERY_DONE) {
+            continue;
+        }
+        for (int j = 0; root->smdp_list[j] != NULL; j++) {
+            bool duplicate = false;
+            const cJSON *jsmdp;
+
+            cJSON_ArrayForEach(jsmdp, jdata) {
+                if (strcmp(jsmdp->valuestring, root->smdp_list[j]) == 0) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) {
+                cJSON_AddItemToArray(jdata, cJSON_CreateString(root->smdp_list[j]));
+            }
         }
-        cJSON_AddItemToArray(jdata, jsmdp);
+    }
+
+    if (!discovery_any_done(roots, roots_count)) {
+        if (failed != NULL) {
+            jprint_error(failed->function, failed->reason[0] ? failed->reason : NULL);
+        } else {
+            jprint_error("es11_authenticate_client", NULL);
+        }
+        goto err;
     }
 
     jprint_success(jdata);
+    jdata = NULL;
 
     fret = 0;
     goto exit;
@@ -98,6 +265,13 @@ static int applet_main(int argc, char **argv) {
 err:
     fret = -1;
 exit:
+    cJSON_Delete(jdata);
+    // requests abandoned by -H never call back once the applet returned
+    for (int i = 0; i < roots_count; i++) {
+        free(roots[i].smds);
+        es11_smdp_list_free_all(roots[i].smdp_list);
+    }
+    free(roots);
     euicc_http_cleanup(&euicc_ctx);
     return fret;
 }
@@ -1,14 +1,15 @@
 #include "download.h"
+#include "applet/notification/autoprocess.h"
+#include "applet/notification/spool.h"
 #include "main.h"
 
+#include <euicc/download.h>
 #include <euicc/es10a.h>
-#include <euicc/es10b.h>
-#include <euicc/es8p.h>
-#include <euicc/es9p.h>
 #include <euicc/tostr.h>
 #include <lpac/utils.h>
 
 #include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -17,14 +18,19 @@
 #include <string.h>
 #include <unistd.h>
 
-static const char *opt_string = "s:m:i:c:a:ph?";
+#ifndef _WIN32
+#    include <sys/resource.h>
+#endif
 
-static volatile int cancelled = 0;
+static const char *opt_string = "s:m:i:c:a:pb:h?";
 
-#define CANCELPOINT() \
-    if (cancelled) {  \
-        goto err;     \
-    }
+// large enough for the biggest single BPP segment plus the rest of the ES9+ response
+#define BPP_MEMORY_LIMIT_MIN (16 * 1024)
+// a package larger than this could not be held in memory without -b anyway
+#define BPP_MEMORY_LIMIT_MAX (1024 * 1024 * 1024)
+
+static volatile int cancelled = 0;
+static int interactive_preview = 0;
 
 #ifdef _WIN32
 // https://stackoverflow.com/a/58244503
@@ -65,6 +71,68 @@ static cJSON *build_download_result_json(const struct es10b_load_bound_profile_p
     return jdata;
 }
 
+static cJSON *build_memory_usage_json(void) {
+    cJSON *jdata = cJSON_CreateObject();
+    if (jdata == NULL) {
+        return NULL;
+    }
+    cJSON_AddNumberToObject(jdata, "limit", euicc_ctx.http.bpp_memory_limit);
+    cJSON_AddNumberToObject(jdata, "peak", euicc_ctx.http.bpp_memory_peak);
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // kilobytes on Linux and the BSDs, bytes on macOS
+#    ifdef __APPLE__
+        cJSON_AddNumberToObject(jdata, "maxRss", (double)usage.ru_maxrss);
+#    else
+        cJSON_AddNumberToObject(jdata, "maxRss", (double)usage.ru_maxrss * 1024);
+#    endif
+    }
+#endif
+    return jdata;
+}
+
+static int download_progress(__attribute__((unused)) struct euicc_ctx *ctx, enum euicc_download_stage stage,
+                             void *userdata) {
+    const char *smdp = userdata;
+
+    switch (stage) {
+    case EUICC_DOWNLOAD_STAGE_METADATA_PARSE:
+        // reported with its result by download_metadata
+        break;
+    default:
+        jprint_progress(euicc_download_stage2str(stage), smdp);
+        break;
+    }
+
+    return cancelled;
+}
+
+static int download_metadata(__attribute__((unused)) struct euicc_ctx *ctx,
+                             const struct es8p_metadata *profile_metadata, __attribute__((unused)) void *userdata) {
+    cJSON *jmetadata = cJSON_CreateObject();
+
+    cJSON_AddStringOrNullToObject(jmetadata, "iccid", profile_metadata->iccid);
+    cJSON_AddStringOrNullToObject(jmetadata, "serviceProviderName", profile_metadata->serviceProviderName);
+    cJSON_AddStringOrNullToObject(jmetadata, "profileName", profile_metadata->profileName);
+    cJSON_AddStringOrNullToObject(jmetadata, "iconType", euicc_icontype2str(profile_metadata->iconType));
+    cJSON_AddStringOrNullToObject(jmetadata, "icon", profile_metadata->icon);
+    cJSON_AddStringOrNullToObject(jmetadata, "profileClass", euicc_profileclass2str(profile_metadata->profileClass));
+
+    jprint_progress_obj(euicc_download_stage2str(EUICC_DOWNLOAD_STAGE_METADATA_PARSE), jmetadata);
+
+    if (interactive_preview) {
+        char c;
+        jprint_progress("preview", "y/n");
+        c = getchar();
+        if (c != 'y' && c != 'Y') {
+            cancelled = 1;
+        }
+    }
+
+    return cancelled;
+}
+
 static int applet_main(int argc, char **argv) {
     int fret;
     const char *error_function_name = NULL;
@@ -77,13 +145,11 @@ static int applet_main(int argc, char **argv) {
     char *imei = NULL;
     char *confirmation_code = NULL;
     char *activation_code = NULL;
-    int interactive_preview = 0;
+    char *end;
+    unsigned long limit_kib;
 
     _cleanup_(es10a_euicc_configured_addresses_free) struct es10a_euicc_configured_addresses configured_addresses = {0};
-    struct es10b_load_bound_profile_package_result download_result = {0};
-
-    cJSON *jmetadata = NULL;
-    _cleanup_(es8p_metadata_free) struct es8p_metadata *profile_metadata = NULL;
+    struct euicc_download_result download_result = {0};
 
     while ((opt = getopt(argc, argv, opt_string)) != -1) {
         switch (opt) {
@@ -108,6 +174,19 @@ static int applet_main(int argc, char **argv) {
         case 'p':
             interactive_preview = 1;
             break;
+        case 'b':
+            errno = 0;
+            limit_kib = strtoul(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' || limit_kib > BPP_MEMORY_LIMIT_MAX / 1024) {
+                printf("Invalid memory limit: %s\n", optarg);
+                return -1;
+            }
+            euicc_ctx.http.bpp_memory_limit = limit_kib * 1024;
+            if (euicc_ctx.http.bpp_memory_limit < BPP_MEMORY_LIMIT_MIN) {
+                printf("Memory limit must be at least %d KiB\n", BPP_MEMORY_LIMIT_MIN / 1024);
+                return -1;
+            }
+            break;
         case 'h':
         case '?':
             printf("Usage: %s [OPTIONS]\n", argv[0]);
@@ -117,6 +196,8 @@ static int applet_main(int argc, char **argv) {
             printf("\t -c Confirmation Code (Password)\n");
             printf("\t -a Activation Code (e.g: 'LPA:***')\n");
             printf("\t -p Interactive preview profile\n");
+            printf("\t -b Bounded-memory mode, spool the package to a temporary file and keep at most N KiB in "
+                   "memory\n");
             printf("\t -h This help info\n");
             return -1;
         default:
@@ -187,114 +268,67 @@ static int applet_main(int argc, char **argv) {
 
     signal(SIGINT, sigint_handler);
 
-    euicc_ctx.http.server_address = smdp;
-
-    CANCELPOINT();
-    jprint_progress("es10b_get_euicc_challenge_and_info", smdp);
-    if (es10b_get_euicc_challenge_and_info(&euicc_ctx)) {
-        error_function_name = "es10b_get_euicc_challenge_and_info";
-        error_detail = NULL;
-        goto err;
-    }
-
-    CANCELPOINT();
-    jprint_progress("es9p_initiate_authentication", smdp);
-    if (es9p_initiate_authentication(&euicc_ctx)) {
-        error_function_name = "es9p_initiate_authentication";
-        error_detail = strdup(euicc_ctx.http.status.message);
-        goto err;
-    }
-
-    CANCELPOINT();
-    jprint_progress("es10b_authenticate_server", smdp);
-    if (es10b_authenticate_server(&euicc_ctx, matchingId, imei)) {
-        error_function_name = "es10b_authenticate_server";
-        error_detail = NULL;
-        goto err;
-    }
+    // the eUICC holds one RSP session at a time, so the pending Notifications are listed before it opens
+    notification_autoprocess_begin();
+
+    struct euicc_download_param param = {
+        .smdp = smdp,
+        .matchingId = matchingId,
+        .imei = imei,
+        .confirmationCode = confirmation_code,
+        .progress = download_progress,
+        .metadata = download_metadata,
+        .preview = interactive_preview,
+        .userdata = smdp,
+    };
+
+    if (euicc_download(&euicc_ctx, &param, &download_result)) {
+        switch (download_result.stage) {
+        case EUICC_DOWNLOAD_STAGE_INITIATE_AUTHENTICATION:
+        case EUICC_DOWNLOAD_STAGE_AUTHENTICATE_CLIENT:
+        case EUICC_DOWNLOAD_STAGE_GET_BOUND_PROFILE_PACKAGE:
+            error_detail = strdup(euicc_ctx.http.status.message);
+            break;
+        case EUICC_DOWNLOAD_STAGE_LOAD_BOUND_PROFILE_PACKAGE: {
+            char buffer[256];
 
-    CANCELPOINT();
-    jprint_progress("es9p_authenticate_client", smdp);
-    if (es9p_authenticate_client(&euicc_ctx)) {
-        error_function_name = "es9p_authenticate_client";
-        error_detail = strdup(euicc_ctx.http.status.message);
-        goto err;
-    }
+            if (download_result.cancelled) {
+                break;
+            }
+            jprint_progress_obj("es10b_load_bound_profile_package:result",
+                                build_download_result_json(&download_result.bpp));
 
-    // preview here
-    if (euicc_ctx.http._internal.prepare_download_param->b64_profileMetadata) {
-        CANCELPOINT();
-        if (es8p_metadata_parse(&profile_metadata,
-                                euicc_ctx.http._internal.prepare_download_param->b64_profileMetadata)) {
-            error_function_name = "es8p_meatadata_parse";
-            error_detail = NULL;
-            goto err;
+            snprintf(buffer, sizeof(buffer), "%s,%s", euicc_bppcommandid2str(download_result.bpp.bppCommandId),
+                     euicc_errorreason2str(download_result.bpp.errorReason));
+            error_detail = strdup(buffer);
+            break;
         }
-
-        jmetadata = cJSON_CreateObject();
-
-        cJSON_AddStringOrNullToObject(jmetadata, "iccid", profile_metadata->iccid);
-        cJSON_AddStringOrNullToObject(jmetadata, "serviceProviderName", profile_metadata->serviceProviderName);
-        cJSON_AddStringOrNullToObject(jmetadata, "profileName", profile_metadata->profileName);
-        cJSON_AddStringOrNullToObject(jmetadata, "iconType", euicc_icontype2str(profile_metadata->iconType));
-        cJSON_AddStringOrNullToObject(jmetadata, "icon", profile_metadata->icon);
-        cJSON_AddStringOrNullToObject(jmetadata, "profileClass",
-                                      euicc_profileclass2str(profile_metadata->profileClass));
-
-        jprint_progress_obj("es8p_meatadata_parse", jmetadata);
-
-        if (interactive_preview) {
-            char c;
-            jprint_progress("preview", "y/n");
-            c = getchar();
-            if (c != 'y' && c != 'Y') {
-                cancelled = 1;
-            }
+        default:
+            break;
+        }
+        error_function_name = euicc_download_stage2str(download_result.stage);
+        if (download_result.cancelled) {
+            cancelled = 1;
         }
-    }
-
-    CANCELPOINT();
-    jprint_progress("es10b_prepare_download", smdp);
-    if (es10b_prepare_download(&euicc_ctx, confirmation_code)) {
-        error_function_name = "es10b_prepare_download";
-        error_detail = NULL;
         goto err;
     }
 
-    CANCELPOINT();
-    jprint_progress("es9p_get_bound_profile_package", smdp);
-    if (es9p_get_bound_profile_package(&euicc_ctx)) {
-        error_function_name = "es9p_get_bound_profile_package";
-        error_detail = strdup(euicc_ctx.http.status.message);
-        goto err;
+    if (euicc_ctx.http.bpp_memory_limit) {
+        jprint_progress_obj("bpp_memory", build_memory_usage_json());
     }
 
-    CANCELPOINT();
-    jprint_progress("es10b_load_bound_profile_package", smdp);
-    if (es10b_load_bound_profile_package(&euicc_ctx, &download_result)) {
-        jprint_progress_obj("es10b_load_bound_profile_package:result", build_download_result_json(&download_result));
-
-        char buffer[256];
-
-        snprintf(buffer, sizeof(buffer), "%s,%s", euicc_bppcommandid2str(download_result.bppCommandId),
-                 euicc_errorreason2str(download_result.errorReason));
-        error_function_name = "es10b_load_bound_profile_package";
-        error_detail = strdup(buffer);
-
-        goto err;
-    }
+    notification_autoprocess_end();
+    notification_spool_autocapture();
 
-    jprint_success(build_download_result_json(&download_result));
+    jprint_success(build_download_result_json(&download_result.bpp));
 
     fret = 0;
     goto exit;
 
 err:
     fret = -1;
-    jprint_progress("es10b_cancel_session", smdp);
-    es10b_cancel_session(&euicc_ctx, ES10B_CANCEL_SESSION_REASON_ENDUSERREJECTION);
-    jprint_progress("es9p_cancel_session", smdp);
-    es9p_cancel_session(&euicc_ctx);
+    // a failed LoadBoundProfilePackage leaves its installation result Notification behind
+    notification_autoprocess_end();
     if (!cancelled) {
         jprint_error(error_function_name, error_detail);
     } else {
@@ -1,4 +1,6 @@
 #include "enable.h"
+#include "applet/notification/autoprocess.h"
+#include "applet/notification/spool.h"
 #include "main.h"
 
 #include <euicc/es10c.h>
@@ -26,6 +28,8 @@ static int applet_main(int argc, char **argv) {
         refreshflag = atoi(argv[2]);
     }
 
+    notification_autoprocess_begin();
+
     ret = es10c_enable_profile(&euicc_ctx, param, refreshflag);
 
     if (ret) {
@@ -54,6 +58,9 @@ static int applet_main(int argc, char **argv) {
         return -1;
     }
 
+    notification_autoprocess_end();
+    notification_spool_autocapture();
+
     jprint_success(NULL);
 
     return 0;
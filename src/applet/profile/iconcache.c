@@ -0,0 +1,261 @@
+#include "iconcache.h"
+#include "main.h"
+
+#include <euicc/base64.h>
+#include <euicc/es10c.h>
+#include <euicc/hexutil.h>
+#include <euicc/sha256.h>
+#include <euicc/tostr.h>
+#include <lpac/utils.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#    include <direct.h>
+#endif
+
+#define ENV_ICON_CACHE "LPAC_ICON_CACHE"
+
+#define ICON_CACHE_INDEX "index.json"
+
+// Icons never change while a profile is installed, so the index maps "<iccid>:<isdpAid>" to the hash
+// of its icon. A listing then only needs the icons of profiles installed since the last one.
+struct icon_cache {
+    const char *path;
+    cJSON *index;
+    bool index_changed;
+};
+
+const char *icon_cache_path(void) {
+    const char *path = getenv(ENV_ICON_CACHE);
+
+    return path != NULL && path[0] != '\0' ? path : NULL;
+}
+
+static char *icon_cache_file(const struct icon_cache *cache, const char *name, const char *suffix) {
+    char *file = malloc(strlen(cache->path) + strlen(name) + strlen(suffix) + 3);
+
+    if (file != NULL) {
+        sprintf(file, "%s/%s%s%s", cache->path, name, suffix[0] ? "." : "", suffix);
+    }
+    return file;
+}
+
+static bool icon_cache_has_icon(const struct icon_cache *cache, const char *hash, enum es10c_icon_type iconType) {
+    _cleanup_free_ char *file = icon_cache_file(cache, hash, euicc_icontype2str(iconType));
+    struct stat st;
+
+    return file != NULL && stat(file, &st) == 0;
+}
+
+static void icon_cache_key(char *key, const struct es10c_profile_info_list *profile) {
+    sprintf(key, "%s:%s", profile->iccid, profile->isdpAid);
+}
+
+static int icon_cache_load(struct icon_cache *cache) {
+    _cleanup_free_ char *file = icon_cache_file(cache, ICON_CACHE_INDEX, "");
+    _cleanup_free_ char *data = NULL;
+    FILE *fp;
+    long size;
+
+#ifndef _WIN32
+    if (mkdir(cache->path, 0700) != 0 && errno != EEXIST) {
+#else
+    if (_mkdir(cache->path) != 0 && errno != EEXIST) {
+#endif
+        return -1;
+    }
+
+    if (file == NULL) {
+        return -1;
+    }
+    if ((fp = fopen(file, "rb")) != NULL) {
+        if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0
+            && (data = malloc(size)) != NULL && fread(data, 1, size, fp) == (size_t)size) {
+            cache->index = cJSON_ParseWithLength(data, size);
+        }
+        fclose(fp);
+    }
+    // a missing or damaged index only costs one listing with icons
+    if (!cJSON_IsObject(cache->index)) {
+        cJSON_Delete(cache->index);
+        cache->index = cJSON_CreateObject();
+    }
+
+    return cache->index != NULL ? 0 : -1;
+}
+
+static int icon_cache_save(struct icon_cache *cache) {
+    _cleanup_free_ char *file = icon_cache_file(cache, ICON_CACHE_INDEX, "");
+    _cleanup_free_ char *tmp_file = icon_cache_file(cache, ICON_CACHE_INDEX, "tmp");
+    _cleanup_free_ char *data = cJSON_PrintUnformatted(cache->index);
+    FILE *fp;
+
+    if (file == NULL || tmp_file == NULL || data == NULL || (fp = fopen(tmp_file, "wb")) == NULL) {
+        return -1;
+    }
+    if (fwrite(data, 1, strlen(data), fp) != strlen(data)) {
+        fclose(fp);
+        remove(tmp_file);
+        return -1;
+    }
+    if (fclose(fp) != 0 || rename_replace(tmp_file, file) != 0) {
+        remove(tmp_file);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Writes the decoded icon under its hash unless an identical one is already there
+static char *icon_cache_store(const struct icon_cache *cache, const char *b64_icon, enum es10c_icon_type iconType) {
+    _cleanup_free_ uint8_t *icon = NULL;
+    _cleanup_free_ char *file = NULL;
+    _cleanup_free_ char *tmp_file = NULL;
+    uint8_t digest[SHA256_BLOCK_SIZE];
+    char hash[(SHA256_BLOCK_SIZE * 2) + 1];
+    EUICC_SHA256_CTX sha256ctx;
+    FILE *fp;
+    int icon_len;
+
+    icon = malloc(euicc_base64_decode_len(b64_icon));
+    if (icon == NULL || (icon_len = euicc_base64_decode(icon, b64_icon)) < 0) {
+        return NULL;
+    }
+
+    euicc_sha256_init(&sha256ctx);
+    euicc_sha256_update(&sha256ctx, icon, icon_len);
+    euicc_sha256_final(&sha256ctx, digest);
+    euicc_hexutil_bin2hex(hash, sizeof(hash), digest, sizeof(digest));
+
+    if (icon_cache_has_icon(cache, hash, iconType)) {
+        return strdup(hash);
+    }
+
+    file = icon_cache_file(cache, hash, euicc_icontype2str(iconType));
+    tmp_file = icon_cache_file(cache, hash, "tmp");
+    if (file == NULL || tmp_file == NULL || (fp = fopen(tmp_file, "wb")) == NULL) {
+        return NULL;
+    }
+    if (fwrite(icon, 1, icon_len, fp) != (size_t)icon_len) {
+        fclose(fp);
+        remove(tmp_file);
+        return NULL;
+    }
+    if (fclose(fp) != 0 || rename_replace(tmp_file, file) != 0) {
+        remove(tmp_file);
+        return NULL;
+    }
+
+    return strdup(hash);
+}
+
+// Only the icons of the profiles that missed the cache are read, in one more listing
+static int icon_cache_fetch(struct icon_cache *cache, struct es10c_profile_info_list *profiles) {
+    static const uint8_t tagList[] = {0x5A, 0x4F, 0x93, 0x94};
+    _cleanup_es10c_profile_info_list_ struct es10c_profile_info_list *icons = NULL;
+    struct es10c_profile_info_list *p, *q;
+    char key[(10 * 2) + (16 * 2) + 2];
+
+    if (es10c_get_profiles_info_taglist(&euicc_ctx, tagList, sizeof(tagList), &icons)) {
+        return -1;
+    }
+
+    for (p = profiles; p != NULL; p = p->next) {
+        if (p->icon != NULL || p->iconType == ES10C_ICON_TYPE_NULL) {
+            continue;
+        }
+        for (q = icons; q != NULL; q = q->next) {
+            if (strcmp(q->isdpAid, p->isdpAid) == 0) {
+                break;
+            }
+        }
+        if (q == NULL || q->icon == NULL) {
+            continue;
+        }
+        if ((p->icon = icon_cache_store(cache, q->icon, p->iconType)) == NULL) {
+            return -1;
+        }
+        icon_cache_key(key, p);
+        cJSON_DeleteItemFromObjectCaseSensitive(cache->index, key);
+        cJSON_AddStringToObject(cache->index, key, p->icon);
+        cache->index_changed = true;
+    }
+
+    return 0;
+}
+
+int icon_cache_get_profiles_info(struct es10c_profile_info_list **profileInfoList) {
+    // everything but the icon
+    static const uint8_t tagList[] = {0x5A, 0x4F, 0x9F, 0x70, 0x90, 0x91, 0x92, 0x93, 0x95};
+    struct icon_cache cache = {
+        .path = icon_cache_path(),
+    };
+    struct es10c_profile_info_list *p;
+    cJSON *jentry, *jnext;
+    char key[(10 * 2) + (16 * 2) + 2];
+    bool missing = false;
+    int fret = 0;
+
+    *profileInfoList = NULL;
+
+    if (cache.path == NULL || icon_cache_load(&cache) < 0) {
+        goto err;
+    }
+
+    if (es10c_get_profiles_info_taglist(&euicc_ctx, tagList, sizeof(tagList), profileInfoList)) {
+        goto err;
+    }
+
+    for (p = *profileInfoList; p != NULL; p = p->next) {
+        const char *hash;
+
+        if (p->iconType == ES10C_ICON_TYPE_NULL) {
+            continue;
+        }
+        icon_cache_key(key, p);
+        hash = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cache.index, key));
+        if (hash != NULL && icon_cache_has_icon(&cache, hash, p->iconType)) {
+            p->icon = strdup(hash);
+        }
+        missing |= p->icon == NULL;
+    }
+
+    if (missing && icon_cache_fetch(&cache, *profileInfoList) < 0) {
+        goto err;
+    }
+
+    // forget deleted profiles, their icons stay for profiles that share them
+    for (jentry = cache.index->child; jentry != NULL; jentry = jnext) {
+        jnext = jentry->next;
+        for (p = *profileInfoList; p != NULL; p = p->next) {
+            icon_cache_key(key, p);
+            if (strcmp(key, jentry->string) == 0) {
+                break;
+            }
+        }
+        if (p == NULL) {
+            cJSON_Delete(cJSON_DetachItemViaPointer(cache.index, jentry));
+            cache.index_changed = true;
+        }
+    }
+
+    if (cache.index_changed && icon_cache_save(&cache) < 0) {
+        goto err;
+    }
+
+    goto exit;
+
+err:
+    fret = -1;
+    es10c_profile_info_list_free_all(*profileInfoList);
+    *profileInfoList = NULL;
+exit:
+    cJSON_Delete(cache.index);
+    return fret;
+}
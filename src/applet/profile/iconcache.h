@@ -0,0 +1,10 @@
+#pragma once
+
+#include <euicc/es10c.h>
+
+// Directory of the icon cache from LPAC_ICON_CACHE, NULL when icons are listed inline
+const char *icon_cache_path(void);
+
+// Lists the profiles without transferring icons the cache already holds. Icons are stored once as
+// <dir>/<sha256>.<iconType>, and the icon member holds that SHA-256 in hex instead of base64.
+int icon_cache_get_profiles_info(struct es10c_profile_info_list **profileInfoList);
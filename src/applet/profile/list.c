@@ -1,10 +1,12 @@
 #include "list.h"
+#include "iconcache.h"
 #include "main.h"
 
 #include <euicc/es10c.h>
 #include <euicc/tostr.h>
 #include <lpac/utils.h>
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,35 +15,50 @@
 static int applet_main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv) {
     _cleanup_es10c_profile_info_list_ struct es10c_profile_info_list *profiles;
     struct es10c_profile_info_list *rptr;
-    cJSON *jdata = NULL;
+    const bool icon_cache = icon_cache_path() != NULL;
 
-    if (es10c_get_profiles_info(&euicc_ctx, &profiles)) {
+    if (icon_cache) {
+        if (icon_cache_get_profiles_info(&profiles)) {
+            jprint_error("icon_cache_get_profiles_info", NULL);
+            return -1;
+        }
+    } else if (es10c_get_profiles_info(&euicc_ctx, &profiles)) {
         jprint_error("es10c_get_profiles_info", NULL);
         return -1;
     }
 
-    jdata = cJSON_CreateArray();
-    rptr = profiles;
-
-    while (rptr) {
-        cJSON *jprofile = NULL;
-
-        jprofile = cJSON_CreateObject();
-        cJSON_AddStringOrNullToObject(jprofile, "iccid", rptr->iccid);
-        cJSON_AddStringOrNullToObject(jprofile, "isdpAid", rptr->isdpAid);
-        cJSON_AddStringOrNullToObject(jprofile, "profileState", euicc_profilestate2str(rptr->profileState));
-        cJSON_AddStringOrNullToObject(jprofile, "profileNickname", rptr->profileNickname);
-        cJSON_AddStringOrNullToObject(jprofile, "serviceProviderName", rptr->serviceProviderName);
-        cJSON_AddStringOrNullToObject(jprofile, "profileName", rptr->profileName);
-        cJSON_AddStringOrNullToObject(jprofile, "iconType", euicc_icontype2str(rptr->iconType));
-        cJSON_AddStringOrNullToObject(jprofile, "icon", rptr->icon);
-        cJSON_AddStringOrNullToObject(jprofile, "profileClass", euicc_profileclass2str(rptr->profileClass));
-        cJSON_AddItemToArray(jdata, jprofile);
-
-        rptr = rptr->next;
+    jprint_success_stream_begin();
+    json_writer_array_begin();
+
+    for (rptr = profiles; rptr != NULL; rptr = rptr->next) {
+        json_writer_object_begin();
+        json_writer_key("iccid");
+        json_writer_string(rptr->iccid);
+        json_writer_key("isdpAid");
+        json_writer_string(rptr->isdpAid);
+        json_writer_key("profileState");
+        json_writer_string(euicc_profilestate2str(rptr->profileState));
+        json_writer_key("profileNickname");
+        json_writer_string(rptr->profileNickname);
+        json_writer_key("serviceProviderName");
+        json_writer_string(rptr->serviceProviderName);
+        json_writer_key("profileName");
+        json_writer_string(rptr->profileName);
+        json_writer_key("iconType");
+        json_writer_string(euicc_icontype2str(rptr->iconType));
+        json_writer_key("icon");
+        json_writer_string(icon_cache ? NULL : rptr->icon);
+        if (icon_cache) {
+            json_writer_key("iconHash");
+            json_writer_string(rptr->icon);
+        }
+        json_writer_key("profileClass");
+        json_writer_string(euicc_profileclass2str(rptr->profileClass));
+        json_writer_object_end();
     }
 
-    jprint_success(jdata);
+    json_writer_array_end();
+    jprint_success_stream_end();
 
     return 0;
 }
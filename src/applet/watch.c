@@ -0,0 +1,316 @@
+#include "watch.h"
+#include "main.h"
+
+#include <euicc/es10b.h>
+#include <euicc/es10c.h>
+#include <euicc/tostr.h>
+#include <lpac/utils.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WATCH_INTERVAL_DEFAULT 2000
+#define WATCH_INTERVAL_MAX_DEFAULT 30000
+
+static volatile sig_atomic_t stopped = 0;
+
+static void sigint_handler(__attribute__((unused)) int s) {
+    stopped = 1;
+}
+
+// What a poll remembers of each profile and notification, enough to tell what changed
+struct watch_profile {
+    char iccid[(10 * 2) + 1];
+    enum es10c_profile_state profileState;
+};
+
+struct watch_notification {
+    uint32_t seqNumber;
+    enum es10b_profile_management_operation profileManagementOperation;
+    char iccid[(10 * 2) + 1];
+};
+
+struct watch_state {
+    struct watch_profile *profiles;
+    int profiles_count;
+    struct watch_notification *notifications;
+    int notifications_count;
+};
+
+static void watch_state_free(struct watch_state *state) {
+    free(state->profiles);
+    free(state->notifications);
+    memset(state, 0, sizeof(*state));
+}
+
+static int watch_poll_profiles(struct watch_state *state) {
+    // ICCID and profileState only, no names or icons
+    static const uint8_t tagList[] = {0x5A, 0x9F, 0x70};
+    _cleanup_es10c_profile_info_list_ struct es10c_profile_info_list *profiles = NULL;
+    struct es10c_profile_info_list *rptr;
+    int count = 0;
+
+    if (es10c_get_profiles_info_taglist(&euicc_ctx, tagList, sizeof(tagList), &profiles)) {
+        jprint_error("es10c_get_profiles_info", NULL);
+        return -1;
+    }
+
+    for (rptr = profiles; rptr != NULL; rptr = rptr->next) {
+        count++;
+    }
+    state->profiles = calloc(count ? count : 1, sizeof(*state->profiles));
+    if (state->profiles == NULL) {
+        jprint_error("calloc", NULL);
+        return -1;
+    }
+    for (rptr = profiles; rptr != NULL; rptr = rptr->next) {
+        struct watch_profile *profile = &state->profiles[state->profiles_count++];
+
+        memcpy(profile->iccid, rptr->iccid, sizeof(profile->iccid));
+        profile->profileState = rptr->profileState;
+    }
+
+    return 0;
+}
+
+static int watch_poll_notifications(struct watch_state *state) {
+    _cleanup_es10b_notification_metadata_list_ struct es10b_notification_metadata_list *notifications = NULL;
+    struct es10b_notification_metadata_list *rptr;
+    int count = 0;
+
+    if (es10b_list_notification(&euicc_ctx, &notifications)) {
+        jprint_error("es10b_list_notification", NULL);
+        return -1;
+    }
+
+    for (rptr = notifications; rptr != NULL; rptr = rptr->next) {
+        count++;
+    }
+    state->notifications = calloc(count ? count : 1, sizeof(*state->notifications));
+    if (state->notifications == NULL) {
+        jprint_error("calloc", NULL);
+        return -1;
+    }
+    for (rptr = notifications; rptr != NULL; rptr = rptr->next) {
+        struct watch_notification *notification = &state->notifications[state->notifications_count++];
+
+        notification->seqNumber = rptr->seqNumber;
+        notification->profileManagementOperation = rptr->profileManagementOperation;
+        if (rptr->iccid != NULL) {
+            snprintf(notification->iccid, sizeof(notification->iccid), "%s", rptr->iccid);
+        }
+    }
+
+    return 0;
+}
+
+static const struct watch_profile *watch_find_profile(const struct watch_state *state, const char *iccid) {
+    for (int i = 0; i < state->profiles_count; i++) {
+        if (strcmp(state->profiles[i].iccid, iccid) == 0) {
+            return &state->profiles[i];
+        }
+    }
+    return NULL;
+}
+
+static const struct watch_notification *watch_find_notification(const struct watch_state *state,
+                                                                uint32_t seqNumber) {
+    for (int i = 0; i < state->notifications_count; i++) {
+        if (state->notifications[i].seqNumber == seqNumber) {
+            return &state->notifications[i];
+        }
+    }
+    return NULL;
+}
+
+static int watch_diff_profiles(const struct watch_state *last, const struct watch_state *current) {
+    int changes = 0;
+
+    for (int i = 0; i < current->profiles_count; i++) {
+        const struct watch_profile *profile = &current->profiles[i];
+        const struct watch_profile *previous = watch_find_profile(last, profile->iccid);
+        cJSON *jdata;
+
+        if (previous != NULL && previous->profileState == profile->profileState) {
+            continue;
+        }
+        jdata = cJSON_CreateObject();
+        cJSON_AddStringOrNullToObject(jdata, "iccid", profile->iccid);
+        cJSON_AddStringOrNullToObject(jdata, "profileState", euicc_profilestate2str(profile->profileState));
+        jprint_progress_obj(previous == NULL ? "profile_added" : "profile_state", jdata);
+        changes++;
+    }
+    for (int i = 0; i < last->profiles_count; i++) {
+        cJSON *jdata;
+
+        if (watch_find_profile(current, last->profiles[i].iccid) != NULL) {
+            continue;
+        }
+        jdata = cJSON_CreateObject();
+        cJSON_AddStringOrNullToObject(jdata, "iccid", last->profiles[i].iccid);
+        jprint_progress_obj("profile_removed", jdata);
+        changes++;
+    }
+
+    return changes;
+}
+
+static int watch_diff_notifications(const struct watch_state *last, const struct watch_state *current) {
+    int changes = 0;
+
+    for (int i = 0; i < current->notifications_count; i++) {
+        const struct watch_notification *notification = &current->notifications[i];
+        cJSON *jdata;
+
+        if (watch_find_notification(last, notification->seqNumber) != NULL) {
+            continue;
+        }
+        jdata = cJSON_CreateObject();
+        cJSON_AddNumberToObject(jdata, "seqNumber", notification->seqNumber);
+        cJSON_AddStringOrNullToObject(jdata, "profileManagementOperation",
+                                      euicc_profilemanagementoperation2str(notification->profileManagementOperation));
+        cJSON_AddStringOrNullToObject(jdata, "iccid", notification->iccid[0] ? notification->iccid : NULL);
+        jprint_progress_obj("notification_added", jdata);
+        changes++;
+    }
+    for (int i = 0; i < last->notifications_count; i++) {
+        cJSON *jdata;
+
+        if (watch_find_notification(current, last->notifications[i].seqNumber) != NULL) {
+            continue;
+        }
+        jdata = cJSON_CreateObject();
+        cJSON_AddNumberToObject(jdata, "seqNumber", last->notifications[i].seqNumber);
+        jprint_progress_obj("notification_removed", jdata);
+        changes++;
+    }
+
+    return changes;
+}
+
+// Returns early when interrupted, so ^C does not wait out a long backoff
+static void watch_sleep_ms(long ms) {
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (ms % 1000) * 1000000,
+    };
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR && !stopped) {
+    }
+}
+
+static int applet_main(int argc, char **argv) {
+    static const char *opt_string = "i:m:c:pnh?";
+
+    int fret = 0;
+    int opt = 0;
+    long interval_min = WATCH_INTERVAL_DEFAULT;
+    long interval_max = WATCH_INTERVAL_MAX_DEFAULT;
+    long interval;
+    long polls = 0;
+    bool profiles = true;
+    bool notifications = true;
+    struct watch_state last = {0};
+    struct watch_state current = {0};
+
+    while ((opt = getopt(argc, argv, opt_string)) != -1) {
+        switch (opt) {
+        case 'i':
+            interval_min = atol(optarg);
+            if (interval_min < 1) {
+                printf("Poll interval must be at least 1 ms\n");
+                return -1;
+            }
+            break;
+        case 'm':
+            interval_max = atol(optarg);
+            break;
+        case 'c':
+            polls = atol(optarg);
+            break;
+        case 'p':
+            notifications = false;
+            break;
+        case 'n':
+            profiles = false;
+            break;
+        case 'h':
+        case '?':
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("\t -i Poll interval in ms (default: %d)\n", WATCH_INTERVAL_DEFAULT);
+            printf("\t -m Longest poll interval in ms while nothing changes (default: %d)\n",
+                   WATCH_INTERVAL_MAX_DEFAULT);
+            printf("\t -c Stop after N polls (default: until interrupted)\n");
+            printf("\t -p Only watch profiles\n");
+            printf("\t -n Only watch notifications\n");
+            return -1;
+        default:
+            break;
+        }
+    }
+    if (interval_max < interval_min) {
+        interval_max = interval_min;
+    }
+
+    if (main_init_euicc() != 0) {
+        return -1;
+    }
+
+    signal(SIGINT, sigint_handler);
+
+    // the first poll reports everything as added
+    interval = interval_min;
+    for (long poll = 0; !stopped && (polls <= 0 || poll < polls); poll++) {
+        int changes = 0;
+
+        if (poll > 0) {
+            watch_sleep_ms(interval);
+            if (stopped) {
+                break;
+            }
+        }
+
+        if ((profiles && watch_poll_profiles(&current) < 0)
+            || (notifications && watch_poll_notifications(&current) < 0)) {
+            goto err;
+        }
+        if (profiles) {
+            changes += watch_diff_profiles(&last, &current);
+        }
+        if (notifications) {
+            changes += watch_diff_notifications(&last, &current);
+        }
+        watch_state_free(&last);
+        last = current;
+        memset(&current, 0, sizeof(current));
+
+        // back off while the eUICC is idle, poll quickly again once something changed
+        if (changes > 0) {
+            interval = interval_min;
+        } else if (interval < interval_max) {
+            interval = interval * 2 < interval_max ? interval * 2 : interval_max;
+        }
+    }
+
+    jprint_success(NULL);
+
+    goto exit;
+
+err:
+    fret = -1;
+exit:
+    watch_state_free(&last);
+    watch_state_free(&current);
+    return fret;
+}
+
+struct applet_entry applet_watch = {
+    .name = "watch",
+    .main = applet_main,
+};
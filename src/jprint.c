@@ -1,4 +1,5 @@
 #include "jprint.h"
+#include "main.h"
 
 #include <lpac/utils.h>
 
@@ -7,90 +8,165 @@
 #include <string.h>
 #include <unistd.h>
 
-void jprint_error(const char *function_name, const char *detail) {
-    _cleanup_cjson_ cJSON *jroot = NULL;
-    cJSON *jpayload = NULL;
-    _cleanup_free_ char *jstr = NULL;
+static void jprint_header(const char *type, const int code, const char *message) {
+    json_writer_object_begin();
+    json_writer_key("type");
+    json_writer_string(type);
+    json_writer_key("payload");
+    json_writer_object_begin();
+    json_writer_key("code");
+    json_writer_number(code);
+    json_writer_key("message");
+    json_writer_string(message);
+    json_writer_key("data");
+}
 
-    if (detail == NULL) {
-        detail = "";
+static void jprint_footer(void) {
+    json_writer_object_end();
+    json_writer_object_end();
+    json_writer_line_end();
+}
+
+#define ENV_HTTP_STATS "LPAC_HTTP_STATS"
+
+static struct {
+    int enabled; // -1: not read from the environment yet
+    uint32_t reported;
+    char function_name[128];
+} jprint_http = {.enabled = -1};
+
+static bool jprint_http_enabled(void) {
+    if (jprint_http.enabled < 0) {
+        jprint_http.enabled = getenv_or_default(ENV_HTTP_STATS, (bool)false);
     }
+    return jprint_http.enabled;
+}
+
+static void jprint_transfer_info(const struct euicc_http_transfer_info *info) {
+    json_writer_key("bytesSent");
+    json_writer_number(info->bytes_sent);
+    json_writer_key("bytesReceived");
+    json_writer_number(info->bytes_received);
+    json_writer_key("bytesReceivedWire");
+    json_writer_number(info->bytes_received_wire);
+    json_writer_key("nameLookupUs");
+    json_writer_number(info->time_namelookup_us);
+    json_writer_key("connectUs");
+    json_writer_number(info->time_connect_us);
+    json_writer_key("tlsUs");
+    json_writer_number(info->time_tls_us);
+    json_writer_key("firstByteUs");
+    json_writer_number(info->time_first_byte_us);
+    json_writer_key("totalUs");
+    json_writer_number(info->time_total_us);
+}
 
-    jroot = cJSON_CreateObject();
-    cJSON_AddStringOrNullToObject(jroot, "type", "lpa");
-    jpayload = cJSON_CreateObject();
-    cJSON_AddNumberToObject(jpayload, "code", -1);
-    cJSON_AddStringOrNullToObject(jpayload, "message", function_name);
-    cJSON_AddStringOrNullToObject(jpayload, "data", detail);
-    cJSON_AddItemToObject(jroot, "payload", jpayload);
+// Reports each HTTP request made since the previous message as "<last progress>:http",
+// so every ES9+/ES11 step is followed by its timing without touching the applets.
+static void jprint_http_pending(void) {
+    char message[sizeof(jprint_http.function_name) + 5];
+    uint32_t skipped = 0;
 
-    jstr = cJSON_PrintUnformatted(jroot);
+    if (!jprint_http_enabled() || euicc_ctx.http.stats.requests == jprint_http.reported) {
+        return;
+    }
+    // only the most recent requests are kept one by one, the older ones are still in http_stats
+    if (euicc_ctx.http.stats.requests - jprint_http.reported > EUICC_HTTP_STATS_RECENT) {
+        skipped = euicc_ctx.http.stats.requests - jprint_http.reported - EUICC_HTTP_STATS_RECENT;
+        jprint_http.reported += skipped;
+    }
 
-    printf("%s\n", jstr);
-    fflush(stdout);
+    snprintf(message, sizeof(message), "%s:http", jprint_http.function_name);
+    for (; jprint_http.reported != euicc_ctx.http.stats.requests; jprint_http.reported++) {
+        const struct euicc_http_request_stats *request =
+            &euicc_ctx.http.stats.recent[jprint_http.reported % EUICC_HTTP_STATS_RECENT];
+
+        jprint_header("progress", 0, message);
+        json_writer_object_begin();
+        json_writer_key("host");
+        json_writer_string(request->host);
+        jprint_transfer_info(&request->transfer);
+        if (skipped) {
+            json_writer_key("skipped");
+            json_writer_number(skipped);
+            skipped = 0;
+        }
+        json_writer_object_end();
+        jprint_footer();
+    }
 }
 
-void jprint_progress(const char *function_name, const char *detail) {
-    _cleanup_cjson_ cJSON *jroot = NULL;
-    cJSON *jpayload = NULL;
-    _cleanup_free_ char *jstr = NULL;
-
-    jroot = cJSON_CreateObject();
-    cJSON_AddStringOrNullToObject(jroot, "type", "progress");
-    jpayload = cJSON_CreateObject();
-    cJSON_AddNumberToObject(jpayload, "code", 0);
-    cJSON_AddStringOrNullToObject(jpayload, "message", function_name);
-    cJSON_AddStringOrNullToObject(jpayload, "data", detail);
-    cJSON_AddItemToObject(jroot, "payload", jpayload);
-
-    jstr = cJSON_PrintUnformatted(jroot);
-
-    printf("%s\n", jstr);
-    fflush(stdout);
+void jprint_http_stats(void) {
+    jprint_http_pending();
+
+    if (!jprint_http_enabled() || euicc_ctx.http.stats.requests == 0) {
+        return;
+    }
+
+    jprint_header("progress", 0, "http_stats");
+    json_writer_object_begin();
+    json_writer_key("requests");
+    json_writer_number(euicc_ctx.http.stats.requests);
+    jprint_transfer_info(&euicc_ctx.http.stats.transfer);
+    json_writer_key("hosts");
+    json_writer_array_begin();
+    for (const struct euicc_http_host_stats *host = euicc_ctx.http.stats.hosts; host != NULL; host = host->next) {
+        json_writer_object_begin();
+        json_writer_key("host");
+        json_writer_string(host->host);
+        json_writer_key("requests");
+        json_writer_number(host->requests);
+        jprint_transfer_info(&host->transfer);
+        json_writer_object_end();
+    }
+    json_writer_array_end();
+    json_writer_object_end();
+    jprint_footer();
 }
 
-void jprint_progress_obj(const char *function_name, cJSON *jdata) {
-    _cleanup_cjson_ cJSON *jroot = NULL;
-    cJSON *jpayload = NULL;
-    _cleanup_free_ char *jstr = NULL;
-
-    jroot = cJSON_CreateObject();
-    cJSON_AddStringOrNullToObject(jroot, "type", "progress");
-    jpayload = cJSON_CreateObject();
-    cJSON_AddNumberToObject(jpayload, "code", 0);
-    cJSON_AddStringOrNullToObject(jpayload, "message", function_name);
-    if (jdata) {
-        cJSON_AddItemToObject(jpayload, "data", jdata);
-    } else {
-        cJSON_AddNullToObject(jpayload, "data");
+void jprint_error(const char *function_name, const char *detail) {
+    if (detail == NULL) {
+        detail = "";
     }
-    cJSON_AddItemToObject(jroot, "payload", jpayload);
 
-    jstr = cJSON_PrintUnformatted(jroot);
+    jprint_http_pending();
+    jprint_header("lpa", -1, function_name);
+    json_writer_string(detail);
+    jprint_footer();
+    // report errors right away regardless of the flush mode
+    json_writer_flush();
+}
+
+void jprint_progress(const char *function_name, const char *detail) {
+    jprint_http_pending();
+    snprintf(jprint_http.function_name, sizeof(jprint_http.function_name), "%s", function_name);
+    jprint_header("progress", 0, function_name);
+    json_writer_string(detail);
+    jprint_footer();
+}
+
+void jprint_progress_obj(const char *function_name, cJSON *jdata) {
+    _cleanup_cjson_ cJSON *jowned = jdata;
 
-    printf("%s\n", jstr);
-    fflush(stdout);
+    jprint_http_pending();
+    snprintf(jprint_http.function_name, sizeof(jprint_http.function_name), "%s", function_name);
+    jprint_header("progress", 0, function_name);
+    json_writer_cjson(jowned);
+    jprint_footer();
 }
 
 void jprint_success(cJSON *jdata) {
-    _cleanup_cjson_ cJSON *jroot = NULL;
-    cJSON *jpayload = NULL;
-    _cleanup_free_ char *jstr = NULL;
-
-    jroot = cJSON_CreateObject();
-    cJSON_AddStringOrNullToObject(jroot, "type", "lpa");
-    jpayload = cJSON_CreateObject();
-    cJSON_AddNumberToObject(jpayload, "code", 0);
-    cJSON_AddStringOrNullToObject(jpayload, "message", "success");
-    if (jdata) {
-        cJSON_AddItemToObject(jpayload, "data", jdata);
-    } else {
-        cJSON_AddNullToObject(jpayload, "data");
-    }
-    cJSON_AddItemToObject(jroot, "payload", jpayload);
+    _cleanup_cjson_ cJSON *jowned = jdata;
 
-    jstr = cJSON_PrintUnformatted(jroot);
+    jprint_http_pending();
+    jprint_header("lpa", 0, "success");
+    json_writer_cjson(jowned);
+    jprint_footer();
+}
 
-    printf("%s\n", jstr);
-    fflush(stdout);
+void jprint_success_stream_begin(void) {
+    jprint_http_pending();
+    jprint_header("lpa", 0, "success");
 }
+
+void jprint_success_stream_end(void) { jprint_footer(); }
@@ -6,3 +6,8 @@ void jprint_error(const char *function_name, const char *detail);
 void jprint_progress(const char *function_name, const char *detail);
 void jprint_progress_obj(const char *function_name, cJSON *jdata);
 void jprint_success(cJSON *jdata);
+// Streams a success line, the data value is written with json_writer_* between the two calls
+void jprint_success_stream_begin(void);
+void jprint_success_stream_end(void);
+// With LPAC_HTTP_STATS set, prints the HTTP totals per server collected in euicc_ctx
+void jprint_http_stats(void);
@@ -5,6 +5,7 @@
 #include "applet/notification.h"
 #include "applet/profile.h"
 #include "applet/version.h"
+#include "applet/watch.h"
 
 #include <locale.h>
 #include <stdio.h>
@@ -58,7 +59,7 @@ struct applet_entry driver_applet = {
 };
 
 static const struct applet_entry *applets[] = {
-    &driver_applet, &applet_chip, &applet_profile, &applet_notification, &applet_version, NULL,
+    &driver_applet, &applet_chip, &applet_profile, &applet_notification, &applet_version, &applet_watch, NULL,
 };
 
 static int euicc_ctx_inited = 0;
@@ -175,6 +176,8 @@ int main(int argc, char **argv) {
 
     ret = applet_entry(argc, argv, applets);
 
+    jprint_http_stats();
+
     main_fini_euicc();
 
     euicc_driver_fini();
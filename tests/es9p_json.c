@@ -0,0 +1,198 @@
+// Unit checks for the ES9+ JSON pull parser and the streaming base64 decoder.
+// The parser helpers are static, so the translation unit is pulled in whole.
+#include "../euicc/es9p.c"
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                   \
+            failures++;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+static struct es9p_json_span span_of(char *str) {
+    struct es9p_json_span span = {str, str + strlen(str)};
+    return span;
+}
+
+// Extracts a quoted JSON string literal, returns the decoded length and leaves the result in out
+static int extract(const char *literal, char *out, int strip_whitespace) {
+    char raw[256];
+    struct es9p_json_span span;
+
+    snprintf(raw, sizeof(raw), "%s", literal);
+    span = span_of(raw);
+    return es9p_json_string_extract(&span, out, strip_whitespace);
+}
+
+static void test_string_extract(void) {
+    char out[256];
+    char aliased[] = "\"a\\nb\\u0041\"";
+    struct es9p_json_span span = span_of(aliased);
+
+    CHECK(extract("\"\"", out, 0) == 0 && out[0] == '\0');
+    CHECK(extract("\"plain\"", out, 0) == 5 && strcmp(out, "plain") == 0);
+    CHECK(extract("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", out, 0) == 8 && strcmp(out, "\"\\/\b\f\n\r\t") == 0);
+
+    // \u escapes encode as UTF-8 of 1, 2 and 3 bytes
+    CHECK(extract("\"\\u0041\\u00e9\\u20AC\"", out, 0) == 6 && strcmp(out, "A\xC3\xA9\xE2\x82\xAC") == 0);
+    // surrogate pair for U+1F600
+    CHECK(extract("\"\\ud83d\\ude00\"", out, 0) == 4 && strcmp(out, "\xF0\x9F\x98\x80") == 0);
+    // lone high surrogate, reversed pair, high surrogate followed by a plain character
+    CHECK(extract("\"\\ud83d\"", out, 0) == -1);
+    CHECK(extract("\"\\ude00\\ud83d\"", out, 0) == -1);
+    CHECK(extract("\"\\ud83dxxxxxx\"", out, 0) == -1);
+
+    // truncated or malformed escapes
+    CHECK(extract("\"\\\"", out, 0) == -1);
+    CHECK(extract("\"\\u12\"", out, 0) == -1);
+    CHECK(extract("\"\\u12g4\"", out, 0) == -1);
+
+    // wrapped base64 is joined, escaped line breaks included
+    CHECK(extract("\"QUJD\\r\\nREVG\\n R0hJ\\t\"", out, 1) == 12 && strcmp(out, "QUJDREVGR0hJ") == 0);
+    CHECK(extract("\"a b\"", out, 0) == 3 && strcmp(out, "a b") == 0);
+
+    // decoding in place over the raw span
+    CHECK(es9p_json_string_extract(&span, span.ptr, 0) == 4 && strcmp(aliased, "a\nbA") == 0);
+}
+
+static void test_object_lookup(void) {
+    const char *keys[] = {"a", "b", "missing", NULL};
+    struct es9p_json_span spans[3];
+    char out[256];
+
+    {
+        char json[] = " {\"a\":\"1\"}";
+        struct es9p_json_span object = span_of(json);
+        CHECK(es9p_json_object_lookup(&object, keys, spans) == -1);
+    }
+
+    {
+        char json[] = "{ }";
+        struct es9p_json_span object = span_of(json);
+        CHECK(es9p_json_object_lookup(&object, keys, spans) == 0);
+        CHECK(spans[0].ptr == NULL && spans[1].ptr == NULL && spans[2].ptr == NULL);
+    }
+
+    {
+        // nested keys of the same name are not matched, the first duplicate wins
+        char json[] = "{ \"n\" : {\"a\":\"inner\",\"x\":[{\"b\":1},\"}\"]} ,"
+                      "\"a\":\"outer\",\r\n\"b\":42,\"a\":\"dup\"}";
+        struct es9p_json_span object = span_of(json);
+        CHECK(es9p_json_object_lookup(&object, keys, spans) == 0);
+        CHECK(es9p_json_span_is_string(&spans[0]));
+        CHECK(es9p_json_string_extract(&spans[0], out, 0) == 5 && strcmp(out, "outer") == 0);
+        CHECK(spans[1].ptr != NULL && spans[1].end - spans[1].ptr == 2 && memcmp(spans[1].ptr, "42", 2) == 0);
+        CHECK(spans[2].ptr == NULL);
+    }
+
+    {
+        // escaped quotes and braces inside strings do not end the value
+        char json[] = "{\"a\":\"x\\\"}y\",\"b\":{\"k\":\"{\"}}";
+        struct es9p_json_span object = span_of(json);
+        CHECK(es9p_json_object_lookup(&object, keys, spans) == 0);
+        CHECK(es9p_json_string_extract(&spans[0], out, 0) == 4 && strcmp(out, "x\"}y") == 0);
+        CHECK(es9p_json_span_is_object(&spans[1]) && *(spans[1].end - 1) == '}');
+    }
+
+    {
+        // truncated and malformed objects
+        char *bad[] = {
+            "{",
+            "{\"a\"",
+            "{\"a\":",
+            "{\"a\":\"1",
+            "{\"a\":{\"b\":1}",
+            "{\"a\" \"1\"}",
+            "{\"a\":1 \"b\":2}",
+            "{\"a\":1,",
+        };
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+            char json[64];
+            struct es9p_json_span object;
+
+            snprintf(json, sizeof(json), "%s", bad[i]);
+            object = span_of(json);
+            CHECK(es9p_json_object_lookup(&object, keys, spans) == -1);
+        }
+    }
+}
+
+static void test_array_next(void) {
+    char json[] = "[ \"x\" , {\"a\":[1,2]},3 ]";
+    struct es9p_json_span array = span_of(json), item;
+    char *cursor = NULL;
+
+    CHECK(es9p_json_array_next(&array, &cursor, &item) == 1 && es9p_json_span_is_string(&item));
+    CHECK(es9p_json_array_next(&array, &cursor, &item) == 1 && es9p_json_span_is_object(&item));
+    CHECK(es9p_json_array_next(&array, &cursor, &item) == 1 && *item.ptr == '3');
+    CHECK(es9p_json_array_next(&array, &cursor, &item) == 0);
+
+    {
+        char truncated[] = "[1,";
+        struct es9p_json_span bad = span_of(truncated);
+        cursor = NULL;
+        CHECK(es9p_json_array_next(&bad, &cursor, &item) == 1);
+        CHECK(es9p_json_array_next(&bad, &cursor, &item) == -1);
+    }
+}
+
+// Feeds encoded in chunks of chunk bytes, returns the decoded length or -1
+static int decode_chunked(const char *encoded, int chunk, unsigned char *out) {
+    struct euicc_base64_decoder decoder;
+    const int len = strlen(encoded);
+    int n, total = 0;
+
+    euicc_base64_decoder_init(&decoder);
+    for (int i = 0; i < len; i += chunk) {
+        if ((n = euicc_base64_decoder_update(&decoder, out + total, encoded + i, len - i < chunk ? len - i : chunk))
+            < 0) {
+            return -1;
+        }
+        total += n;
+    }
+    if ((n = euicc_base64_decoder_final(&decoder, out + total)) < 0) {
+        return -1;
+    }
+    return total + n;
+}
+
+static void test_base64_decoder(void) {
+    unsigned char out[64];
+
+    for (int chunk = 1; chunk <= 8; chunk++) {
+        CHECK(decode_chunked("", chunk, out) == 0);
+        CHECK(decode_chunked("QUJD", chunk, out) == 3 && memcmp(out, "ABC", 3) == 0);
+        CHECK(decode_chunked("QUI=", chunk, out) == 2 && memcmp(out, "AB", 2) == 0);
+        CHECK(decode_chunked("QQ==", chunk, out) == 1 && memcmp(out, "A", 1) == 0);
+        // unpadded tails
+        CHECK(decode_chunked("QUI", chunk, out) == 2 && memcmp(out, "AB", 2) == 0);
+        CHECK(decode_chunked("QQ", chunk, out) == 1 && memcmp(out, "A", 1) == 0);
+        // whitespace-wrapped input
+        CHECK(decode_chunked("QUJD\r\nREVG\n R0\tg=\n", chunk, out) == 8 && memcmp(out, "ABCDEFGH", 8) == 0);
+        // malformed input
+        CHECK(decode_chunked("QUJD*", chunk, out) == -1);
+        CHECK(decode_chunked("QQ==QQ==", chunk, out) == -1);
+        CHECK(decode_chunked("QUJDR", chunk, out) == -1);
+    }
+
+    // the one-shot decoder agrees on padded input
+    CHECK(euicc_base64_decode(out, "QUJDREVG") == 6 && memcmp(out, "ABCDEF", 6) == 0);
+}
+
+int main(void) {
+    test_string_extract();
+    test_object_lookup();
+    test_array_next();
+    test_base64_decoder();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
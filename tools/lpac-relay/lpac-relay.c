@@ -0,0 +1,551 @@
+// ES9+ relay for fleets of devices: lpac on the device runs with LPAC_HTTP=relay and only does the
+// ES10 work, while this process makes the HTTPS requests for all of them. Every device connection
+// feeds the same curl multi handle, so TLS sessions and connections to an SM-DP+ are shared between
+// devices and concurrent requests to an HTTP/2 server are multiplexed over one connection.
+#define _GNU_SOURCE
+
+#include <cjson/cJSON.h>
+#include <euicc/euicc.h>
+#include <euicc/hexutil.h>
+#include <euicc/interface.h>
+#include <http/curl.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RELAY_READ_CHUNK 16384
+#define RELAY_LINE_MAX (16 * 1024 * 1024)
+#define RELAY_HEADERS_MAX 16
+
+struct relay_client {
+    int fd;
+    uint32_t id;
+    char *in;
+    size_t in_len;
+    size_t in_size;
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    bool busy;   // one request in flight, the next line waits so answers keep their order
+    bool closed; // the device hung up, freed once its request finished
+    struct relay_client *next;
+};
+
+struct relay_request {
+    struct relay_client *client;
+    char *url;
+    uint64_t started_us;
+};
+
+static struct {
+    const char *address;
+    int port;
+    const char *unix_path;
+    bool quiet;
+    struct euicc_http_interface http;
+    struct euicc_ctx ctx;
+    struct relay_client *clients;
+    uint32_t clients_count;
+    uint32_t next_id;
+} relay = {
+    .address = "127.0.0.1",
+    .port = 8765,
+};
+
+static volatile sig_atomic_t stopped = 0;
+
+static void sigint_handler(__attribute__((unused)) int s) { stopped = 1; }
+
+static uint64_t relay_now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int relay_append(struct relay_client *client, const char *data, size_t len) {
+    char *nout = realloc(client->out, client->out_len + len);
+
+    if (nout == NULL) {
+        return -1;
+    }
+    client->out = nout;
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+
+    return 0;
+}
+
+// Only ES9+ and ES11 functions are forwarded, the relay is not a general purpose proxy
+static bool relay_url_allowed(const char *url) {
+    const char *path;
+
+    if (strncasecmp(url, "https://", 8) == 0) {
+        path = url + 8;
+    } else if (strncasecmp(url, "http://", 7) == 0) {
+        path = url + 7;
+    } else {
+        return false;
+    }
+    path = strchr(path, '/');
+
+    return path != NULL && strncmp(path, "/gsma/rsp2/", 11) == 0;
+}
+
+static void relay_answer(struct relay_client *client, const struct euicc_http_response *response) {
+    cJSON *jroot = cJSON_CreateObject();
+    cJSON *jpayload = cJSON_AddObjectToObject(jroot, "payload");
+    char *rx_hex = NULL;
+    char *line = NULL;
+
+    cJSON_AddStringToObject(jroot, "type", "http");
+    // a response without rcode tells the device that the server was not reached
+    if (response != NULL && response->result >= 0) {
+        rx_hex = malloc((2 * response->rx_len) + 1);
+        if (rx_hex == NULL
+            || euicc_hexutil_bin2hex(rx_hex, (2 * response->rx_len) + 1, response->rx, response->rx_len) < 0) {
+            goto exit;
+        }
+        cJSON_AddNumberToObject(jpayload, "rcode", response->rcode);
+        cJSON_AddStringToObject(jpayload, "rx", rx_hex);
+    }
+
+    if ((line = cJSON_PrintUnformatted(jroot)) != NULL) {
+        if (relay_append(client, line, strlen(line)) == 0) {
+            relay_append(client, "\n", 1);
+        }
+    }
+
+exit:
+    free(line);
+    free(rx_hex);
+    cJSON_Delete(jroot);
+}
+
+static void relay_done(__attribute__((unused)) struct euicc_ctx *ctx, struct euicc_http_response *response,
+                       void *userdata) {
+    struct relay_request *request = userdata;
+    struct relay_client *client = request->client;
+
+    if (!relay.quiet) {
+        fprintf(stderr, "#%u %s %d %u bytes %.1f ms\n", client->id, request->url,
+                response->result < 0 ? -1 : (int)response->rcode, response->rx_len,
+                (relay_now_us() - request->started_us) / 1000.0);
+    }
+
+    client->busy = false;
+    if (!client->closed) {
+        relay_answer(client, response);
+    }
+
+    free(response->rx);
+    free(request->url);
+    free(request);
+}
+
+// {"type":"http","payload":{"url":"https://...","tx":"7b22...","headers":["..."]}}
+static void relay_handle_line(struct relay_client *client, const char *line) {
+    cJSON *jroot = cJSON_Parse(line);
+    const cJSON *jpayload, *jurl, *jtx, *jheaders, *jheader;
+    const char *headers[RELAY_HEADERS_MAX + 1];
+    struct relay_request *request = NULL;
+    uint8_t *tx = NULL;
+    uint32_t tx_len = 0;
+    int headers_count = 0;
+
+    jpayload = cJSON_GetObjectItem(jroot, "payload");
+    jurl = cJSON_GetObjectItem(jpayload, "url");
+    jtx = cJSON_GetObjectItem(jpayload, "tx");
+    jheaders = cJSON_GetObjectItem(jpayload, "headers");
+    if (!cJSON_IsString(cJSON_GetObjectItem(jroot, "type"))
+        || strcmp(cJSON_GetObjectItem(jroot, "type")->valuestring, "http") != 0 || !cJSON_IsString(jurl)
+        || !cJSON_IsString(jtx)) {
+        fprintf(stderr, "#%u malformed request\n", client->id);
+        goto err;
+    }
+    if (!relay_url_allowed(jurl->valuestring)) {
+        fprintf(stderr, "#%u refused %s\n", client->id, jurl->valuestring);
+        goto err;
+    }
+
+    cJSON_ArrayForEach(jheader, jheaders) {
+        if (cJSON_IsString(jheader) && headers_count < RELAY_HEADERS_MAX) {
+            headers[headers_count++] = jheader->valuestring;
+        }
+    }
+    headers[headers_count] = NULL;
+
+    tx_len = strlen(jtx->valuestring) / 2;
+    tx = malloc(tx_len ? tx_len : 1);
+    if (tx == NULL || euicc_hexutil_hex2bin_r(tx, tx_len, jtx->valuestring, strlen(jtx->valuestring)) < 0) {
+        goto err;
+    }
+
+    request = calloc(1, sizeof(*request));
+    if (request == NULL || (request->url = strdup(jurl->valuestring)) == NULL) {
+        goto err;
+    }
+    request->client = client;
+    request->started_us = relay_now_us();
+
+    // tx and the headers are copied by the driver
+    if (relay.http.async_submit(&relay.ctx, request->url, tx, tx_len, headers, relay_done, request) < 0) {
+        goto err;
+    }
+    client->busy = true;
+
+    free(tx);
+    cJSON_Delete(jroot);
+    return;
+
+err:
+    if (request != NULL) {
+        free(request->url);
+        free(request);
+    }
+    free(tx);
+    cJSON_Delete(jroot);
+    relay_answer(client, NULL);
+}
+
+static void relay_handle_input(struct relay_client *client) {
+    size_t consumed = 0;
+    char *newline;
+
+    while (!client->busy
+           && (newline = memchr(client->in + consumed, '\n', client->in_len - consumed)) != NULL) {
+        *newline = '\0';
+        relay_handle_line(client, client->in + consumed);
+        consumed = newline - client->in + 1;
+    }
+
+    memmove(client->in, client->in + consumed, client->in_len - consumed);
+    client->in_len -= consumed;
+}
+
+static void relay_read(struct relay_client *client) {
+    ssize_t n;
+
+    if (client->in_size - client->in_len < RELAY_READ_CHUNK) {
+        char *nin;
+
+        if (client->in_size >= RELAY_LINE_MAX) {
+            fprintf(stderr, "#%u request too large\n", client->id);
+            client->closed = true;
+            return;
+        }
+        nin = realloc(client->in, client->in_size + RELAY_READ_CHUNK);
+        if (nin == NULL) {
+            client->closed = true;
+            return;
+        }
+        client->in = nin;
+        client->in_size += RELAY_READ_CHUNK;
+    }
+
+    n = recv(client->fd, client->in + client->in_len, client->in_size - client->in_len, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (n <= 0) {
+        client->closed = true;
+        return;
+    }
+    client->in_len += n;
+
+    relay_handle_input(client);
+}
+
+static void relay_write(struct relay_client *client) {
+    const ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                           MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (n < 0) {
+        if (errno != EINTR && errno != EAGAIN) {
+            client->closed = true;
+        }
+        return;
+    }
+    client->out_sent += n;
+    if (client->out_sent == client->out_len) {
+        free(client->out);
+        client->out = NULL;
+        client->out_len = 0;
+        client->out_sent = 0;
+    }
+}
+
+static void relay_accept(int listener) {
+    struct relay_client *client;
+    const int fd = accept(listener, NULL, NULL);
+
+    if (fd < 0) {
+        return;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+
+    if ((client = calloc(1, sizeof(*client))) == NULL) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+    client->id = ++relay.next_id;
+    client->next = relay.clients;
+    relay.clients = client;
+    relay.clients_count++;
+
+    if (!relay.quiet) {
+        fprintf(stderr, "#%u connected, %u devices\n", client->id, relay.clients_count);
+    }
+}
+
+static void relay_reap(void) {
+    struct relay_client **pclient = &relay.clients;
+
+    while (*pclient != NULL) {
+        struct relay_client *client = *pclient;
+
+        // a request still in flight points at the client, it goes once the answer came back
+        if (!client->closed || client->busy) {
+            pclient = &client->next;
+            continue;
+        }
+
+        *pclient = client->next;
+        relay.clients_count--;
+        if (!relay.quiet) {
+            fprintf(stderr, "#%u disconnected, %u devices\n", client->id, relay.clients_count);
+        }
+        close(client->fd);
+        free(client->in);
+        free(client->out);
+        free(client);
+    }
+}
+
+static int relay_listen(void) {
+    int listener;
+
+    if (relay.unix_path != NULL) {
+        struct sockaddr_un sun = {0};
+
+        if (strlen(relay.unix_path) >= sizeof(sun.sun_path)) {
+            fprintf(stderr, "socket path too long: %s\n", relay.unix_path);
+            return -1;
+        }
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, relay.unix_path);
+        unlink(relay.unix_path);
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, (struct sockaddr *)&sun, sizeof(sun)) != 0 || listen(listener, 128) != 0) {
+            perror("listen");
+            return -1;
+        }
+        fprintf(stderr, "listening on unix:%s\n", relay.unix_path);
+    } else {
+        struct sockaddr_in sin = {0};
+
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(relay.port);
+        if (inet_pton(AF_INET, relay.address, &sin.sin_addr) != 1) {
+            fprintf(stderr, "invalid listen address: %s\n", relay.address);
+            return -1;
+        }
+
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
+        if (listener < 0 || bind(listener, (struct sockaddr *)&sin, sizeof(sin)) != 0 || listen(listener, 128) != 0) {
+            perror("listen");
+            return -1;
+        }
+        fprintf(stderr, "listening on %s:%d\n", relay.address, relay.port);
+    }
+
+    return listener;
+}
+
+// Fetches the sockets curl wants watched into *fds, growing it when curl has more open than it holds
+static int relay_curl_fds(struct euicc_http_pollfd **fds, uint32_t *fds_size, uint32_t *fds_count,
+                          long *timeout_ms) {
+    int ret;
+
+    *fds_count = *fds_size;
+    while ((ret = relay.http.async_fds(&relay.ctx, *fds, fds_count, timeout_ms)) == 1) {
+        struct euicc_http_pollfd *nfds;
+
+        if ((nfds = realloc(*fds, *fds_count * sizeof(**fds))) == NULL) {
+            return -1;
+        }
+        *fds = nfds;
+        *fds_size = *fds_count;
+    }
+
+    return ret;
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [OPTIONS]\n", argv0);
+    printf("\t -a Listen address (default: %s)\n", relay.address);
+    printf("\t -p Listen port (default: %d)\n", relay.port);
+    printf("\t -u Listen on a Unix socket at this path instead\n");
+    printf("\t -q Do not log requests\n");
+    printf("\t -h This help info\n");
+}
+
+int main(int argc, char **argv) {
+    struct pollfd *fds = NULL;
+    uint32_t fds_size = 0;
+    struct euicc_http_pollfd *curl_fds = NULL;
+    uint32_t curl_fds_size = 0;
+    int listener, opt;
+
+    while ((opt = getopt(argc, argv, "a:p:u:qh?")) != -1) {
+        switch (opt) {
+        case 'a':
+            relay.address = optarg;
+            break;
+        case 'p':
+            relay.port = atoi(optarg);
+            break;
+        case 'u':
+            relay.unix_path = optarg;
+            break;
+        case 'q':
+            relay.quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (driver_http_curl.init(&relay.http) != 0 || relay.http.async_submit == NULL
+        || relay.http.async_dispatch_fds == NULL) {
+        fprintf(stderr, "curl HTTP backend unavailable\n");
+        return 1;
+    }
+    relay.ctx.http.interface = &relay.http;
+
+    if ((listener = relay_listen()) < 0) {
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, sigint_handler);
+    signal(SIGTERM, sigint_handler);
+
+    while (!stopped) {
+        uint32_t curl_fds_count, curl_fds_ready = 0;
+        uint32_t n = 0;
+        long timeout_ms = -1;
+        struct relay_client *client;
+
+        if (relay_curl_fds(&curl_fds, &curl_fds_size, &curl_fds_count, &timeout_ms) < 0) {
+            curl_fds_count = 0;
+            timeout_ms = 100;
+        }
+
+        if (fds_size < 1 + relay.clients_count + curl_fds_count) {
+            struct pollfd *nfds;
+
+            fds_size = 1 + relay.clients_count + curl_fds_count;
+            if ((nfds = realloc(fds, fds_size * sizeof(*fds))) == NULL) {
+                break;
+            }
+            fds = nfds;
+        }
+
+        fds[n++] = (struct pollfd){.fd = listener, .events = POLLIN};
+        for (client = relay.clients; client != NULL; client = client->next) {
+            fds[n++] = (struct pollfd){
+                .fd = client->closed ? -1 : client->fd,
+                .events = POLLIN | (client->out_len ? POLLOUT : 0),
+            };
+        }
+        for (uint32_t i = 0; i < curl_fds_count; i++) {
+            fds[n++] = (struct pollfd){
+                .fd = curl_fds[i].fd,
+                .events = ((curl_fds[i].events & EUICC_HTTP_POLL_IN) ? POLLIN : 0)
+                          | ((curl_fds[i].events & EUICC_HTTP_POLL_OUT) ? POLLOUT : 0),
+            };
+        }
+
+        if (poll(fds, n, timeout_ms > INT32_MAX ? -1 : (int)timeout_ms) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        // the curl sockets come last, the ready ones are moved to the front of curl_fds with what happened
+        for (uint32_t i = 0, k = n - curl_fds_count; i < curl_fds_count; i++, k++) {
+            uint8_t events = ((fds[k].revents & POLLIN) ? EUICC_HTTP_POLL_IN : 0)
+                             | ((fds[k].revents & POLLOUT) ? EUICC_HTTP_POLL_OUT : 0)
+                             | ((fds[k].revents & (POLLERR | POLLHUP)) ? EUICC_HTTP_POLL_ERR : 0);
+            if (events) {
+                curl_fds[curl_fds_ready].fd = curl_fds[i].fd;
+                curl_fds[curl_fds_ready].events = events;
+                curl_fds_ready++;
+            }
+        }
+
+        n = 1;
+        for (client = relay.clients; client != NULL; client = client->next, n++) {
+            if (fds[n].fd < 0) {
+                continue;
+            }
+            if (fds[n].revents & (POLLIN | POLLHUP | POLLERR)) {
+                relay_read(client);
+            }
+            if (!client->closed && client->out_len && (fds[n].revents & POLLOUT)) {
+                relay_write(client);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            relay_accept(listener);
+        }
+
+        // answers land in the clients' output buffers
+        relay.http.async_dispatch_fds(&relay.ctx, curl_fds, curl_fds_ready);
+
+        for (client = relay.clients; client != NULL; client = client->next) {
+            if (!client->closed) {
+                // lines held back while the previous request was in flight
+                relay_handle_input(client);
+                if (client->out_len) {
+                    relay_write(client);
+                }
+            }
+        }
+        relay_reap();
+    }
+
+    fprintf(stderr, "shutting down\n");
+    for (struct relay_client *client = relay.clients; client != NULL; client = client->next) {
+        client->closed = true;
+        client->busy = false;
+    }
+    relay_reap();
+    driver_http_curl.fini(&relay.http);
+    free(fds);
+    free(curl_fds);
+    close(listener);
+    if (relay.unix_path != NULL) {
+        unlink(relay.unix_path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,545 @@
+// Minimal SM-DP+/SM-DS stand-in for offline end-to-end tests and load generation.
+// It speaks just enough ES9+/ES11 over HTTP/1.1 (optionally TLS) for lpac to walk the download,
+// discovery and notification flows; payloads are random data of configurable size and carry no
+// valid signatures, so a real eUICC rejects them.
+#define _GNU_SOURCE
+
+#include <cjson/cJSON.h>
+#include <euicc/base64.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MOCK_SMDP_WITH_TLS
+#    include <openssl/err.h>
+#    include <openssl/ssl.h>
+#endif
+
+#define MOCK_HEADER_MAX 16384
+#define MOCK_BODY_MAX (4 * 1024 * 1024)
+#define MOCK_BPP_SEGMENT 1020
+
+static struct {
+    const char *address;
+    int port;
+    int latency_ms;
+    int bpp_size;
+    int blob_size;
+    int events;
+    bool quiet;
+    char self[128];
+#ifdef MOCK_SMDP_WITH_TLS
+    SSL_CTX *tls;
+#endif
+} mock = {
+    .address = "127.0.0.1",
+    .port = 8080,
+    .bpp_size = 32768,
+    .blob_size = 64,
+    .events = 1,
+};
+
+struct mock_conn {
+    int fd;
+    unsigned int seed;
+#ifdef MOCK_SMDP_WITH_TLS
+    SSL *ssl;
+#endif
+};
+
+struct mock_buf {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+};
+
+static bool mock_buf_put(struct mock_buf *buf, const void *data, size_t len) {
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        uint8_t *ndata;
+
+        while (cap < buf->len + len) {
+            cap *= 2;
+        }
+        if ((ndata = realloc(buf->data, cap)) == NULL) {
+            return false;
+        }
+        buf->data = ndata;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return true;
+}
+
+static bool mock_buf_random(struct mock_buf *buf, size_t len, unsigned int *seed) {
+    while (len-- > 0) {
+        const uint8_t b = rand_r(seed) & 0xFF;
+        if (!mock_buf_put(buf, &b, 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Appends tag and DER length, the value is written by the caller
+static bool mock_der_header(struct mock_buf *buf, uint16_t tag, size_t len) {
+    uint8_t header[8];
+    size_t n = 0;
+
+    if (tag > 0xFF) {
+        header[n++] = tag >> 8;
+    }
+    header[n++] = tag & 0xFF;
+    if (len < 0x80) {
+        header[n++] = len;
+    } else if (len <= 0xFF) {
+        header[n++] = 0x81;
+        header[n++] = len;
+    } else if (len <= 0xFFFF) {
+        header[n++] = 0x82;
+        header[n++] = len >> 8;
+        header[n++] = len & 0xFF;
+    } else {
+        header[n++] = 0x83;
+        header[n++] = len >> 16;
+        header[n++] = (len >> 8) & 0xFF;
+        header[n++] = len & 0xFF;
+    }
+    return mock_buf_put(buf, header, n);
+}
+
+static bool mock_der_wrap(struct mock_buf *buf, uint16_t tag, const struct mock_buf *value) {
+    return mock_der_header(buf, tag, value->len) && mock_buf_put(buf, value->data, value->len);
+}
+
+static char *mock_base64(const struct mock_buf *buf) {
+    char *b64 = malloc(euicc_base64_encode_len(buf->len));
+
+    if (b64 != NULL) {
+        euicc_base64_encode(b64, buf->data, buf->len);
+    }
+    return b64;
+}
+
+static char *mock_base64_random(size_t len, unsigned int *seed) {
+    struct mock_buf buf = {0};
+    char *b64 = NULL;
+
+    if (mock_buf_random(&buf, len, seed)) {
+        b64 = mock_base64(&buf);
+    }
+    free(buf.data);
+    return b64;
+}
+
+// A structurally valid BoundProfilePackage (BF36) of about bpp_size bytes: lpac splits it into
+// its TLVs like a real one, the contents are random
+static char *mock_bound_profile_package(unsigned int *seed) {
+    struct mock_buf bpp = {0}, inner = {0}, part = {0}, segments = {0};
+    size_t remaining = mock.bpp_size > 256 ? mock.bpp_size - 256 : MOCK_BPP_SEGMENT;
+    char *b64 = NULL;
+    bool ok = true;
+
+    ok = ok && mock_buf_random(&part, 96, seed) && mock_der_wrap(&inner, 0xBF23, &part);
+    part.len = 0;
+    ok = ok && mock_der_header(&part, 0x87, 32) && mock_buf_random(&part, 32, seed)
+         && mock_der_wrap(&inner, 0xA0, &part);
+    part.len = 0;
+    ok = ok && mock_der_header(&part, 0x88, 32) && mock_buf_random(&part, 32, seed)
+         && mock_der_wrap(&inner, 0xA1, &part);
+    while (ok && remaining > 0) {
+        const size_t n = remaining < MOCK_BPP_SEGMENT ? remaining : MOCK_BPP_SEGMENT;
+        ok = mock_der_header(&segments, 0x86, n) && mock_buf_random(&segments, n, seed);
+        remaining -= n;
+    }
+    ok = ok && mock_der_wrap(&inner, 0xA3, &segments) && mock_der_wrap(&bpp, 0xBF36, &inner);
+
+    if (ok) {
+        b64 = mock_base64(&bpp);
+    }
+    free(bpp.data);
+    free(inner.data);
+    free(part.data);
+    free(segments.data);
+    return b64;
+}
+
+// StoreMetadataRequest (BF25) with a fixed ICCID, enough for the download preview
+static char *mock_profile_metadata(void) {
+    static const uint8_t iccid[] = {0x98, 0x10, 0x32, 0x54, 0x76, 0x98, 0x10, 0x32, 0x54, 0xF6};
+    static const char name[] = "lpac mock profile", provider[] = "lpac mock-smdp";
+    struct mock_buf inner = {0}, metadata = {0};
+    char *b64 = NULL;
+
+    if (mock_der_header(&inner, 0x5A, sizeof(iccid)) && mock_buf_put(&inner, iccid, sizeof(iccid))
+        && mock_der_header(&inner, 0x91, strlen(name)) && mock_buf_put(&inner, name, strlen(name))
+        && mock_der_header(&inner, 0x92, strlen(provider)) && mock_buf_put(&inner, provider, strlen(provider))
+        && mock_der_wrap(&metadata, 0xBF25, &inner)) {
+        b64 = mock_base64(&metadata);
+    }
+    free(inner.data);
+    free(metadata.data);
+    return b64;
+}
+
+static void mock_add_random(cJSON *jroot, const char *key, unsigned int *seed) {
+    char *b64 = mock_base64_random(mock.blob_size, seed);
+
+    cJSON_AddStringToObject(jroot, key, b64 ? b64 : "");
+    free(b64);
+}
+
+static cJSON *mock_response(const char *transaction_id) {
+    cJSON *jroot = cJSON_CreateObject();
+    cJSON *jheader = cJSON_AddObjectToObject(jroot, "header");
+    cJSON *jstatus = cJSON_AddObjectToObject(jheader, "functionExecutionStatus");
+
+    cJSON_AddStringToObject(jstatus, "status", "Executed-Success");
+    if (transaction_id != NULL) {
+        cJSON_AddStringToObject(jroot, "transactionId", transaction_id);
+    }
+    return jroot;
+}
+
+// Builds the body for an ES9+/ES11 function, NULL with *status set for bodiless answers
+static char *mock_dispatch(const char *path, const char *body, size_t body_len, int *status, unsigned int *seed) {
+    cJSON *jrequest = cJSON_ParseWithLength(body, body_len);
+    cJSON *jroot = NULL;
+    const char *transaction_id = cJSON_GetStringValue(cJSON_GetObjectItem(jrequest, "transactionId"));
+    char generated_id[33];
+    char *out = NULL;
+
+    *status = 200;
+
+    if (strcmp(path, "/gsma/rsp2/es9plus/initiateAuthentication") == 0) {
+        for (int i = 0; i < 32; i++) {
+            generated_id[i] = "0123456789ABCDEF"[rand_r(seed) & 0xF];
+        }
+        generated_id[32] = '\0';
+        jroot = mock_response(generated_id);
+        mock_add_random(jroot, "serverSigned1", seed);
+        mock_add_random(jroot, "serverSignature1", seed);
+        mock_add_random(jroot, "euiccCiPKIdToBeUsed", seed);
+        mock_add_random(jroot, "serverCertificate", seed);
+    } else if (strcmp(path, "/gsma/rsp2/es9plus/authenticateClient") == 0) {
+        // one answer for both ES9+ and ES11, each side only looks up the fields it expects
+        char *metadata = mock_profile_metadata();
+        cJSON *jevents;
+
+        jroot = mock_response(transaction_id);
+        cJSON_AddStringToObject(jroot, "profileMetadata", metadata ? metadata : "");
+        free(metadata);
+        mock_add_random(jroot, "smdpSigned2", seed);
+        mock_add_random(jroot, "smdpSignature2", seed);
+        mock_add_random(jroot, "smdpCertificate", seed);
+        jevents = cJSON_AddArrayToObject(jroot, "eventEntries");
+        for (int i = 0; i < mock.events; i++) {
+            cJSON *jevent = cJSON_CreateObject();
+            char event_id[16];
+
+            snprintf(event_id, sizeof(event_id), "MOCK%04d", i);
+            cJSON_AddStringToObject(jevent, "eventId", event_id);
+            cJSON_AddStringToObject(jevent, "rspServerAddress", mock.self);
+            cJSON_AddItemToArray(jevents, jevent);
+        }
+    } else if (strcmp(path, "/gsma/rsp2/es9plus/getBoundProfilePackage") == 0) {
+        char *bpp = mock_bound_profile_package(seed);
+
+        jroot = mock_response(transaction_id);
+        cJSON_AddStringToObject(jroot, "boundProfilePackage", bpp ? bpp : "");
+        free(bpp);
+    } else if (strcmp(path, "/gsma/rsp2/es9plus/cancelSession") == 0) {
+        jroot = mock_response(NULL);
+    } else if (strcmp(path, "/gsma/rsp2/es9plus/handleNotification") == 0) {
+        *status = 204;
+    } else {
+        *status = 404;
+    }
+
+    if (jroot != NULL) {
+        out = cJSON_PrintUnformatted(jroot);
+        cJSON_Delete(jroot);
+    }
+    cJSON_Delete(jrequest);
+    return out;
+}
+
+static ssize_t mock_read(struct mock_conn *conn, void *buf, size_t len) {
+#ifdef MOCK_SMDP_WITH_TLS
+    if (conn->ssl) {
+        return SSL_read(conn->ssl, buf, len);
+    }
+#endif
+    return recv(conn->fd, buf, len, 0);
+}
+
+static bool mock_write(struct mock_conn *conn, const void *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n;
+#ifdef MOCK_SMDP_WITH_TLS
+        if (conn->ssl) {
+            n = SSL_write(conn->ssl, buf, len);
+        } else
+#endif
+            n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        buf = (const uint8_t *)buf + n;
+        len -= n;
+    }
+    return true;
+}
+
+static const char *mock_reason(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 204:
+        return "No Content";
+    case 404:
+        return "Not Found";
+    case 413:
+        return "Payload Too Large";
+    default:
+        return "Bad Request";
+    }
+}
+
+// Serves requests on one keep-alive connection until the client closes it
+static void *mock_connection(void *arg) {
+    struct mock_conn *conn = arg;
+    char *buf = malloc(MOCK_HEADER_MAX + MOCK_BODY_MAX);
+    size_t have = 0;
+
+#ifdef MOCK_SMDP_WITH_TLS
+    if (mock.tls) {
+        conn->ssl = SSL_new(mock.tls);
+        SSL_set_fd(conn->ssl, conn->fd);
+        if (SSL_accept(conn->ssl) <= 0) {
+            goto exit;
+        }
+    }
+#endif
+
+    while (buf != NULL) {
+        char method[16], path[256], header[256];
+        char *headers_end, *line, *body = NULL;
+        size_t header_len, content_length = 0;
+        bool keep_alive = true;
+        int status;
+        ssize_t n;
+
+        while ((headers_end = memmem(buf, have, "\r\n\r\n", 4)) == NULL) {
+            if (have >= MOCK_HEADER_MAX || (n = mock_read(conn, buf + have, MOCK_HEADER_MAX - have)) <= 0) {
+                goto exit;
+            }
+            have += n;
+        }
+        header_len = headers_end + 4 - buf;
+        *headers_end = '\0';
+
+        if (sscanf(buf, "%15s %255s", method, path) != 2) {
+            goto exit;
+        }
+        for (line = strstr(buf, "\r\n"); line != NULL; line = strstr(line + 2, "\r\n")) {
+            if (sscanf(line + 2, "Content-Length: %zu", &content_length) == 1) {
+                continue;
+            }
+            if (sscanf(line + 2, "Connection: %255s", header) == 1 && strcasecmp(header, "close") == 0) {
+                keep_alive = false;
+            }
+        }
+        if (content_length > MOCK_BODY_MAX) {
+            status = 413;
+            keep_alive = false;
+        } else {
+            while (have < header_len + content_length) {
+                if ((n = mock_read(conn, buf + have, header_len + content_length - have)) <= 0) {
+                    goto exit;
+                }
+                have += n;
+            }
+
+            if (strcmp(method, "POST") == 0) {
+                body = mock_dispatch(path, buf + header_len, content_length, &status, &conn->seed);
+            } else {
+                // HEAD and GET, e.g. a connection prewarm, just get an empty answer
+                status = 200;
+            }
+        }
+
+        if (mock.latency_ms > 0) {
+            struct timespec delay = {mock.latency_ms / 1000, (mock.latency_ms % 1000) * 1000000L};
+            nanosleep(&delay, NULL);
+        }
+
+        n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nX-Admin-Protocol: gsma/rsp/v2.2.0\r\n"
+                     "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                     status, mock_reason(status), body ? strlen(body) : 0, keep_alive ? "keep-alive" : "close");
+        if (!mock.quiet) {
+            fprintf(stderr, "%s %s %d %zu\n", method, path, status, body ? strlen(body) : 0);
+        }
+        if (!mock_write(conn, header, n)
+            || (body && strcmp(method, "HEAD") != 0 && !mock_write(conn, body, strlen(body)))) {
+            free(body);
+            goto exit;
+        }
+        free(body);
+
+        if (!keep_alive) {
+            goto exit;
+        }
+        memmove(buf, buf + header_len + content_length, have - header_len - content_length);
+        have -= header_len + content_length;
+    }
+
+exit:
+#ifdef MOCK_SMDP_WITH_TLS
+    if (conn->ssl) {
+        SSL_shutdown(conn->ssl);
+        SSL_free(conn->ssl);
+    }
+#endif
+    close(conn->fd);
+    free(conn);
+    free(buf);
+    return NULL;
+}
+
+static void usage(const char *argv0) {
+    printf("Usage: %s [OPTIONS]\n", argv0);
+    printf("\t -a Listen address (default: %s)\n", mock.address);
+    printf("\t -p Listen port (default: %d)\n", mock.port);
+    printf("\t -l Latency added to every response, in milliseconds (default: 0)\n");
+    printf("\t -b Size of the bound profile package, in bytes (default: %d)\n", mock.bpp_size);
+    printf("\t -s Size of the random signatures and certificates, in bytes (default: %d)\n", mock.blob_size);
+    printf("\t -e Number of event entries returned to discovery (default: %d)\n", mock.events);
+#ifdef MOCK_SMDP_WITH_TLS
+    printf("\t -c TLS certificate (PEM), enables HTTPS together with -k\n");
+    printf("\t -k TLS private key (PEM)\n");
+#endif
+    printf("\t -q Do not log requests\n");
+    printf("\t -h This help info\n");
+}
+
+int main(int argc, char **argv) {
+    const char *cert = NULL, *key = NULL;
+    struct sockaddr_in sin = {0};
+    unsigned int connections = 0;
+    int listener, opt, one = 1;
+
+    while ((opt = getopt(argc, argv, "a:p:l:b:s:e:c:k:qh?")) != -1) {
+        switch (opt) {
+        case 'a':
+            mock.address = optarg;
+            break;
+        case 'p':
+            mock.port = atoi(optarg);
+            break;
+        case 'l':
+            mock.latency_ms = atoi(optarg);
+            break;
+        case 'b':
+            mock.bpp_size = atoi(optarg);
+            break;
+        case 's':
+            mock.blob_size = atoi(optarg);
+            break;
+        case 'e':
+            mock.events = atoi(optarg);
+            break;
+        case 'c':
+            cert = optarg;
+            break;
+        case 'k':
+            key = optarg;
+            break;
+        case 'q':
+            mock.quiet = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (cert != NULL || key != NULL) {
+#ifdef MOCK_SMDP_WITH_TLS
+        mock.tls = SSL_CTX_new(TLS_server_method());
+        if (mock.tls == NULL || SSL_CTX_use_certificate_chain_file(mock.tls, cert) != 1
+            || SSL_CTX_use_PrivateKey_file(mock.tls, key, SSL_FILETYPE_PEM) != 1) {
+            ERR_print_errors_fp(stderr);
+            return 1;
+        }
+#else
+        fprintf(stderr, "built without TLS support\n");
+        return 1;
+#endif
+    }
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(mock.port);
+    if (inet_pton(AF_INET, mock.address, &sin.sin_addr) != 1) {
+        fprintf(stderr, "invalid listen address: %s\n", mock.address);
+        return 1;
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (listener < 0 || bind(listener, (struct sockaddr *)&sin, sizeof(sin)) != 0 || listen(listener, 128) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+#ifdef MOCK_SMDP_WITH_TLS
+    snprintf(mock.self, sizeof(mock.self), "%s://%s:%d", mock.tls ? "https" : "http", mock.address, mock.port);
+#else
+    snprintf(mock.self, sizeof(mock.self), "http://%s:%d", mock.address, mock.port);
+#endif
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "listening on %s\n", mock.self);
+
+    for (;;) {
+        struct mock_conn *conn;
+        pthread_t thread;
+        const int fd = accept(listener, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if ((conn = calloc(1, sizeof(*conn))) == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->seed = (unsigned int)time(NULL) ^ (unsigned int)getpid() ^ (++connections * 2654435761u);
+        if (pthread_create(&thread, NULL, mock_connection, conn) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
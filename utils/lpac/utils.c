@@ -1,17 +1,26 @@
 #include "utils.h"
 
 #include <cjson/cJSON_ex.h>
+#include <euicc/base64.h>
+#include <euicc/hexutil.h>
 
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#    include <fcntl.h>
+#    include <io.h>
+#    include <windows.h>
+#endif
+
 static bool is_numeric(const char *value) {
-    if (value == NULL)
+    if (value == NULL || value[0] == '\0')
         return false;
     for (size_t i = strlen(value); i > 0; --i) {
-        if (isdigit(value[i]))
+        if (isdigit((unsigned char)value[i - 1]))
             continue;
         return false;
     }
@@ -60,38 +69,513 @@ void set_deprecated_env_name(const char *name, const char *deprecated_name) {
 #endif
 }
 
-bool json_print(char *type, cJSON *jpayload) {
-    _cleanup_cjson_ cJSON *jroot = NULL;
-    _cleanup_free_ char *jstr = NULL;
+int rename_replace(const char *from, const char *to) {
+#ifdef _WIN32
+    // the CRT rename fails when to exists
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
 
-    if (jpayload == NULL) {
-        goto err;
+#define JSON_WRITER_BUFFER_SIZE 16384
+#define JSON_WRITER_MAX_DEPTH 64
+
+enum json_writer_format {
+    JSON_WRITER_FORMAT_UNSET = 0,
+    JSON_WRITER_FORMAT_JSON,
+    JSON_WRITER_FORMAT_CBOR,
+};
+
+static struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    uint32_t depth;
+    bool need_comma[JSON_WRITER_MAX_DEPTH];
+    bool after_key;
+    bool flush_each_line;
+    bool oom;
+    enum json_writer_format format;
+    const char *key;
+} json_writer;
+
+// Members carried as byte strings in CBOR output, their text form is base64 or hex
+static const char *json_writer_base64_keys[] = {"icon", "pendingNotification", NULL};
+static const char *json_writer_hex_keys[] = {"eid", "eidValue", NULL};
+
+static void json_writer_setup(void) {
+    const char *value;
+
+    if (json_writer.format != JSON_WRITER_FORMAT_UNSET) {
+        return;
     }
 
-    jroot = cJSON_CreateObject();
-    if (jroot == NULL) {
-        goto err;
+    value = getenv_or_default(ENV_OUTPUT_FORMAT, (char *)"json");
+    json_writer.format = strcasecmp(value, "cbor") == 0 ? JSON_WRITER_FORMAT_CBOR : JSON_WRITER_FORMAT_JSON;
+#ifdef _WIN32
+    // text mode would turn every 0x0A byte of the CBOR stream into CRLF
+    if (json_writer.format == JSON_WRITER_FORMAT_CBOR) {
+        fflush(stdout);
+        _setmode(_fileno(stdout), _O_BINARY);
     }
+#endif
 
-    if (cJSON_AddStringOrNullToObject(jroot, "type", type) == NULL) {
-        goto err;
+    value = getenv_or_default(ENV_OUTPUT_FLUSH, (char *)"line");
+    json_writer.flush_each_line = strcasecmp(value, "exit") != 0;
+
+    json_writer.size = JSON_WRITER_BUFFER_SIZE;
+    json_writer.buf = malloc(json_writer.size);
+    if (json_writer.buf == NULL) {
+        json_writer.size = 0;
+        json_writer.oom = true;
     }
+}
 
-    if (cJSON_AddItemReferenceToObject(jroot, "payload", jpayload) == 0) {
-        goto err;
+static void json_writer_drain(void) {
+    if (json_writer.len) {
+        fwrite(json_writer.buf, 1, json_writer.len, stdout);
+        json_writer.len = 0;
     }
+}
 
-    jstr = cJSON_PrintUnformatted(jroot);
+// JSON lines are drained whenever the buffer fills up, a CBOR message is length
+// prefixed and therefore has to be held until it is complete.
+static bool json_writer_reserve(void) {
+    char *new_buf;
 
-    if (jstr == NULL) {
-        goto err;
+    if (json_writer.len < json_writer.size) {
+        return true;
     }
+    if (json_writer.format == JSON_WRITER_FORMAT_JSON && json_writer.size) {
+        json_writer_drain();
+        return true;
+    }
+    if (json_writer.oom) {
+        return false;
+    }
+    new_buf = realloc(json_writer.buf, json_writer.size * 2);
+    if (new_buf == NULL) {
+        json_writer.oom = true;
+        return false;
+    }
+    json_writer.buf = new_buf;
+    json_writer.size *= 2;
+    return true;
+}
 
-    fprintf(stdout, "%s\n", jstr);
-    fflush(stdout);
+static void json_writer_write(const char *data, size_t len) {
+    while (len) {
+        size_t chunk;
 
-    return true;
+        if (!json_writer_reserve()) {
+            return;
+        }
+        chunk = json_writer.size - json_writer.len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(json_writer.buf + json_writer.len, data, chunk);
+        json_writer.len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+static void json_writer_putc(const char c) {
+    if (!json_writer_reserve()) {
+        return;
+    }
+    json_writer.buf[json_writer.len++] = c;
+}
 
-err:
+static void json_writer_cbor_head(const uint8_t major, const uint64_t value) {
+    char head[9];
+    int len;
+
+    if (value < 24) {
+        head[0] = (char)(major << 5 | value);
+        len = 1;
+    } else if (value <= UINT8_MAX) {
+        head[0] = (char)(major << 5 | 24);
+        len = 2;
+    } else if (value <= UINT16_MAX) {
+        head[0] = (char)(major << 5 | 25);
+        len = 3;
+    } else if (value <= UINT32_MAX) {
+        head[0] = (char)(major << 5 | 26);
+        len = 5;
+    } else {
+        head[0] = (char)(major << 5 | 27);
+        len = 9;
+    }
+    for (int i = len - 1; i > 0; i--) {
+        head[len - i] = (char)(value >> (8 * (i - 1)));
+    }
+    json_writer_write(head, len);
+}
+
+static bool json_writer_is_cbor(void) { return json_writer.format == JSON_WRITER_FORMAT_CBOR; }
+
+static void json_writer_value_prefix(void) {
+    json_writer_setup();
+
+    if (json_writer_is_cbor()) {
+        if (json_writer.len == 0 && json_writer.depth == 0) {
+            // placeholder for the message length, filled in by json_writer_line_end
+            json_writer_write("\0\0\0\0", 4);
+        }
+        if (json_writer.after_key) {
+            json_writer.after_key = false;
+        } else {
+            json_writer.key = NULL;
+        }
+        return;
+    }
+
+    if (json_writer.after_key) {
+        json_writer.after_key = false;
+        return;
+    }
+    if (json_writer.need_comma[json_writer.depth]) {
+        json_writer_putc(',');
+    }
+    json_writer.need_comma[json_writer.depth] = true;
+}
+
+static void json_writer_quoted(const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    const char *run = str;
+    const char *p;
+
+    if (json_writer_is_cbor()) {
+        const size_t len = strlen(str);
+        json_writer_cbor_head(3, len);
+        json_writer_write(str, len);
+        return;
+    }
+
+    json_writer_putc('"');
+    for (p = str; *p; p++) {
+        const unsigned char c = (unsigned char)*p;
+        char escape;
+
+        switch (c) {
+        case '"':
+        case '\\':
+            escape = (char)c;
+            break;
+        case '\b':
+            escape = 'b';
+            break;
+        case '\f':
+            escape = 'f';
+            break;
+        case '\n':
+            escape = 'n';
+            break;
+        case '\r':
+            escape = 'r';
+            break;
+        case '\t':
+            escape = 't';
+            break;
+        default:
+            if (c >= 0x20) {
+                continue;
+            }
+            escape = 'u';
+            break;
+        }
+
+        json_writer_write(run, p - run);
+        run = p + 1;
+        json_writer_putc('\\');
+        json_writer_putc(escape);
+        if (escape == 'u') {
+            json_writer_write("00", 2);
+            json_writer_putc(hex[c >> 4]);
+            json_writer_putc(hex[c & 0xF]);
+        }
+    }
+    json_writer_write(run, p - run);
+    json_writer_putc('"');
+}
+
+static bool json_writer_key_in(const char *keys[]) {
+    if (json_writer.key == NULL) {
+        return false;
+    }
+    for (int i = 0; keys[i] != NULL; i++) {
+        if (strcmp(json_writer.key, keys[i]) == 0) {
+            return true;
+        }
+    }
     return false;
 }
+
+// Writes a base64 or hex member as a CBOR byte string, false if it does not decode
+static bool json_writer_cbor_bytes(const char *value) {
+    _cleanup_free_ uint8_t *bin = NULL;
+    int bin_len;
+
+    if (json_writer_key_in(json_writer_base64_keys)) {
+        if ((bin = malloc(euicc_base64_decode_len(value))) == NULL) {
+            return false;
+        }
+        if ((bin_len = euicc_base64_decode(bin, value)) < 0) {
+            return false;
+        }
+    } else if (json_writer_key_in(json_writer_hex_keys)) {
+        if ((bin = malloc(strlen(value) / 2 + 1)) == NULL) {
+            return false;
+        }
+        if ((bin_len = euicc_hexutil_hex2bin(bin, strlen(value) / 2 + 1, value)) < 0) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    json_writer_cbor_head(2, bin_len);
+    json_writer_write((const char *)bin, bin_len);
+    return true;
+}
+
+void json_writer_object_begin(void) {
+    json_writer_value_prefix();
+    if (json_writer_is_cbor()) {
+        json_writer_putc((char)0xBF); // indefinite-length map
+    } else {
+        json_writer_putc('{');
+    }
+    if (json_writer.depth + 1 < JSON_WRITER_MAX_DEPTH) {
+        json_writer.depth++;
+    }
+    json_writer.need_comma[json_writer.depth] = false;
+}
+
+void json_writer_object_end(void) {
+    json_writer_putc(json_writer_is_cbor() ? (char)0xFF : '}');
+    if (json_writer.depth > 0) {
+        json_writer.depth--;
+    }
+}
+
+void json_writer_array_begin(void) {
+    json_writer_value_prefix();
+    if (json_writer_is_cbor()) {
+        json_writer_putc((char)0x9F); // indefinite-length array
+    } else {
+        json_writer_putc('[');
+    }
+    if (json_writer.depth + 1 < JSON_WRITER_MAX_DEPTH) {
+        json_writer.depth++;
+    }
+    json_writer.need_comma[json_writer.depth] = false;
+}
+
+void json_writer_array_end(void) {
+    json_writer_putc(json_writer_is_cbor() ? (char)0xFF : ']');
+    if (json_writer.depth > 0) {
+        json_writer.depth--;
+    }
+}
+
+void json_writer_key(const char *key) {
+    json_writer_value_prefix();
+    json_writer_quoted(key);
+    if (!json_writer_is_cbor()) {
+        json_writer_putc(':');
+    }
+    json_writer.key = key;
+    json_writer.after_key = true;
+}
+
+void json_writer_string(const char *value) {
+    if (value == NULL) {
+        json_writer_null();
+        return;
+    }
+    json_writer_value_prefix();
+    if (json_writer_is_cbor() && json_writer_cbor_bytes(value)) {
+        return;
+    }
+    json_writer_quoted(value);
+}
+
+void json_writer_number(const double value) {
+    char number[26];
+    int len;
+
+    json_writer_value_prefix();
+
+    if (json_writer_is_cbor()) {
+        if (value * 0 != 0) {
+            json_writer_putc((char)0xF6);
+        } else if (value >= 0 && value < 18446744073709551616.0 && value == (double)(uint64_t)value) {
+            json_writer_cbor_head(0, (uint64_t)value);
+        } else if (value < 0 && value >= -9223372036854775808.0 && value == (double)(int64_t)value) {
+            json_writer_cbor_head(1, (uint64_t)(-1 - (int64_t)value));
+        } else {
+            uint64_t bits;
+
+            memcpy(&bits, &value, sizeof(bits));
+            json_writer_putc((char)0xFB);
+            for (int i = 7; i >= 0; i--) {
+                json_writer_putc((char)(bits >> (8 * i)));
+            }
+        }
+        return;
+    }
+
+    // same representation as cJSON_PrintUnformatted
+    if (value * 0 != 0) {
+        json_writer_write("null", 4);
+        return;
+    }
+    if (value >= INT_MIN && value <= INT_MAX && value == (double)(int)value) {
+        len = snprintf(number, sizeof(number), "%d", (int)value);
+    } else {
+        len = snprintf(number, sizeof(number), "%1.15g", value);
+        if (strtod(number, NULL) != value) {
+            len = snprintf(number, sizeof(number), "%1.17g", value);
+        }
+    }
+    json_writer_write(number, len);
+}
+
+void json_writer_bool(const bool value) {
+    json_writer_value_prefix();
+    if (json_writer_is_cbor()) {
+        json_writer_putc(value ? (char)0xF5 : (char)0xF4);
+    } else if (value) {
+        json_writer_write("true", 4);
+    } else {
+        json_writer_write("false", 5);
+    }
+}
+
+void json_writer_null(void) {
+    json_writer_value_prefix();
+    if (json_writer_is_cbor()) {
+        json_writer_putc((char)0xF6);
+    } else {
+        json_writer_write("null", 4);
+    }
+}
+
+void json_writer_cjson(const cJSON *item) {
+    const cJSON *child;
+
+    if (item == NULL) {
+        json_writer_null();
+        return;
+    }
+
+    switch (item->type & 0xFF) {
+    case cJSON_False:
+        json_writer_bool(false);
+        break;
+    case cJSON_True:
+        json_writer_bool(true);
+        break;
+    case cJSON_Number:
+        json_writer_number(item->valuedouble);
+        break;
+    case cJSON_String:
+        json_writer_string(item->valuestring);
+        break;
+    case cJSON_Raw:
+        json_writer_value_prefix();
+        if (json_writer_is_cbor()) {
+            json_writer_quoted(item->valuestring);
+        } else {
+            json_writer_write(item->valuestring, strlen(item->valuestring));
+        }
+        break;
+    case cJSON_Array:
+        json_writer_array_begin();
+        cJSON_ArrayForEach(child, item) { json_writer_cjson(child); }
+        json_writer_array_end();
+        break;
+    case cJSON_Object:
+        json_writer_object_begin();
+        cJSON_ArrayForEach(child, item) {
+            json_writer_key(child->string);
+            json_writer_cjson(child);
+        }
+        json_writer_object_end();
+        break;
+    default:
+        json_writer_null();
+        break;
+    }
+}
+
+bool json_writer_line_end(void) {
+    json_writer_setup();
+
+    if (json_writer_is_cbor()) {
+        if (json_writer.oom || json_writer.len < 4) {
+            // drop the incomplete message, a truncated frame would desynchronise the reader
+            json_writer.len = 0;
+        } else {
+            const size_t len = json_writer.len - 4;
+            json_writer.buf[0] = (char)(len >> 24);
+            json_writer.buf[1] = (char)(len >> 16);
+            json_writer.buf[2] = (char)(len >> 8);
+            json_writer.buf[3] = (char)len;
+        }
+    } else {
+        json_writer_putc('\n');
+    }
+    json_writer_drain();
+    json_writer.depth = 0;
+    json_writer.need_comma[0] = false;
+    json_writer.after_key = false;
+    json_writer.key = NULL;
+
+    if (json_writer.oom) {
+        json_writer.oom = json_writer.buf == NULL;
+        return false;
+    }
+
+    if (json_writer.flush_each_line) {
+        fflush(stdout);
+    }
+
+    return ferror(stdout) == 0;
+}
+
+void json_writer_flush(void) {
+    json_writer_drain();
+    fflush(stdout);
+}
+
+void json_print_stream_begin(const char *type) {
+    json_writer_object_begin();
+    json_writer_key("type");
+    json_writer_string(type);
+    json_writer_key("payload");
+}
+
+bool json_print_stream_end(void) {
+    json_writer_object_end();
+    json_writer_line_end();
+
+    // the peer of the stdio drivers waits for this line before it answers
+    json_writer_flush();
+
+    return ferror(stdout) == 0;
+}
+
+bool json_print(char *type, cJSON *jpayload) {
+    if (jpayload == NULL) {
+        return false;
+    }
+
+    json_print_stream_begin(type);
+    json_writer_cjson(jpayload);
+    return json_print_stream_end();
+}
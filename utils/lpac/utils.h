@@ -10,6 +10,8 @@
 
 #define ENV_HTTP_DRIVER "LPAC_HTTP"
 #define ENV_APDU_DRIVER "LPAC_APDU"
+#define ENV_OUTPUT_FLUSH "LPAC_OUTPUT_FLUSH"
+#define ENV_OUTPUT_FORMAT "LPAC_OUTPUT_FORMAT"
 
 #define HTTP_ENV_NAME(DRIVER, NAME) ENV_HTTP_DRIVER "_" #DRIVER "_" #NAME
 #define APDU_ENV_NAME(DRIVER, NAME) ENV_APDU_DRIVER "_" #DRIVER "_" #NAME
@@ -59,4 +61,28 @@ long getenv_long_or_default(const char *name, long default_value);
 
 void set_deprecated_env_name(const char *name, const char *deprecated_name);
 
+// rename() that also replaces an existing file on Windows, for swapping in a rewritten file
+int rename_replace(const char *from, const char *to);
+
+// Streaming JSON output to stdout, one document per line. Values are written as they
+// are produced into a reused buffer, commas are inserted automatically.
+// With LPAC_OUTPUT_FORMAT=cbor each document is a CBOR item prefixed by its length
+// as a big-endian uint32 instead.
+void json_writer_object_begin(void);
+void json_writer_object_end(void);
+void json_writer_array_begin(void);
+void json_writer_array_end(void);
+void json_writer_key(const char *key);
+void json_writer_string(const char *value);
+void json_writer_number(double value);
+void json_writer_bool(bool value);
+void json_writer_null(void);
+void json_writer_cjson(const cJSON *item);
+// Terminates the current document, stdout is flushed unless LPAC_OUTPUT_FLUSH=exit
+bool json_writer_line_end(void);
+void json_writer_flush(void);
+
 bool json_print(char *type, cJSON *jpayload);
+// Same as json_print, the payload value is written with json_writer_* between the two calls
+void json_print_stream_begin(const char *type);
+bool json_print_stream_end(void);